@@ -0,0 +1,732 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+// Checkpoint file (text):
+//   hnocs-checkpoint <version> <simtime scale exp> <time>
+//   rngs <n> <values drawn>...
+//   messages <n>       - a line per message: class, creation time, fields
+//   modules <n>        - a line per Checkpointable module: path, state
+//   events <n>         - a line per pending event: message, arrival, sender
+//   channels <n>       - a line per busy channel: gate, transmission finish
+// All times are raw simtime values.
+//
+#include "Checkpoint.h"
+#include <algorithm>
+#include <climits>
+#include <fstream>
+#include <sstream>
+#include <typeinfo>
+#include "NoCs_m.h"
+#include "routers/hier/HierRouter.h"
+#include "routers/hier/FlitMsgCtrl.h"
+
+Define_Module(Checkpoint);
+
+#define CHECKPOINT_VERSION 2
+
+//
+// CheckpointWriter / CheckpointReader
+//
+void CheckpointWriter::writeMsg(cMessage *msg)
+{
+	if (!msg) {
+		writeInt(-1);
+		return;
+	}
+	std::map<cMessage*, int>::iterator it = msgIdx.find(msg);
+	if (it != msgIdx.end()) {
+		writeInt(it->second);
+		return;
+	}
+	int idx = msgs.size();
+	msgIdx[msg] = idx;
+	msgs.push_back(msg);
+	writeInt(idx);
+}
+
+void CheckpointWriter::writeInts(const std::vector<int> &v)
+{
+	writeInt(v.size());
+	for (unsigned int i = 0; i < v.size(); i++)
+		writeInt(v[i]);
+}
+
+void CheckpointWriter::writeBools(const std::vector<bool> &v)
+{
+	writeInt(v.size());
+	for (unsigned int i = 0; i < v.size(); i++)
+		writeInt(v[i]);
+}
+
+void CheckpointWriter::writeQueue(const cQueue &q)
+{
+	writeInt(q.getLength());
+	for (int i = 0; i < q.getLength(); i++)
+		writeMsg((cMessage*)q.get(i));
+}
+
+void CheckpointReader::check()
+{
+	if (is.fail()) {
+		throw cRuntimeError("-E- checkpoint: truncated state of %s", path.c_str());
+	}
+}
+
+long CheckpointReader::readInt()
+{
+	long v;
+	is >> v;
+	check();
+	return v;
+}
+
+double CheckpointReader::readDouble()
+{
+	double v;
+	is >> v;
+	check();
+	return v;
+}
+
+simtime_t CheckpointReader::readTime()
+{
+	int64_t v;
+	is >> v;
+	check();
+	return SimTime::fromRaw(v);
+}
+
+cMessage *CheckpointReader::readMsg()
+{
+	long idx = readInt();
+	if (idx < 0)
+		return NULL;
+	if ((idx >= (long)msgs.size()) || !msgs[idx]) {
+		throw cRuntimeError("-E- checkpoint: bad message %ld in state of %s",
+				idx, path.c_str());
+	}
+	msgUsed[idx] = true;
+	return msgs[idx];
+}
+
+void CheckpointReader::readInts(std::vector<int> &v)
+{
+	v.resize(readInt());
+	for (unsigned int i = 0; i < v.size(); i++)
+		v[i] = readInt();
+}
+
+void CheckpointReader::readBools(std::vector<bool> &v)
+{
+	v.resize(readInt());
+	for (unsigned int i = 0; i < v.size(); i++)
+		v[i] = readInt();
+}
+
+void CheckpointReader::readQueue(cQueue &q)
+{
+	q.clear();
+	int n = readInt();
+	for (int i = 0; i < n; i++)
+		q.insert(readMsg());
+}
+
+void CheckpointReader::checkSize(int n, int expected, const char *what)
+{
+	if (n != expected) {
+		throw cRuntimeError("-E- checkpoint: %s has %s %d in the checkpoint but %d in this run",
+				path.c_str(), what, n, expected);
+	}
+}
+
+void CheckpointReader::finish()
+{
+	std::string extra;
+	if (is >> extra) {
+		throw cRuntimeError("-E- checkpoint: extra state for %s - saved by another model version?",
+				path.c_str());
+	}
+}
+
+//
+// message (de)serialization - the message classes of NoCs.msg
+//
+static void writeMessage(std::ostream &os, cMessage *msg)
+{
+	const char *tag;
+	if (dynamic_cast<NoCFlitMsg*>(msg))
+		tag = "flit";
+	else if (dynamic_cast<NoCCreditMsg*>(msg))
+		tag = "credit";
+	else if (dynamic_cast<NoCReqMsg*>(msg))
+		tag = "req";
+	else if (dynamic_cast<NoCGntMsg*>(msg))
+		tag = "gnt";
+	else if (dynamic_cast<NoCAckMsg*>(msg))
+		tag = "ack";
+	else if (dynamic_cast<NoCPopMsg*>(msg))
+		tag = "pop";
+	else if (typeid(*msg) == typeid(cMessage))
+		tag = "msg";
+	else {
+		throw cRuntimeError("-E- checkpoint: can not save message %s of class %s",
+				msg->getFullPath().c_str(), msg->getClassName());
+	}
+
+	std::string name = msg->getName();
+	if (name == "")
+		name = "-";
+	std::replace(name.begin(), name.end(), ' ', '_');
+	os << tag << ' ' << msg->getCreationTime().raw() << ' ' << name << ' '
+	   << msg->getKind() << ' ' << msg->getSchedulingPriority();
+
+	if (NoCFlitMsg *f = dynamic_cast<NoCFlitMsg*>(msg)) {
+		os << ' ' << f->getByteLength() << ' ' << f->getType() << ' ' << f->getVC()
+		   << ' ' << f->getSL() << ' ' << f->getPktId() << ' ' << f->getFlits()
+		   << ' ' << f->getFlitIdx() << ' ' << f->getSrcId() << ' ' << f->getDstId()
+		   << ' ' << f->getDstMaskArraySize();
+		for (unsigned int i = 0; i < f->getDstMaskArraySize(); i++)
+			os << ' ' << f->getDstMask(i);
+		os << ' ' << f->getMsgId() << ' ' << f->getMsgPkts() << ' ' << f->getMsgPktIdx()
+		   << ' ' << f->getMsgTime().raw();
+		os << ' ' << f->getHops() << ' ' << f->getLookaheadPort() << ' ' << f->getSmartHops()
+		   << ' ' << f->getExpressHops() << ' ' << f->getFirstNet()
+		   << ' ' << f->getInjectTime().raw() << ' ' << f->getFirstNetTime().raw();
+		inPortFlitInfo *info = dynamic_cast<inPortFlitInfo*>(f->getControlInfo());
+		if (info) {
+			os << " 1 " << info->inVC << ' ' << info->outPort << ' '
+			   << info->reqDelay.raw() << ' ' << info->bypass;
+		} else if (f->getControlInfo()) {
+			throw cRuntimeError("-E- checkpoint: can not save the control info of %s",
+					f->getFullPath().c_str());
+		} else {
+			os << " 0";
+		}
+	} else if (NoCCreditMsg *c = dynamic_cast<NoCCreditMsg*>(msg)) {
+		os << ' ' << c->getVC() << ' ' << c->getFlits() << ' ' << c->getMsgs();
+	} else if (NoCReqMsg *r = dynamic_cast<NoCReqMsg*>(msg)) {
+		os << ' ' << r->getOutVC() << ' ' << r->getInVC() << ' ' << r->getOutPortNum()
+		   << ' ' << r->getPktId() << ' ' << r->getNumFlits() << ' ' << r->getNumGranted()
+		   << ' ' << r->getNumAcked() << ' ' << r->getBypass();
+	} else if (NoCGntMsg *g = dynamic_cast<NoCGntMsg*>(msg)) {
+		os << ' ' << g->getOutVC() << ' ' << g->getInVC() << ' ' << g->getOutPortNum();
+	} else if (NoCAckMsg *a = dynamic_cast<NoCAckMsg*>(msg)) {
+		os << ' ' << a->getOK() << ' ' << a->getOutVC() << ' ' << a->getInVC()
+		   << ' ' << a->getOutPortNum();
+	} else if (NoCPopMsg *p = dynamic_cast<NoCPopMsg*>(msg)) {
+		os << ' ' << p->getVC() << ' ' << p->getOutPortNum();
+	}
+}
+
+static simtime_t readRawTime(std::istream &is)
+{
+	int64_t t;
+	is >> t;
+	return SimTime::fromRaw(t);
+}
+
+// create the message of a message table line - at its creation time
+static cMessage *parseMessage(const std::string &line)
+{
+	std::istringstream is(line);
+	std::string tag, name;
+	int64_t creation;
+	int kind, prio;
+	is >> tag >> creation >> name >> kind >> prio;
+	const char *n = (name == "-") ? NULL : name.c_str();
+
+	cMessage *msg;
+	if (tag == "flit") {
+		NoCFlitMsg *f = new NoCFlitMsg(n);
+		int64_t len;
+		int v, size;
+		is >> len;
+		f->setByteLength(len);
+		is >> v; f->setType(v);
+		is >> v; f->setVC(v);
+		is >> v; f->setSL(v);
+		is >> v; f->setPktId(v);
+		is >> v; f->setFlits(v);
+		is >> v; f->setFlitIdx(v);
+		is >> v; f->setSrcId(v);
+		is >> v; f->setDstId(v);
+		is >> size;
+		f->setDstMaskArraySize(size);
+		for (int i = 0; i < size; i++) {
+			is >> v;
+			f->setDstMask(i, v);
+		}
+		is >> v; f->setMsgId(v);
+		is >> v; f->setMsgPkts(v);
+		is >> v; f->setMsgPktIdx(v);
+		f->setMsgTime(readRawTime(is));
+		is >> v; f->setHops(v);
+		is >> v; f->setLookaheadPort(v);
+		is >> v; f->setSmartHops(v);
+		is >> v; f->setExpressHops(v);
+		is >> v; f->setFirstNet(v);
+		f->setInjectTime(readRawTime(is));
+		f->setFirstNetTime(readRawTime(is));
+		is >> v;
+		if (v) {
+			inPortFlitInfo *info = new inPortFlitInfo;
+			is >> info->inVC >> info->outPort;
+			info->reqDelay = readRawTime(is);
+			is >> info->bypass;
+			f->setControlInfo(info);
+		}
+		msg = f;
+	} else if (tag == "credit") {
+		NoCCreditMsg *c = new NoCCreditMsg(n);
+		int vc, flits, msgs;
+		is >> vc >> flits >> msgs;
+		c->setVC(vc);
+		c->setFlits(flits);
+		c->setMsgs(msgs);
+		msg = c;
+	} else if (tag == "req") {
+		NoCReqMsg *r = new NoCReqMsg(n);
+		int outVC, inVC, op, pktId, numFlits, numGranted, numAcked;
+		bool bypass;
+		is >> outVC >> inVC >> op >> pktId >> numFlits >> numGranted >> numAcked >> bypass;
+		r->setOutVC(outVC);
+		r->setInVC(inVC);
+		r->setOutPortNum(op);
+		r->setPktId(pktId);
+		r->setNumFlits(numFlits);
+		r->setNumGranted(numGranted);
+		r->setNumAcked(numAcked);
+		r->setBypass(bypass);
+		msg = r;
+	} else if (tag == "gnt") {
+		NoCGntMsg *g = new NoCGntMsg(n);
+		int outVC, inVC, op;
+		is >> outVC >> inVC >> op;
+		g->setOutVC(outVC);
+		g->setInVC(inVC);
+		g->setOutPortNum(op);
+		msg = g;
+	} else if (tag == "ack") {
+		NoCAckMsg *a = new NoCAckMsg(n);
+		bool ok;
+		int outVC, inVC, op;
+		is >> ok >> outVC >> inVC >> op;
+		a->setOK(ok);
+		a->setOutVC(outVC);
+		a->setInVC(inVC);
+		a->setOutPortNum(op);
+		msg = a;
+	} else if (tag == "pop") {
+		NoCPopMsg *p = new NoCPopMsg(n);
+		int vc, op;
+		is >> vc >> op;
+		p->setVC(vc);
+		p->setOutPortNum(op);
+		msg = p;
+	} else if (tag == "msg") {
+		msg = new cMessage(n);
+	} else {
+		throw cRuntimeError("-E- checkpoint: unknown message class %s", tag.c_str());
+	}
+	if (is.fail()) {
+		delete msg;
+		throw cRuntimeError("-E- checkpoint: bad message line: %s", line.c_str());
+	}
+	msg->setKind(kind);
+	msg->setSchedulingPriority(prio);
+	return msg;
+}
+
+static bool insertedBefore(cMessage *a, cMessage *b)
+{
+	return a->getInsertOrder() < b->getInsertOrder();
+}
+
+static void writeGate(std::ostream &os, cGate *g)
+{
+	if (!g)
+		os << " - -1";
+	else
+		os << ' ' << g->getName() << ' ' << (g->isVector() ? g->getIndex() : -1);
+}
+
+//
+// Checkpoint
+//
+void Checkpoint::initialize()
+{
+	saveTime = par("saveTime");
+	saveFile = par("saveFile").stdstringValue();
+	endAfterSave = par("endAfterSave");
+	restoreFile = par("restoreFile").stdstringValue();
+
+	if (restoreFile != "") {
+		readFile();
+		if ((saveTime >= 0) && (saveTime <= restoreTime)) {
+			throw cRuntimeError("-E- %s saveTime must be after the restored checkpoint time %s",
+					getFullPath().c_str(), restoreTime.str().c_str());
+		}
+		msgs.resize(msgRecs.size(), NULL);
+		nextCreation = 0;
+		createMsg = new cMessage("checkpoint-create");
+		if (creations.size())
+			scheduleAt(creations[0].first, createMsg);
+		// after all the other events of the checkpoint time
+		restoreMsg = new cMessage("checkpoint-restore");
+		restoreMsg->setSchedulingPriority(SHRT_MAX);
+		scheduleAt(restoreTime, restoreMsg);
+		EV << "-I- " << getFullPath() << " restoring " << restoreFile << " at "
+		   << restoreTime << endl;
+	}
+
+	if (saveTime >= 0) {
+		saveMsg = new cMessage("checkpoint-save");
+		saveMsg->setSchedulingPriority(SHRT_MAX);
+		scheduleAt(saveTime, saveMsg);
+	}
+}
+
+void Checkpoint::handleMessage(cMessage *msg)
+{
+	if (msg == saveMsg) {
+		save();
+	} else if (msg == createMsg) {
+		createMessages();
+	} else if (msg == restoreMsg) {
+		restore();
+	} else {
+		throw cRuntimeError("Does not know how to handle message of type %d", msg->getKind());
+	}
+}
+
+bool Checkpoint::isRestoring(cModule *mod)
+{
+	cModule *ckpt = mod->getSimulation()->getSystemModule()->getSubmodule("checkpoint");
+	return ckpt && strcmp(ckpt->par("restoreFile").stringValue(), "");
+}
+
+// all the modules of the network - compound ones included
+void Checkpoint::collectModules(cModule *mod, std::vector<cModule*> &mods)
+{
+	for (cModule::SubmoduleIterator it(mod); !it.end(); it++) {
+		cModule *sub = *it;
+		mods.push_back(sub);
+		if (!sub->isSimple())
+			collectModules(sub, mods);
+	}
+}
+
+void Checkpoint::save()
+{
+	std::map<cMessage*, int> msgIdx;
+	std::vector<cMessage*> table;
+	std::vector<cModule*> mods;
+	collectModules(getSimulation()->getSystemModule(), mods);
+
+	// module states
+	std::ostringstream modStates;
+	modStates.precision(17);
+	int numMods = 0;
+	for (unsigned int m = 0; m < mods.size(); m++) {
+		cModule *mod = mods[m];
+		Checkpointable *c = dynamic_cast<Checkpointable*>(mod);
+		if (!c) {
+			if (dynamic_cast<InPort*>(mod) || dynamic_cast<Sched*>(mod)
+					|| dynamic_cast<PowerCtrl*>(mod) || dynamic_cast<SwAlloc*>(mod)) {
+				throw cRuntimeError("-E- %s can not checkpoint %s - its state is not saved",
+						getFullPath().c_str(), mod->getFullPath().c_str());
+			}
+			continue;
+		}
+		modStates << mod->getFullPath();
+		CheckpointWriter w(modStates, msgIdx, table);
+		c->saveCheckpoint(w);
+		modStates << endl;
+		numMods++;
+	}
+
+	// pending events - but the timers of modules that are not saved
+	cFutureEventSet *fes = getSimulation()->getFES();
+	std::vector<cMessage*> events;
+	for (int k = 0; k < fes->getLength(); k++) {
+		cMessage *msg = dynamic_cast<cMessage*>(fes->get(k));
+		if (!msg || (msg == saveMsg))
+			continue;
+		if (msg->isSelfMessage() && !dynamic_cast<Checkpointable*>(msg->getArrivalModule()))
+			continue;
+		events.push_back(msg);
+	}
+	std::sort(events.begin(), events.end(), insertedBefore);
+	std::ostringstream eventRecs;
+	CheckpointWriter ew(eventRecs, msgIdx, table);
+	for (unsigned int e = 0; e < events.size(); e++) {
+		cMessage *msg = events[e];
+		ew.writeMsg(msg);
+		eventRecs << ' ' << msg->getArrivalModule()->getFullPath();
+		writeGate(eventRecs, msg->getArrivalGate());
+		eventRecs << ' ' << msg->getArrivalTime().raw() << ' ';
+		cModule *sender = msg->getSenderModule();
+		eventRecs << (sender ? sender->getFullPath() : std::string("-"));
+		writeGate(eventRecs, msg->getSenderGate());
+		eventRecs << ' ' << msg->getSendingTime().raw() << endl;
+	}
+
+	// busy transmission channels
+	std::ostringstream chanRecs;
+	int numChans = 0;
+	for (unsigned int m = 0; m < mods.size(); m++) {
+		for (cModule::GateIterator it(mods[m]); !it.end(); it++) {
+			cGate *g = *it;
+			cChannel *ch = g->getChannel();
+			if (!ch || !ch->isTransmissionChannel() || (ch->getTransmissionFinishTime() <= simTime()))
+				continue;
+			chanRecs << mods[m]->getFullPath();
+			writeGate(chanRecs, g);
+			chanRecs << ' ' << ch->getTransmissionFinishTime().raw() << endl;
+			numChans++;
+		}
+	}
+
+	std::ofstream f(saveFile.c_str());
+	if (!f) {
+		throw cRuntimeError("-E- %s can not open checkpoint file %s",
+				getFullPath().c_str(), saveFile.c_str());
+	}
+	f << "hnocs-checkpoint " << CHECKPOINT_VERSION << ' ' << SimTime::getScaleExp()
+	  << ' ' << simTime().raw() << endl;
+	int numRNGs = getEnvir()->getNumRNGs();
+	f << "rngs " << numRNGs;
+	for (int k = 0; k < numRNGs; k++)
+		f << ' ' << getEnvir()->getRNG(k)->getNumbersDrawn();
+	f << endl;
+	f << "messages " << table.size() << endl;
+	for (unsigned int i = 0; i < table.size(); i++) {
+		writeMessage(f, table[i]);
+		f << endl;
+	}
+	f << "modules " << numMods << endl << modStates.str();
+	f << "events " << events.size() << endl << eventRecs.str();
+	f << "channels " << numChans << endl << chanRecs.str();
+	f.close();
+	if (f.fail()) {
+		throw cRuntimeError("-E- %s failed writing checkpoint file %s",
+				getFullPath().c_str(), saveFile.c_str());
+	}
+
+	EV << "-I- " << getFullPath() << " saved " << numMods << " modules, "
+	   << table.size() << " messages and " << events.size() << " events to "
+	   << saveFile << endl;
+	if (endAfterSave)
+		endSimulation();
+}
+
+// read a "<name> <n>" section header and its n lines
+static void readSection(std::istream &f, const char *name, std::vector<std::string> &lines,
+		const std::string &fileName)
+{
+	std::string tag, line;
+	int n;
+	f >> tag >> n;
+	if (f.fail() || (tag != name)) {
+		throw cRuntimeError("-E- checkpoint file %s: missing %s section",
+				fileName.c_str(), name);
+	}
+	std::getline(f, line);
+	for (int i = 0; i < n; i++) {
+		if (!std::getline(f, line)) {
+			throw cRuntimeError("-E- checkpoint file %s: truncated %s section",
+					fileName.c_str(), name);
+		}
+		lines.push_back(line);
+	}
+}
+
+void Checkpoint::readFile()
+{
+	std::ifstream f(restoreFile.c_str());
+	if (!f) {
+		throw cRuntimeError("-E- %s can not open checkpoint file %s",
+				getFullPath().c_str(), restoreFile.c_str());
+	}
+	std::string tag;
+	int version, scaleExp;
+	f >> tag >> version >> scaleExp;
+	if (f.fail() || (tag != "hnocs-checkpoint") || (version != CHECKPOINT_VERSION)) {
+		throw cRuntimeError("-E- %s %s is not a version %d checkpoint file",
+				getFullPath().c_str(), restoreFile.c_str(), CHECKPOINT_VERSION);
+	}
+	if (scaleExp != SimTime::getScaleExp()) {
+		throw cRuntimeError("-E- %s %s was saved with simtime-scale %d",
+				getFullPath().c_str(), restoreFile.c_str(), scaleExp);
+	}
+	restoreTime = readRawTime(f);
+
+	int n;
+	f >> tag >> n;
+	if (f.fail() || (tag != "rngs")) {
+		throw cRuntimeError("-E- checkpoint file %s: missing rngs", restoreFile.c_str());
+	}
+	rngDrawn.resize(n);
+	for (int k = 0; k < n; k++)
+		f >> rngDrawn[k];
+
+	readSection(f, "messages", msgRecs, restoreFile);
+	for (unsigned int i = 0; i < msgRecs.size(); i++) {
+		std::istringstream is(msgRecs[i]);
+		std::string cls;
+		is >> cls;
+		simtime_t t = readRawTime(is);
+		if (t > restoreTime) {
+			throw cRuntimeError("-E- checkpoint file %s: message created after the checkpoint",
+					restoreFile.c_str());
+		}
+		creations.push_back(std::pair<simtime_t,int>(t, i));
+	}
+	std::stable_sort(creations.begin(), creations.end());
+
+	std::vector<std::string> lines;
+	readSection(f, "modules", lines, restoreFile);
+	for (unsigned int i = 0; i < lines.size(); i++) {
+		std::string::size_type sp = lines[i].find(' ');
+		modRecs.push_back(std::pair<std::string,std::string>(
+				lines[i].substr(0, sp),
+				(sp == std::string::npos) ? std::string("") : lines[i].substr(sp)));
+	}
+	readSection(f, "events", eventRecs, restoreFile);
+	readSection(f, "channels", channelRecs, restoreFile);
+}
+
+// create the checkpoint messages of this creation time
+void Checkpoint::createMessages()
+{
+	while ((nextCreation < creations.size()) && (creations[nextCreation].first == simTime())) {
+		int idx = creations[nextCreation].second;
+		msgs[idx] = parseMessage(msgRecs[idx]);
+		nextCreation++;
+	}
+	if (nextCreation < creations.size())
+		scheduleAt(creations[nextCreation].first, createMsg);
+}
+
+void Checkpoint::restore()
+{
+	std::vector<bool> used(msgs.size(), false);
+
+	// the Checkpointable modules must be the saved ones
+	std::vector<cModule*> mods;
+	collectModules(getSimulation()->getSystemModule(), mods);
+	unsigned int numMods = 0;
+	for (unsigned int m = 0; m < mods.size(); m++)
+		if (dynamic_cast<Checkpointable*>(mods[m]))
+			numMods++;
+	if (numMods != modRecs.size()) {
+		throw cRuntimeError("-E- %s the network has %d checkpointable modules but %s has %d",
+				getFullPath().c_str(), numMods, restoreFile.c_str(), (int)modRecs.size());
+	}
+	for (unsigned int m = 0; m < modRecs.size(); m++) {
+		const std::string &path = modRecs[m].first;
+		Checkpointable *c = dynamic_cast<Checkpointable*>(
+				getSimulation()->getModuleByPath(path.c_str()));
+		if (!c) {
+			throw cRuntimeError("-E- %s no checkpointable module %s in the network",
+					getFullPath().c_str(), path.c_str());
+		}
+		std::istringstream is(modRecs[m].second);
+		CheckpointReader r(is, msgs, used, path);
+		c->restoreCheckpoint(r);
+		r.finish();
+	}
+
+	// pending events - in their original order
+	for (unsigned int e = 0; e < eventRecs.size(); e++) {
+		std::istringstream is(eventRecs[e]);
+		CheckpointReader r(is, msgs, used, "events");
+		cMessage *msg = r.readMsg();
+		std::string arrPath, arrGate, sndPath, sndGate;
+		int arrIdx, sndIdx;
+		is >> arrPath >> arrGate >> arrIdx;
+		simtime_t arrTime = readRawTime(is);
+		is >> sndPath >> sndGate >> sndIdx;
+		simtime_t sndTime = readRawTime(is);
+		cModule *arrMod = getSimulation()->getModuleByPath(arrPath.c_str());
+		cModule *sndMod = (sndPath == "-") ? NULL : getSimulation()->getModuleByPath(sndPath.c_str());
+		if (is.fail() || !msg || !arrMod) {
+			throw cRuntimeError("-E- %s bad event in %s: %s", getFullPath().c_str(),
+					restoreFile.c_str(), eventRecs[e].c_str());
+		}
+		int arrGateId = (arrGate == "-") ? -1 : arrMod->gate(arrGate.c_str(), arrIdx)->getId();
+		int sndGateId = (!sndMod || (sndGate == "-")) ? -1 : sndMod->gate(sndGate.c_str(), sndIdx)->getId();
+		msg->setSentFrom(sndMod, sndGateId, sndTime);
+		msg->setArrival(arrMod->getId(), arrGateId, arrTime);
+		getSimulation()->insertEvent(msg);
+	}
+
+	for (unsigned int i = 0; i < channelRecs.size(); i++) {
+		std::istringstream is(channelRecs[i]);
+		std::string path, gateName;
+		int idx;
+		is >> path >> gateName >> idx;
+		simtime_t finish = readRawTime(is);
+		cModule *mod = getSimulation()->getModuleByPath(path.c_str());
+		if (is.fail() || !mod || !mod->gate(gateName.c_str(), idx)->getChannel()) {
+			throw cRuntimeError("-E- %s bad channel in %s: %s", getFullPath().c_str(),
+					restoreFile.c_str(), channelRecs[i].c_str());
+		}
+		mod->gate(gateName.c_str(), idx)->getChannel()->forceTransmissionFinishTime(finish);
+	}
+
+	// continue the random streams of the saved run
+	int numRNGs = getEnvir()->getNumRNGs();
+	if (numRNGs != (int)rngDrawn.size()) {
+		throw cRuntimeError("-E- %s %s was saved with %d RNGs, this run has %d",
+				getFullPath().c_str(), restoreFile.c_str(), (int)rngDrawn.size(), numRNGs);
+	}
+	for (int k = 0; k < numRNGs; k++) {
+		cRNG *rng = getEnvir()->getRNG(k);
+		unsigned long drawn = rng->getNumbersDrawn();
+		if (drawn > rngDrawn[k]) {
+			EV << "-W- " << getFullPath() << " RNG " << k << " drew " << drawn
+			   << " values before the restore - more than the saved run" << endl;
+		}
+		for (; drawn < rngDrawn[k]; drawn++)
+			rng->intRand();
+	}
+
+	int numUnused = 0;
+	for (unsigned int i = 0; i < msgs.size(); i++) {
+		if (!used[i]) {
+			delete msgs[i];
+			numUnused++;
+		}
+	}
+	if (numUnused) {
+		EV << "-W- " << getFullPath() << " " << numUnused
+		   << " checkpoint messages were not restored" << endl;
+	}
+	EV << "-I- " << getFullPath() << " restored " << modRecs.size() << " modules, "
+	   << msgs.size() << " messages and " << eventRecs.size() << " events" << endl;
+	msgs.clear();
+	msgRecs.clear();
+	modRecs.clear();
+	eventRecs.clear();
+	channelRecs.clear();
+}
+
+Checkpoint::~Checkpoint()
+{
+	cancelAndDelete(saveMsg);
+	cancelAndDelete(createMsg);
+	cancelAndDelete(restoreMsg);
+}
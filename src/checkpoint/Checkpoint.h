@@ -0,0 +1,161 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#ifndef __HNOCS_CHECKPOINT_H_
+#define __HNOCS_CHECKPOINT_H_
+
+#include <omnetpp.h>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+using namespace omnetpp;
+
+//
+// Writes the state of a single module into the checkpoint. Values are
+// written as text tokens. Messages are written by reference into the
+// checkpoint message table so a message held by several pointers (e.g. a
+// Sched Req) is restored once.
+//
+class CheckpointWriter
+{
+private:
+	std::ostream &os;
+	std::map<cMessage*, int> &msgIdx;
+	std::vector<cMessage*> &msgs;
+public:
+	CheckpointWriter(std::ostream &s, std::map<cMessage*, int> &idx,
+			std::vector<cMessage*> &table) : os(s), msgIdx(idx), msgs(table) { };
+	void writeInt(long v) { os << ' ' << v; };
+	void writeDouble(double v) { os << ' ' << v; };
+	void writeTime(simtime_t t) { os << ' ' << t.raw(); };
+	void writeMsg(cMessage *msg);
+	void writeInts(const std::vector<int> &v);
+	void writeBools(const std::vector<bool> &v);
+	void writeQueue(const cQueue &q);
+};
+
+//
+// Reads back the state written by CheckpointWriter in the same order.
+// Messages are created by the Checkpoint module at their original creation
+// time; a module restoring a message it holds by pointer must take() it.
+// Messages read into a cQueue are owned by the queue.
+//
+class CheckpointReader
+{
+private:
+	std::istream &is;
+	const std::vector<cMessage*> &msgs;
+	std::vector<bool> &msgUsed;
+	std::string path; // the module restored - for errors
+
+	void check();
+public:
+	CheckpointReader(std::istream &s, const std::vector<cMessage*> &table,
+			std::vector<bool> &used, const std::string &modPath)
+		: is(s), msgs(table), msgUsed(used), path(modPath) { };
+	long readInt();
+	double readDouble();
+	simtime_t readTime();
+	cMessage *readMsg();
+	void readInts(std::vector<int> &v);
+	void readBools(std::vector<bool> &v);
+	void readQueue(cQueue &q);
+	// throw unless n equals the value configured in this run
+	void checkSize(int n, int expected, const char *what);
+	void finish();
+};
+
+//
+// Interface of modules whose run time state can be checkpointed. The
+// restore is called at the checkpoint time on a network that was not fed
+// with traffic. It must replace the state of the module, including its
+// self messages (scheduled ones are scheduled again by the Checkpoint).
+// Statistics are not saved.
+//
+class Checkpointable
+{
+public:
+	virtual ~Checkpointable() { };
+	virtual void saveCheckpoint(CheckpointWriter &w) = 0;
+	virtual void restoreCheckpoint(CheckpointReader &r) = 0;
+};
+
+//
+// Saves the state of the network at saveTime and restores it in a later run
+//
+// Save: after all the other events of saveTime the state of every
+// Checkpointable module is written to saveFile together with all the
+// pending events (flits, credits, Reqs on the wire or in a pipeline stage and
+// the module self messages), the transmission channels busy state and the
+// number of values drawn from each RNG. Self messages of other modules
+// (e.g. monitor timers) are not saved. Routers with modules that keep state
+// but are not Checkpointable (async InPort/Sched, power control, switch
+// allocator) are refused.
+//
+// Restore: when restoreFile is set the sources do not generate traffic. The
+// messages of the checkpoint are created at their original creation time so
+// latencies measured from it are kept. At the checkpoint time the module
+// states are restored, the pending events are inserted into the FES in their
+// original order, the channels are made busy and the RNGs are advanced to
+// their position in the saved run. The restored run should use a
+// statStartTime at or after the checkpoint time; the parameters shaping the
+// network (topology, VCs, buffers) must be the same, the traffic and
+// statistic parameters may change.
+//
+class Checkpoint : public cSimpleModule
+{
+private:
+	// parameters
+	simtime_t saveTime;
+	std::string saveFile;
+	bool endAfterSave;
+	std::string restoreFile;
+
+	cMessage *saveMsg;
+	cMessage *createMsg;
+	cMessage *restoreMsg;
+
+	// restore - the checkpoint read at initialize
+	simtime_t restoreTime;
+	std::vector<std::string> msgRecs;          // message table lines
+	std::vector< std::pair<simtime_t,int> > creations; // (creation time, msg) sorted
+	unsigned int nextCreation;
+	std::vector<cMessage*> msgs;
+	std::vector< std::pair<std::string,std::string> > modRecs; // (path, state)
+	std::vector<std::string> eventRecs;
+	std::vector<std::string> channelRecs;
+	std::vector<unsigned long> rngDrawn;
+
+	// methods
+	void collectModules(cModule *mod, std::vector<cModule*> &mods);
+	void save();
+	void readFile();
+	void createMessages();
+	void restore();
+
+protected:
+	virtual void initialize();
+	virtual void handleMessage(cMessage *msg);
+public:
+	Checkpoint() { saveMsg = createMsg = restoreMsg = NULL; };
+	virtual ~Checkpoint();
+
+	// true when the network is restored from a checkpoint - the sources
+	// should not start generating traffic
+	static bool isRestoring(cModule *mod);
+};
+
+#endif
@@ -19,6 +19,8 @@
 // Behavior
 // This sink is simple - it assumes NO delay on receiving packets
 // so on the received FLIT a credit is generated.
+// Flits fast-forwarded by the FastForward module arrive on directIn and
+// return no credit.
 //
 // PktId check is valid only for single source .
 //
@@ -45,6 +47,8 @@ void InfiniteBWMultiVCSink::initialize() {
 	EoPQTime.setName("EoP-queueing-time-ns");
 
 	numReceivedPkt.setName("number-received-packets");
+	hopCount.setName("hop-count");
+	mcastSoPEnd2EndLatency.setName("multicast-SoP-end-to-end-latency-ns");
 
 	// Vectors
 	end2EndLatencyVec.setName("end-to-end-latency-ns");
@@ -58,6 +62,12 @@ void InfiniteBWMultiVCSink::initialize() {
 	SoPFirstNetTime.resize(numVCs, 0);
 	statStartTime = par("statStartTime");
 
+	myId = getParentModule()->hasPar("id") ? (int)getParentModule()->par("id") : -1;
+	latencyMatrix = dynamic_cast<LatencyMatrixMonitor*>(
+			getSimulation()->getSystemModule()->getSubmodule("latencyMatrixMonitor"));
+	fastForward = dynamic_cast<FastForward*>(
+			getSimulation()->getSystemModule()->getSubmodule("fastForward"));
+
 	// send the credits to the other size
 	for (int vc = 0; vc < numVCs; vc++)
 		sendCredit(vc, 100);
@@ -76,14 +86,33 @@ void InfiniteBWMultiVCSink::sendCredit(int vc, int num) {
 	send(crd, "in$o");
 }
 
+void InfiniteBWMultiVCSink::growPerSL(int numSLs) {
+	if (numSLs <= (int)flitsPerSL.size())
+		return;
+	flitsPerSL.resize(numSLs, 0);
+	SoPEnd2EndLatencyPerSL.resize(numSLs);
+}
+
 void InfiniteBWMultiVCSink::handleMessage(cMessage *msg) {
-	NoCFlitMsg *flit = dynamic_cast<NoCFlitMsg*> (msg);
+	if (msg->getKind() != NOC_FLIT_MSG) {
+		throw cRuntimeError("-E- %s does not know how to handle message of type %d",
+				getFullPath().c_str(), msg->getKind());
+	}
+	NoCFlitMsg *flit = (NoCFlitMsg*) msg;
 	int vc = flit->getVC();
-	sendCredit(vc, 1);
+	if (!msg->arrivedOn("directIn")) {
+		sendCredit(vc, 1);
+		if (fastForward)
+			fastForward->checkFlit(flit);
+	}
 
 	// some statistics
 	if (simTime() > statStartTime) {
 		vcFLITs[vc]++;
+		int sl = flit->getSL();
+		if (sl >= (int)flitsPerSL.size())
+			growPerSL(sl + 1);
+		flitsPerSL[sl]++;
 
 		if (flit->getFirstNet()) {
 			throw cRuntimeError(
@@ -105,8 +134,12 @@ void InfiniteBWMultiVCSink::handleMessage(cMessage *msg) {
 			SoPEnd2EndLatencyHist.collect(eed_ns);
 
 			SoPLatency.collect(d_ns);
+			SoPEnd2EndLatencyPerSL[sl].collect(eed_ns);
 			SoPQTime.collect(1e9 * (flit->getInjectTime().dbl()
 					- msg->getCreationTime().dbl()));
+			hopCount.collect(flit->getHops());
+			if (flit->getDstMaskArraySize() > 0)
+				mcastSoPEnd2EndLatency.collect(eed_ns);
 
 			if (SoPFirstNetTime[vc] == 0) {
 				SoPFirstNetTime[vc] = flit->getFirstNetTime();
@@ -124,7 +157,10 @@ void InfiniteBWMultiVCSink::handleMessage(cMessage *msg) {
 			EoPLatency.collect(d_ns);
 			EoPQTime.collect(1e9 * (flit->getInjectTime().dbl() - msg->getCreationTime()).dbl());
 			if (SoPFirstNetTime[vc] != 0) { // avoid collecting statistics when statStartTime is between SoP and EoP
-				packetLatency.collect(1e9 * (simTime().dbl() - SoPFirstNetTime[vc].dbl()));
+				double pLat = 1e9 * (simTime().dbl() - SoPFirstNetTime[vc].dbl());
+				packetLatency.collect(pLat);
+				if (latencyMatrix)
+					latencyMatrix->collect(flit->getSrcId(), myId >= 0 ? myId : flit->getDstId(), pLat);
 			}
 			SoPFirstNetTime[vc] = 0;
 			EV<< "-I- " << getFullPath() << "Assign statistics to [" << vc <<"]" << endl;
@@ -202,9 +238,39 @@ void InfiniteBWMultiVCSink::finish() {
 		networkLatency.record();
 		end2EndLatency.record();
 
+		hopCount.record();
+		if (mcastSoPEnd2EndLatency.getCount())
+			mcastSoPEnd2EndLatency.record();
 		numReceivedPkt.collect(numRecPkt);
 		numReceivedPkt.record();
 		double BW_MBps = 1e-6 * totalFlits * flitSize_B / (simTime().dbl()- statStartTime);
 		recordScalar("Sink-Total-BW-MBps", BW_MBps);
+
+		// per QoS SL latency and throughput
+		for (unsigned int sl = 0; sl < flitsPerSL.size(); sl++) {
+			char slName[64];
+			if (SoPEnd2EndLatencyPerSL[sl].getCount()) {
+				sprintf(slName, "SoP-end-to-end-latency-ns-SL-%d", sl);
+				SoPEnd2EndLatencyPerSL[sl].setName(slName);
+				SoPEnd2EndLatencyPerSL[sl].record();
+			}
+			if (flitsPerSL[sl]) {
+				sprintf(slName, "Sink-SL-%d-BW-MBps", sl);
+				recordScalar(slName, 1e-6 * flitsPerSL[sl] * flitSize_B / (simTime().dbl()- statStartTime));
+			}
+		}
 	}
 }
+
+// only the packet order check state - the statistics restart on restore
+void InfiniteBWMultiVCSink::saveCheckpoint(CheckpointWriter &w) {
+	w.writeInts(vcFlitIdx);
+	w.writeInts(curPktId);
+}
+
+void InfiniteBWMultiVCSink::restoreCheckpoint(CheckpointReader &r) {
+	Enter_Method_Silent();
+	r.readInts(vcFlitIdx);
+	r.readInts(curPktId);
+	r.checkSize(vcFlitIdx.size(), numVCs, "numVCs");
+}
@@ -19,6 +19,8 @@
 // Behavior
 // This sink is simple - it assumes NO delay on receiving packets
 // so on the received FLIT a credit is generated.
+// Flits fast-forwarded by the FastForward module arrive on directIn and
+// return no credit.
 //
 // PktId check is valid only for single source .
 //
@@ -45,6 +47,8 @@ void InfiniteBWMultiVCSinkperSrc::initialize() {
 	EoPQTime.setName("EoP-queueing-time-ns");
 
 	numReceivedPkt.setName("number-received-packets");
+	hopCount.setName("hop-count");
+	mcastSoPEnd2EndLatency.setName("multicast-SoP-end-to-end-latency-ns");
 
 	// Vectors
 	end2EndLatencyVec.setName("end-to-end-latency-ns");
@@ -58,6 +62,15 @@ void InfiniteBWMultiVCSinkperSrc::initialize() {
 	SoPFirstNetTime.resize(numVCs, 0);
 	statStartTime = par("statStartTime");
 
+	// per source statistics are dense arrays indexed by the source id
+	growPerSrc(par("numNodes"));
+
+	myId = getParentModule()->hasPar("id") ? (int)getParentModule()->par("id") : -1;
+	latencyMatrix = dynamic_cast<LatencyMatrixMonitor*>(
+			getSimulation()->getSystemModule()->getSubmodule("latencyMatrixMonitor"));
+	fastForward = dynamic_cast<FastForward*>(
+			getSimulation()->getSystemModule()->getSubmodule("fastForward"));
+
 	// send the credits to the other size
 	for (int vc = 0; vc < numVCs; vc++)
 		sendCredit(vc, 100);
@@ -73,14 +86,42 @@ void InfiniteBWMultiVCSinkperSrc::sendCredit(int vc, int num) {
 	send(crd, "in$o");
 }
 
+// grow the per source statistics to hold numSrcs sources
+void InfiniteBWMultiVCSinkperSrc::growPerSrc(int numSrcs) {
+	if (numSrcs <= (int)packetLatencyPerSrc.size())
+		return;
+	packetLatencyPerSrc.resize(numSrcs);
+	EoPEnd2EndLatencyPerSrc.resize(numSrcs);
+	packetLatencyPerSrcVC.resize(numSrcs * numVCs);
+}
+
+void InfiniteBWMultiVCSinkperSrc::growPerSL(int numSLs) {
+	if (numSLs <= (int)flitsPerSL.size())
+		return;
+	flitsPerSL.resize(numSLs, 0);
+	SoPEnd2EndLatencyPerSL.resize(numSLs);
+}
+
 void InfiniteBWMultiVCSinkperSrc::handleMessage(cMessage *msg) {
-	NoCFlitMsg *flit = dynamic_cast<NoCFlitMsg*> (msg);
+	if (msg->getKind() != NOC_FLIT_MSG) {
+		throw cRuntimeError("-E- %s does not know how to handle message of type %d",
+				getFullPath().c_str(), msg->getKind());
+	}
+	NoCFlitMsg *flit = (NoCFlitMsg*) msg;
 	int vc = flit->getVC();
-	sendCredit(vc, 1);
+	if (!msg->arrivedOn("directIn")) {
+		sendCredit(vc, 1);
+		if (fastForward)
+			fastForward->checkFlit(flit);
+	}
 
 	// some statistics
 	if (simTime() > statStartTime) {
 		vcFLITs[vc]++;
+		int sl = flit->getSL();
+		if (sl >= (int)flitsPerSL.size())
+			growPerSL(sl + 1);
+		flitsPerSL[sl]++;
 
 		if (flit->getFirstNet()) {
 			throw cRuntimeError(
@@ -100,8 +141,12 @@ void InfiniteBWMultiVCSinkperSrc::handleMessage(cMessage *msg) {
 		if (flit->getType() == NOC_START_FLIT) {
 			SoPEnd2EndLatency.collect(eed_ns);
 			SoPLatency.collect(d_ns);
+			SoPEnd2EndLatencyPerSL[sl].collect(eed_ns);
 			SoPQTime.collect(1e9 * (flit->getInjectTime().dbl()
 					- msg->getCreationTime().dbl()));
+			hopCount.collect(flit->getHops());
+			if (flit->getDstMaskArraySize() > 0)
+				mcastSoPEnd2EndLatency.collect(eed_ns);
 
 			if (SoPFirstNetTime[vc] == 0) {
 				SoPFirstNetTime[vc] = flit->getFirstNetTime();
@@ -115,15 +160,21 @@ void InfiniteBWMultiVCSinkperSrc::handleMessage(cMessage *msg) {
 		}
 
 		if (flit->getType() == NOC_END_FLIT) {
+			int srcId = flit->getSrcId();
+			if (srcId >= (int)packetLatencyPerSrc.size())
+				growPerSrc(srcId + 1);
 			EoPEnd2EndLatency.collect(eed_ns);
-			EoPEnd2EndLatencyPerSrc[flit->getSrcId()].collect(eed_ns);
+			EoPEnd2EndLatencyPerSrc[srcId].collect(eed_ns);
 
 			EoPLatency.collect(d_ns);
 			EoPQTime.collect(1e9 * (flit->getInjectTime().dbl() - msg->getCreationTime()).dbl());
 			if (SoPFirstNetTime[vc] != 0) { // avoid collecting statistics when statStartTime is between SoP and EoP
 				double pLat = 1e9 * (simTime().dbl() - SoPFirstNetTime[vc].dbl());
 				packetLatency.collect(pLat);
-				packetLatencyPerSrc[flit->getSrcId()].collect(pLat);
+				packetLatencyPerSrc[srcId].collect(pLat);
+				packetLatencyPerSrcVC[srcId * numVCs + vc].collect(pLat);
+				if (latencyMatrix)
+					latencyMatrix->collect(srcId, myId >= 0 ? myId : flit->getDstId(), pLat);
 			}
 			SoPFirstNetTime[vc] = 0;
 		}
@@ -198,31 +249,63 @@ void InfiniteBWMultiVCSinkperSrc::finish() {
 		networkLatency.record();
 		end2EndLatency.record();
 
+		hopCount.record();
+		if (mcastSoPEnd2EndLatency.getCount())
+			mcastSoPEnd2EndLatency.record();
 		numReceivedPkt.collect(numRecPkt);
 		numReceivedPkt.record();
 		double BW_MBps = 1e-6 * totalFlits * flitSize_B / (simTime().dbl()- statStartTime);
 		recordScalar("Sink-Total-BW-MBps", BW_MBps);
 
-		// iterate over all src stat
-		std::map<int, cStdDev>::iterator mI;
-		for (mI = packetLatencyPerSrc.begin(); mI != packetLatencyPerSrc.end(); mI++) {
-			int srcId = (*mI).first;
-			char pLname[256];
-			sprintf(pLname, "packet-network-latency-ns-%d", srcId);
-			packetLatencyPerSrc[srcId].setName(pLname);
-			packetLatencyPerSrc[srcId].record();
+		// per QoS SL latency and throughput
+		for (unsigned int sl = 0; sl < flitsPerSL.size(); sl++) {
+			char slName[64];
+			if (SoPEnd2EndLatencyPerSL[sl].getCount()) {
+				sprintf(slName, "SoP-end-to-end-latency-ns-SL-%d", sl);
+				SoPEnd2EndLatencyPerSL[sl].setName(slName);
+				SoPEnd2EndLatencyPerSL[sl].record();
+			}
+			if (flitsPerSL[sl]) {
+				sprintf(slName, "Sink-SL-%d-BW-MBps", sl);
+				recordScalar(slName, 1e-6 * flitsPerSL[sl] * flitSize_B / (simTime().dbl()- statStartTime));
+			}
 		}
-		packetLatencyPerSrc.clear();
-
 
-		for (mI = EoPEnd2EndLatencyPerSrc.begin(); mI != EoPEnd2EndLatencyPerSrc.end(); mI++) {
-			int srcId = (*mI).first;
-			char e2elname[256];
-			sprintf(e2elname, "EoP-end-to-end-latency-ns-%d", srcId);
-			EoPEnd2EndLatencyPerSrc[srcId].setName(e2elname);
-			EoPEnd2EndLatencyPerSrc[srcId].record();
+		// per src and per src and VC stat - only the sources we received from
+		for (unsigned int srcId = 0; srcId < packetLatencyPerSrc.size(); srcId++) {
+			char pLname[64];
+			if (packetLatencyPerSrc[srcId].getCount()) {
+				sprintf(pLname, "packet-network-latency-ns-%d", srcId);
+				packetLatencyPerSrc[srcId].setName(pLname);
+				packetLatencyPerSrc[srcId].record();
+			}
+			if (EoPEnd2EndLatencyPerSrc[srcId].getCount()) {
+				sprintf(pLname, "EoP-end-to-end-latency-ns-%d", srcId);
+				EoPEnd2EndLatencyPerSrc[srcId].setName(pLname);
+				EoPEnd2EndLatencyPerSrc[srcId].record();
+			}
+			for (int vc = 0; vc < numVCs; vc++) {
+				cStdDev &s = packetLatencyPerSrcVC[srcId * numVCs + vc];
+				if (!s.getCount())
+					continue;
+				sprintf(pLname, "packet-network-latency-ns-%d-vc-%d", srcId, vc);
+				s.setName(pLname);
+				s.record();
+			}
 		}
-		EoPEnd2EndLatencyPerSrc.clear();
 
 	}
 }
+
+// only the packet order check state - the statistics restart on restore
+void InfiniteBWMultiVCSinkperSrc::saveCheckpoint(CheckpointWriter &w) {
+	w.writeInts(vcFlitIdx);
+	w.writeInts(curPktId);
+}
+
+void InfiniteBWMultiVCSinkperSrc::restoreCheckpoint(CheckpointReader &r) {
+	Enter_Method_Silent();
+	r.readInts(vcFlitIdx);
+	r.readInts(curPktId);
+	r.checkSize(vcFlitIdx.size(), numVCs, "numVCs");
+}
@@ -23,12 +23,16 @@
 using namespace omnetpp;
 
 #include "NoCs_m.h"
+#include "monitors/LatencyMatrixMonitor.h"
+#include "fastForward/FastForward.h"
+#include "checkpoint/Checkpoint.h"
 //
 // The InfiniteBWMultiVCSinkperSrc is consuming FLITs
 //
-class InfiniteBWMultiVCSinkperSrc: public cSimpleModule {
+class InfiniteBWMultiVCSinkperSrc: public cSimpleModule, public Checkpointable {
 private:
 	int numVCs;
+	int myId; // the id of the core (-1 if unknown - use the flit dstId)
 	simtime_t statStartTime; // in sec
 	int numRecPkt; // number of received packets, assume that onlt single source is transmitting
 	// statistics
@@ -42,14 +46,19 @@ private:
 	cStdDev SoPQTime; // Queuing-time the packet, collect here and not in the source to make sure that I collect statistics
 
 	cStdDev EoPEnd2EndLatency; // source queuing + network-latency (for Head flit only)
-	std::map<int, cStdDev> EoPEnd2EndLatencyPerSrc; // source queuing + network-latency (for Head flit only)
+	std::vector<cStdDev> EoPEnd2EndLatencyPerSrc; // source queuing + network-latency per source (for Tail flit only)
 
 	cStdDev EoPLatency; // network-latency
 	cStdDev EoPQTime; // Queuing-time the packet, collect here and not in the source to make sure that I collect statistics
 
 	cStdDev packetLatency; // total packet network latency, SoP (1st transmit) -> EoP (received @ sink)
-	std::map<int, cStdDev> packetLatencyPerSrc; // total packet network latency, SoP (1st transmit) -> EoP (received @ sink)
+	std::vector<cStdDev> packetLatencyPerSrc; // total packet network latency per source, SoP (1st transmit) -> EoP (received @ sink)
+	std::vector<cStdDev> packetLatencyPerSrcVC; // total packet network latency per [source * numVCs + vc]
 
+	cStdDev hopCount; // number of routers traversed by the packet
+	cStdDev mcastSoPEnd2EndLatency; // source queuing + network-latency of multicast packets to this destination (for Head flit only)
+	std::vector<cStdDev> SoPEnd2EndLatencyPerSL; // source queuing + network-latency per QoS SL (for Head flit only)
+	std::vector<double> flitsPerSL; // number of received flits per QoS SL
 	cStdDev numReceivedPkt; // number of received packets, assume that only single source is transmitting
 
 	std::vector<int> vcFLITs;
@@ -58,11 +67,26 @@ private:
 
 	std::vector<simtime_t> SoPFirstNetTime; // save the SoP First Trans time until EoP arrive
 
+	LatencyMatrixMonitor *latencyMatrix; // the network latency matrix (NULL if none)
+	FastForward *fastForward; // checks the flits of verified packets (NULL if none)
+
 	void sendCredit(int vc, int num);
+	void growPerSrc(int numSrcs);
+	void growPerSL(int numSLs);
 protected:
 	virtual void initialize();
 	virtual void handleMessage(cMessage *msg);
 	virtual void finish();
+public:
+	const cStdDev &getSoPEnd2EndLatency() const { return SoPEnd2EndLatency; }
+	long getNumReceivedFlits() const {
+		long n = 0;
+		for (int vc = 0; vc < numVCs; vc++)
+			n += vcFLITs[vc];
+		return n;
+	}
+	virtual void saveCheckpoint(CheckpointWriter &w);
+	virtual void restoreCheckpoint(CheckpointReader &r);
 };
 
 #endif
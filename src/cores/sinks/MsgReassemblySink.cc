@@ -0,0 +1,321 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#include "MsgReassemblySink.h"
+
+Define_Module(MsgReassemblySink);
+
+void MsgReassemblySink::initialize() {
+	numVCs = par("numVCs");
+	reorderBufFlits = par("reorderBufFlits");
+	ejectBufFlits = par("ejectBufFlits");
+	maxPktFlits = par("maxPktFlits");
+	if ((maxPktFlits < 1) || (ejectBufFlits <= maxPktFlits)) {
+		throw cRuntimeError("-E- %s ejectBufFlits %d must exceed maxPktFlits %d",
+				getFullPath().c_str(), ejectBufFlits, maxPktFlits);
+	}
+	statStartTime = par("statStartTime");
+	vcMsg.resize(numVCs, MsgKey(-1, -1));
+	vcPktIdx.resize(numVCs, -1);
+	vcWaitFlits.resize(numVCs, 0);
+	robFlits = 0;
+	WATCH(robFlits);
+	fastForward = dynamic_cast<FastForward*>(
+			getSimulation()->getSystemModule()->getSubmodule("fastForward"));
+
+	numFlits = 0;
+	numRecPkt = 0;
+	numRecMsg = 0;
+	numReordered = 0;
+	numStalled = 0;
+	msgLatency.setName("message-latency-ns");
+	SoPEnd2EndLatency.setName("SoP-end-to-end-latency-ns");
+	hopCount.setName("hop-count");
+	robOccupancy.init("reorder-buffer-flits", statStartTime);
+
+	// the ejection buffers
+	for (int vc = 0; vc < numVCs; vc++)
+		sendCredit(vc, ejectBufFlits);
+}
+
+void MsgReassemblySink::sendCredit(int vc, int num) {
+	if (!num)
+		return;
+	char credName[64];
+	sprintf(credName, "cred-%d-%d", vc, num);
+	NoCCreditMsg *crd = new NoCCreditMsg(credName);
+	crd->setKind(NOC_CREDIT_MSG);
+	crd->setVC(vc);
+	crd->setFlits(num);
+	send(crd, "in$o");
+}
+
+bool MsgReassemblySink::hasRoom(int flits) const {
+	return (reorderBufFlits <= 0) || (robFlits + flits <= reorderBufFlits);
+}
+
+// a packet head - deliver it, reserve the reorder buffer or wait for room
+void MsgReassemblySink::startPkt(NoCFlitMsg *flit) {
+	int vc = flit->getVC();
+	int idx = flit->getMsgPktIdx();
+	if (vcPktIdx[vc] >= 0) {
+		throw cRuntimeError("-E- %s got packet 0x%x during a packet of message %d on vc %d",
+				getFullPath().c_str(), flit->getPktId(), vcMsg[vc].second, vc);
+	}
+	if ((reorderBufFlits > 0) && (flit->getFlits() > reorderBufFlits)) {
+		throw cRuntimeError("-E- %s packet of %d flits can never fit the %d flits reorder buffer",
+				getFullPath().c_str(), flit->getFlits(), reorderBufFlits);
+	}
+	if (flit->getFlits() > maxPktFlits) {
+		throw cRuntimeError("-E- %s packet of %d flits is longer than maxPktFlits %d",
+				getFullPath().c_str(), flit->getFlits(), maxPktFlits);
+	}
+
+	MsgKey key(flit->getSrcId(), flit->getMsgId());
+	RxMsg &m = msgs[key];
+	if (!m.numPkts) {
+		m.numPkts = flit->getMsgPkts();
+		m.nextPkt = 0;
+		m.created = flit->getMsgTime();
+	}
+	if ((idx < m.nextPkt) || (idx >= m.numPkts) || m.pkts.count(idx)) {
+		throw cRuntimeError("-E- %s unexpected packet %d of message %d from source %d",
+				getFullPath().c_str(), idx, key.second, key.first);
+	}
+
+	RxPkt &p = m.pkts[idx];
+	p.flits = flit->getFlits();
+	p.received = 0;
+	p.held = 0;
+	p.vc = vc;
+	if (idx == m.nextPkt) {
+		p.mode = RX_DELIVER;
+	} else {
+		if (simTime() > statStartTime)
+			numReordered++;
+		if (waitPkts.empty() && hasRoom(p.flits)) {
+			p.mode = RX_STORE;
+			robFlits += p.flits;
+			robOccupancy.set(robFlits);
+		} else {
+			// the credits kept for in-order packets may not be held
+			if (vcWaitFlits[vc] + p.flits > ejectBufFlits - maxPktFlits) {
+				throw cRuntimeError("-E- %s waiting packets would hold the credits of VC %d "
+						"kept for in-order packets - reorderBufFlits %d is too small",
+						getFullPath().c_str(), vc, reorderBufFlits);
+			}
+			vcWaitFlits[vc] += p.flits;
+			p.mode = RX_WAIT;
+			waitPkts.push_back(std::make_pair(key, idx));
+			if (simTime() > statStartTime)
+				numStalled++;
+		}
+	}
+	vcMsg[vc] = key;
+	vcPktIdx[vc] = idx;
+}
+
+// deliver the packets of the message that are next in order. The packet
+// becoming next releases its reorder buffer room or stops waiting even if
+// not fully received - its remaining flits are delivered as they arrive
+void MsgReassemblySink::deliverInOrder(const MsgKey &key) {
+	std::map<MsgKey, RxMsg>::iterator mit = msgs.find(key);
+	RxMsg &m = mit->second;
+	for (;;) {
+		std::map<int, RxPkt>::iterator it = m.pkts.find(m.nextPkt);
+		if (it == m.pkts.end())
+			break;
+		RxPkt &p = it->second;
+		if (p.mode == RX_STORE) {
+			robFlits -= p.flits;
+		} else if (p.mode == RX_WAIT) {
+			waitPkts.remove(std::make_pair(key, m.nextPkt));
+			vcWaitFlits[p.vc] -= p.flits;
+			sendCredit(p.vc, p.held);
+			p.held = 0;
+		}
+		p.mode = RX_DELIVER;
+		if (p.received < p.flits)
+			break;
+		m.pkts.erase(it);
+		if (++m.nextPkt == m.numPkts) {
+			if (simTime() > statStartTime) {
+				msgLatency.collect(1e9 * (simTime() - m.created).dbl());
+				numRecMsg++;
+			}
+			msgs.erase(mit);
+			break;
+		}
+	}
+	robOccupancy.set(robFlits);
+	admitWaiting();
+}
+
+// packets waiting for the reorder buffer are admitted in arrival order
+void MsgReassemblySink::admitWaiting() {
+	while (waitPkts.size()) {
+		RxPkt &p = msgs[waitPkts.front().first].pkts[waitPkts.front().second];
+		if (!hasRoom(p.flits))
+			break;
+		p.mode = RX_STORE;
+		robFlits += p.flits;
+		vcWaitFlits[p.vc] -= p.flits;
+		sendCredit(p.vc, p.held);
+		p.held = 0;
+		waitPkts.pop_front();
+	}
+	robOccupancy.set(robFlits);
+}
+
+void MsgReassemblySink::handleMessage(cMessage *msg) {
+	if (msg->getKind() != NOC_FLIT_MSG) {
+		throw cRuntimeError("-E- %s does not know how to handle message of type %d",
+				getFullPath().c_str(), msg->getKind());
+	}
+	NoCFlitMsg *flit = (NoCFlitMsg*) msg;
+	int vc = flit->getVC();
+	// fast-forwarded flits (see FastForward) return no credit
+	bool credit = !msg->arrivedOn("directIn");
+	if (credit && fastForward)
+		fastForward->checkFlit(flit);
+
+	if (simTime() > statStartTime) {
+		numFlits++;
+		if (flit->getType() == NOC_START_FLIT) {
+			SoPEnd2EndLatency.collect(1e9 * (simTime() - msg->getCreationTime()).dbl());
+			hopCount.collect(flit->getHops());
+			numRecPkt++;
+		}
+	}
+
+	if (flit->getType() == NOC_START_FLIT)
+		startPkt(flit);
+	MsgKey key(flit->getSrcId(), flit->getMsgId());
+	if ((vcPktIdx[vc] < 0) || (vcMsg[vc] != key)
+			|| (vcPktIdx[vc] != flit->getMsgPktIdx())) {
+		throw cRuntimeError("-E- %s flit %s is not of the packet received on vc %d",
+				getFullPath().c_str(), flit->getName(), vc);
+	}
+
+	RxPkt &p = msgs[key].pkts[vcPktIdx[vc]];
+	p.received++;
+	if (p.mode == RX_WAIT) {
+		if (credit)
+			p.held++;
+	} else if (credit) {
+		sendCredit(vc, 1);
+	}
+	if (flit->getType() == NOC_END_FLIT) {
+		if (p.received != p.flits) {
+			throw cRuntimeError("-E- %s packet 0x%x ended after %d of its %d flits",
+					getFullPath().c_str(), flit->getPktId(), p.received, p.flits);
+		}
+		vcPktIdx[vc] = -1;
+		if (p.mode == RX_DELIVER)
+			deliverInOrder(key);
+	}
+	delete msg;
+}
+
+void MsgReassemblySink::finish() {
+	if (simTime() > statStartTime) {
+		msgLatency.record();
+		SoPEnd2EndLatency.record();
+		hopCount.record();
+		recordScalar("number-received-packets", numRecPkt);
+		recordScalar("number-received-messages", numRecMsg);
+		recordScalar("reordered-packets", numReordered);
+		recordScalar("reorder-stalled-packets", numStalled);
+		robOccupancy.record();
+		int flitSize_B = par("flitSize");
+		double BW_MBps = 1e-6 * numFlits * flitSize_B / (simTime().dbl() - statStartTime.dbl());
+		recordScalar("Sink-Total-BW-MBps", BW_MBps);
+	}
+}
+
+// the reassembly state - the statistics restart on restore
+void MsgReassemblySink::saveCheckpoint(CheckpointWriter &w) {
+	w.writeInt(numVCs);
+	w.writeInt(msgs.size());
+	for (std::map<MsgKey, RxMsg>::iterator mit = msgs.begin(); mit != msgs.end(); mit++) {
+		RxMsg &m = mit->second;
+		w.writeInt(mit->first.first);
+		w.writeInt(mit->first.second);
+		w.writeInt(m.numPkts);
+		w.writeInt(m.nextPkt);
+		w.writeTime(m.created);
+		w.writeInt(m.pkts.size());
+		for (std::map<int, RxPkt>::iterator it = m.pkts.begin(); it != m.pkts.end(); it++) {
+			w.writeInt(it->first);
+			w.writeInt(it->second.flits);
+			w.writeInt(it->second.received);
+			w.writeInt(it->second.held);
+			w.writeInt(it->second.mode);
+			w.writeInt(it->second.vc);
+		}
+	}
+	for (int vc = 0; vc < numVCs; vc++) {
+		w.writeInt(vcMsg[vc].first);
+		w.writeInt(vcMsg[vc].second);
+	}
+	w.writeInts(vcPktIdx);
+	w.writeInt(waitPkts.size());
+	std::list< std::pair<MsgKey,int> >::iterator it;
+	for (it = waitPkts.begin(); it != waitPkts.end(); it++) {
+		w.writeInt(it->first.first);
+		w.writeInt(it->first.second);
+		w.writeInt(it->second);
+	}
+	w.writeInt(robFlits);
+	w.writeInts(vcWaitFlits);
+}
+
+void MsgReassemblySink::restoreCheckpoint(CheckpointReader &r) {
+	Enter_Method_Silent();
+	r.checkSize(r.readInt(), numVCs, "numVCs");
+	msgs.clear();
+	int numMsgs = r.readInt();
+	for (int i = 0; i < numMsgs; i++) {
+		int src = r.readInt();
+		RxMsg &m = msgs[MsgKey(src, r.readInt())];
+		m.numPkts = r.readInt();
+		m.nextPkt = r.readInt();
+		m.created = r.readTime();
+		int numPkts = r.readInt();
+		for (int j = 0; j < numPkts; j++) {
+			RxPkt &p = m.pkts[r.readInt()];
+			p.flits = r.readInt();
+			p.received = r.readInt();
+			p.held = r.readInt();
+			p.mode = r.readInt();
+			p.vc = r.readInt();
+		}
+	}
+	for (int vc = 0; vc < numVCs; vc++) {
+		int src = r.readInt();
+		vcMsg[vc] = MsgKey(src, r.readInt());
+	}
+	r.readInts(vcPktIdx);
+	waitPkts.clear();
+	int numWait = r.readInt();
+	for (int i = 0; i < numWait; i++) {
+		int src = r.readInt();
+		int id = r.readInt();
+		waitPkts.push_back(std::make_pair(MsgKey(src, id), r.readInt()));
+	}
+	robFlits = r.readInt();
+	r.readInts(vcWaitFlits);
+	robOccupancy.set(robFlits);
+}
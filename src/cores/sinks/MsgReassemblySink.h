@@ -0,0 +1,121 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#ifndef __HNOCS_MSG_REASSEMBLY_SINK_H_
+#define __HNOCS_MSG_REASSEMBLY_SINK_H_
+
+#include <omnetpp.h>
+#include <list>
+#include <map>
+using namespace omnetpp;
+
+#include "NoCs_m.h"
+#include "stats/OccupancyStat.h"
+#include "checkpoint/Checkpoint.h"
+#include "fastForward/FastForward.h"
+
+//
+// The NI receive side: reassembles the messages segmented by the source
+// (see PktFifoSrc) and delivers their packets in order
+//
+// The packets of a message may arrive out of order when they are spread on
+// several VCs or routed adaptively. A packet that is the next one of its
+// message is delivered as it arrives. Others are kept in a reorder buffer of
+// reorderBufFlits (0 - unbounded) reserved when their head arrives, and
+// delivered once the packets before them were. A packet finding the reorder
+// buffer full waits in its ejection VC: the credits of its flits are not
+// returned until it gets room (in arrival order) or becomes the next packet
+// of its message. The buffer must hold the packets of the messages in flight,
+// a too small one back-pressures the network.
+//
+// Each ejection VC has ejectBufFlits credits. Waiting packets never hold the
+// last maxPktFlits of them, so the next packet of a message can always be
+// received whatever VC the last router put it on. A waiting packet that would
+// hold them is an error (reorderBufFlits too small) rather than a deadlock.
+//
+// Packets of different messages and sources are interleaved freely, the
+// flits of a packet are contiguous on their VC.
+//
+// Statistics: message-latency-ns (message creation to its last packet
+// delivered), number-received-messages, reorder-buffer-flits (time weighted
+// occupancy), reordered-packets, reorder-stalled-packets and the packet
+// SoP-end-to-end-latency-ns, number-received-packets, hop-count and
+// Sink-Total-BW-MBps
+//
+class MsgReassemblySink: public cSimpleModule, public Checkpointable {
+private:
+	enum { RX_DELIVER, RX_STORE, RX_WAIT };
+
+	// a packet received but not delivered yet
+	struct RxPkt {
+		int flits;    // packet length
+		int received; // flits received so far
+		int held;     // received flits whose credits were not returned (RX_WAIT)
+		int mode;     // RX_DELIVER, RX_STORE (in the reorder buffer) or RX_WAIT
+		int vc;
+	};
+	typedef std::pair<int,int> MsgKey; // (srcId, msgId)
+	struct RxMsg {
+		int numPkts;
+		int nextPkt;       // the next packet to deliver
+		simtime_t created; // the message creation time
+		std::map<int, RxPkt> pkts; // by index in the message
+	};
+
+	// parameters
+	int numVCs;
+	int reorderBufFlits;
+	int ejectBufFlits;
+	int maxPktFlits;
+	simtime_t statStartTime;
+
+	// state
+	std::map<MsgKey, RxMsg> msgs;
+	std::vector<MsgKey> vcMsg;   // the message of the packet received on each VC
+	std::vector<int> vcPktIdx;   // its index in the message (-1 if none)
+	std::list< std::pair<MsgKey,int> > waitPkts; // packets waiting for room in arrival order
+	int robFlits;                // reserved reorder buffer flits
+	std::vector<int> vcWaitFlits; // flits of the waiting packets per VC
+	FastForward *fastForward;    // checks the flits of verified packets (NULL if none)
+
+	// statistics
+	long numFlits;
+	int numRecPkt;
+	int numRecMsg;
+	long numReordered;
+	long numStalled;
+	cStdDev msgLatency;
+	cStdDev SoPEnd2EndLatency;
+	cStdDev hopCount;
+	OccupancyStat robOccupancy;
+
+	void sendCredit(int vc, int num);
+	bool hasRoom(int flits) const;
+	void startPkt(NoCFlitMsg *flit);
+	void deliverInOrder(const MsgKey &key);
+	void admitWaiting();
+
+protected:
+	virtual void initialize();
+	virtual void handleMessage(cMessage *msg);
+	virtual void finish();
+public:
+	const cStdDev &getSoPEnd2EndLatency() const { return SoPEnd2EndLatency; }
+	long getNumReceivedFlits() const { return numFlits; }
+	virtual void saveCheckpoint(CheckpointWriter &w);
+	virtual void restoreCheckpoint(CheckpointReader &r);
+};
+
+#endif
@@ -27,7 +27,6 @@ Define_Module(PktFifoSrc)
 ;
 
 void PktFifoSrc::initialize() {
-	credits = 0;
 	pktIdx = 0;
 	flitIdx = 0;
 	flitSize_B = par("flitSize");
@@ -38,11 +37,24 @@ void PktFifoSrc::initialize() {
 	numQueuedPkts = 0;
 	WATCH(numQueuedPkts);
 	WATCH(curPktLen);
+	WATCH_VECTOR(credits);
+	numVCs = par("numVCs");
+	credits.resize(numVCs, 0);
+	numSLs = par("numSLs");
+	if ((numSLs < 1) || (numSLs > numVCs)) {
+		throw cRuntimeError("-E- %s numSLs:%d must be 1..numVCs:%d",
+				getFullPath().c_str(), numSLs, numVCs);
+	}
 	srcId = par("srcId");
 	curPktLen = 1; // use 1 to avoid zero delay on first packet
 	curPktId = srcId << 16;
 	popMsg = NULL;
+	genMsg = NULL;
+	ffBusyUntil = SIMTIME_ZERO;
+	fastForward = dynamic_cast<FastForward*>(
+			getSimulation()->getSystemModule()->getSubmodule("fastForward"));
 	numSentPackets = 0;
+	numMcastPackets = 0;
 	numSentPkt.setName("number-sent-packets");
 	numGenPackets = 0;
 	numGenPkt.setName("number-generated-packets");
@@ -53,7 +65,8 @@ void PktFifoSrc::initialize() {
 	FullQueueIndicator.setName("Full_Queue_Indicator");
 	FullQueueIndicator.collect(0); // initial with zero, if there wont be other collects then it should remain zero
 
-	queueSize.setName("source-queue-size-percent");
+	// time weighted - updated on every change of numQueuedPkts
+	queueSize.init("source-queue-size-percent", statStartTime, 1.0 / maxQueuedPkts);
 
 	// a dstId parameter of -1 turns off the source...
 	dstId = par("dstId");
@@ -64,7 +77,9 @@ void PktFifoSrc::initialize() {
 		sprintf(genMsgName, "gen-%d", srcId);
 		genMsg = new cMessage(genMsgName);
 
-		scheduleAt(simTime(), genMsg);
+		// a restored source continues from the checkpoint state
+		if (!Checkpoint::isRestoring(this))
+			scheduleAt(simTime(), genMsg);
 		dstIdHist.setName("dstId-Hist");
 		dstIdHist.setMode(cHistogram::MODE_INTEGERS);
 		dstIdHist.setBinSizeHint(1.0);
@@ -88,11 +103,21 @@ void PktFifoSrc::initialize() {
 		popMsg = new NoCPopMsg(popMsgName);
 		popMsg->setKind(NOC_POP_MSG);
 		// start in the low phase to avoid race
-		scheduleAt(tClk_s*0.5, popMsg);
+		if (!Checkpoint::isRestoring(this))
+			scheduleAt(tClk_s*0.5, popMsg);
 
 		// handling messages
 		curPktIdx = 0;
 		curMsgLen = 0;
+		msgIdx = 0;
+		msgPktLen = 1;
+		curMsgFlitsLeft = 0;
+		curMsgVC = 0;
+		msgVCs = par("msgVCs");
+		if ((msgVCs < 1) || (msgVCs > numVCs)) {
+			throw cRuntimeError("-E- %s msgVCs must be 1 .. numVCs (%d)",
+					getFullPath().c_str(), numVCs);
+		}
 
 		isTrace=par("isTrace");
 		if(isTrace) {
@@ -126,22 +151,35 @@ void PktFifoSrc::initialize() {
 
 		// send the FLIT out and schedule the next pop
 void PktFifoSrc::sendFlitFromQ() {
-	if (Q.isEmpty() || (credits <= 0))
+	if (Q.isEmpty())
+		return;
+	int vc = ((NoCFlitMsg*) Q.front())->getVC();
+	if ((vc < 0) || (vc >= numVCs)) {
+		throw cRuntimeError("-E- %s flit %s is on VC %d of %d VCs",
+				getFullPath().c_str(), Q.front()->getName(), vc, numVCs);
+	}
+	if (credits[vc] <= 0)
 		return;
 	if (!isSynchronous && popMsg->isScheduled())
 		return;
+	if (simTime() < ffBusyUntil)
+		return;
+	if (fastForward && (((NoCFlitMsg*) Q.front())->getType() == NOC_START_FLIT)
+			&& fastForwardPkt())
+		return;
 
 	NoCFlitMsg* flit = (NoCFlitMsg*) Q.pop();
 
 	// we count number of outstanding packets
 	if (flit->getType() == NOC_END_FLIT) {
 		numQueuedPkts--;
+		queueSize.set(numQueuedPkts);
 		numSentPackets++;
 	}
 	flit->setInjectTime(simTime());
 	EV<< "-I- " << getFullPath() << "flit injected at time: " << flit->getInjectTime() << endl;
 	send(flit, "out$o");
-	credits--;
+	credits[vc]--;
 
 	if (!isSynchronous) {
 		// sched the pop
@@ -154,6 +192,36 @@ void PktFifoSrc::sendFlitFromQ() {
 	}
 }
 
+// hybrid simulation: send the packet at the head of the Q directly to its
+// sink if the FastForward module finds its path idle. The flits keep the
+// inject and first router times they would have on the out link
+bool PktFifoSrc::fastForwardPkt() {
+	NoCFlitMsg *head = (NoCFlitMsg*) Q.front();
+	FastForward::Plan plan;
+	if (!fastForward->planPacket(gate("out$o"), head, plan))
+		return false;
+
+	int numFlits = head->getFlits();
+	for (int i = 0; i < numFlits; i++) {
+		NoCFlitMsg *flit = (NoCFlitMsg*) Q.pop();
+		flit->setInjectTime(simTime() + i * plan.srcFlitTime);
+		flit->setFirstNetTime(plan.firstNetTime + i * plan.srcFlitTime);
+		flit->setFirstNet(false);
+		if (i == 0)
+			flit->setHops(plan.hops);
+		sendDirect(flit, plan.headArrival - simTime() + i * plan.flitTime,
+				SIMTIME_ZERO, plan.sink, "directIn");
+	}
+	numQueuedPkts--;
+	queueSize.set(numQueuedPkts);
+	numSentPackets++;
+
+	ffBusyUntil = simTime() + numFlits * plan.srcFlitTime;
+	if (!isSynchronous)
+		scheduleAt(ffBusyUntil, popMsg);
+	return true;
+}
+
 // generate a new packet and Q all its flits
 void PktFifoSrc::handleGenMsg(cMessage *msg) {
 	// if we already queued too many packets wait for a next gen ...
@@ -161,24 +229,72 @@ void PktFifoSrc::handleGenMsg(cMessage *msg) {
 
 	if (numQueuedPkts < maxQueuedPkts) {
 		numQueuedPkts++;
+		queueSize.set(numQueuedPkts);
 		totalNumQPackets++;
 
 		// we change destination and packet length on MESSAGE boundary
 		if (curPktIdx == curMsgLen) {
-			curMsgLen = par("msgLen");
-			if (curMsgLen <= 0) {
+			dstId = par("dstId");
+			msgPktLen = par("pktLen");
+			// segment a message of msgSize bytes into packets of pktLen flits
+			int msgSize = par("msgSize");
+			if (msgSize > 0) {
+				curMsgFlitsLeft = (msgSize + flitSize_B - 1) / flitSize_B;
+				// a packet has a head and a tail flit - a single flit tail is padded
+				if (curMsgFlitsLeft % msgPktLen == 1)
+					curMsgFlitsLeft++;
+				curMsgLen = (curMsgFlitsLeft + msgPktLen - 1) / msgPktLen;
+			} else {
+				curMsgFlitsLeft = 0;
+				curMsgLen = par("msgLen");
+			}
+			if ((curMsgLen <= 0) || (msgPktLen <= 0)) {
 				throw cRuntimeError("-E- can not handle <= 0 packets message");
 			}
 			curPktIdx = 0;
-			dstId = par("dstId");
-			curPktLen = par("pktLen");
+			msgIdx++;
+			curMsgTime = simTime();
+			if (msgVCs > 1) {
+				curMsgVC = par("pktVC");
+				if ((curMsgVC < 0) || (curMsgVC + msgVCs > numVCs)) {
+					throw cRuntimeError("-E- %s pktVC %d + msgVCs %d exceeds the %d VCs",
+							getFullPath().c_str(), curMsgVC, msgVCs, numVCs);
+				}
+			}
+			parseMcastDsts();
+		}
+		if (msgVCs > 1) {
+			curPktVC = curMsgVC + curPktIdx % msgVCs;
+		} else {
+			curPktVC = par("pktVC");
+			if ((curPktVC < 0) || (curPktVC >= numVCs)) {
+				throw cRuntimeError("-E- %s pktVC %d is not one of the %d VCs",
+						getFullPath().c_str(), curPktVC, numVCs);
+			}
+		}
+		curPktLen = msgPktLen;
+		if (curMsgFlitsLeft) {
+			if (curPktLen > curMsgFlitsLeft)
+				curPktLen = curMsgFlitsLeft;
+			curMsgFlitsLeft -= curPktLen;
+		}
+		curPktSL = par("pktSL");
+		if ((curPktSL < 0) || (curPktSL >= numSLs)) {
+			throw cRuntimeError("-E- %s pktSL %d is not one of the %d SLs",
+					getFullPath().c_str(), curPktSL, numSLs);
+		}
+		if (vcToSL(curPktVC, numSLs, numVCs) != curPktSL) {
+			throw cRuntimeError("-E- %s pktVC %d is not one of the VCs %d..%d of pktSL %d",
+					getFullPath().c_str(), curPktVC, slFirstVC(curPktSL, numSLs, numVCs),
+					slFirstVC(curPktSL + 1, numSLs, numVCs) - 1, curPktSL);
 		}
-		curPktVC = par("pktVC");
 		dstIdHist.collect(dstId);
 		dstIdVec.record(dstId);
 		pktIdx++;
 		curPktId = (srcId << 16) + pktIdx;
 		curPktIdx++;
+		if (curMsgDstMask.size())
+			numMcastPackets++;
 
 		for (flitIdx = 0; flitIdx < curPktLen; flitIdx++) {
 			char flitName[128];
@@ -189,6 +305,7 @@ void PktFifoSrc::handleGenMsg(cMessage *msg) {
 			flit->setByteLength(flitSize_B);
 			flit->setBitLength(8 * flitSize_B);
 			flit->setVC(curPktVC);
+			flit->setSL(curPktSL);
 			flit->setSrcId(srcId);
 			flit->setDstId(dstId);
 			flit->setPktId(curPktId);
@@ -196,9 +313,17 @@ void PktFifoSrc::handleGenMsg(cMessage *msg) {
 			flit->setSchedulingPriority(0);
 			flit->setFirstNet(true);
 			flit->setFlits(curPktLen);
+			flit->setMsgId(msgIdx);
+			flit->setMsgPkts(curMsgLen);
+			flit->setMsgPktIdx(curPktIdx - 1);
+			flit->setMsgTime(curMsgTime);
 
 			if (flitIdx == 0) {
 				flit->setType(NOC_START_FLIT);
+				// only the head carries the multicast destinations
+				flit->setDstMaskArraySize(curMsgDstMask.size());
+				for (unsigned int id = 0; id < curMsgDstMask.size(); id++)
+					flit->setDstMask(id, curMsgDstMask[id]);
 			} else if (flitIdx == curPktLen - 1) {
 				flit->setType(NOC_END_FLIT);
 			} else {
@@ -214,7 +339,6 @@ void PktFifoSrc::handleGenMsg(cMessage *msg) {
 			FullQueueIndicator.collect(1);
 		}
 	}
-	queueSize.collect(1.0*numQueuedPkts / maxQueuedPkts);
 	// schedule next gen
 	if (isTrace) {
 		scheduleAt(simTime() + packetArrivalDelayArray[traceIndex
@@ -226,13 +350,50 @@ void PktFifoSrc::handleGenMsg(cMessage *msg) {
 	}
 }
 
+// obtain the multicast destinations of a new message. dstId is set to the
+// first of them
+void PktFifoSrc::parseMcastDsts() {
+	curMsgDstMask.clear();
+	std::string dsts = par("mcastDstIds").stdstringValue();
+	if (dsts == "")
+		return;
+
+	std::vector<int> ids;
+	if (dsts == "all") {
+		int numCores = par("numCores");
+		if (numCores <= 0) {
+			throw cRuntimeError("-E- %s broadcast requires the numCores parameter",
+					getFullPath().c_str());
+		}
+		for (int id = 0; id < numCores; id++)
+			if (id != srcId)
+				ids.push_back(id);
+	} else {
+		ids = cStringTokenizer(dsts.c_str(), " ,").asIntVector();
+	}
+
+	for (unsigned int i = 0; i < ids.size(); i++) {
+		if (ids[i] < 0) {
+			throw cRuntimeError("-E- %s bad multicast destination %d",
+					getFullPath().c_str(), ids[i]);
+		}
+		if (ids[i] >= (int)curMsgDstMask.size())
+			curMsgDstMask.resize(ids[i] + 1, false);
+		curMsgDstMask[ids[i]] = true;
+	}
+	if (ids.size())
+		dstId = ids[0];
+}
+
 void PktFifoSrc::handleCreditMsg(NoCCreditMsg *msg) {
 	int vc = msg->getVC();
 	int flits = msg->getFlits();
 	delete msg;
-	if (vc == 0) {
-		credits += flits;
+	if ((vc < 0) || (vc >= numVCs)) {
+		throw cRuntimeError("-E- %s got credits of VC %d of %d VCs",
+				getFullPath().c_str(), vc, numVCs);
 	}
+	credits[vc] += flits;
 	if (!isSynchronous)
 		sendFlitFromQ();
 }
@@ -264,6 +425,8 @@ void PktFifoSrc::finish() {
 	numQPkt.collect(totalNumQPackets);
 	numQPkt.record();
 	queueSize.record();
+	if (numMcastPackets)
+		recordScalar("number-sent-multicast-packets", numMcastPackets);
 
 	if (numGenPackets != 0) {
 		lossProb.collect(1 - (totalNumQPackets / numGenPackets));
@@ -273,6 +436,66 @@ void PktFifoSrc::finish() {
 	lossProb.record();
 }
 
+void PktFifoSrc::saveCheckpoint(CheckpointWriter &w) {
+	w.writeInt(pktIdx);
+	w.writeInt(curPktLen);
+	w.writeInt(curPktId);
+	w.writeInt(curPktVC);
+	w.writeInt(curPktSL);
+	w.writeInt((int)numQueuedPkts);
+	w.writeInt(curMsgDst);
+	w.writeInt(curMsgLen);
+	w.writeInt(curPktIdx);
+	w.writeInt(msgIdx);
+	w.writeTime(curMsgTime);
+	w.writeInt(msgPktLen);
+	w.writeInt(curMsgFlitsLeft);
+	w.writeInt(curMsgVC);
+	w.writeInt(dstId);
+	w.writeInt(traceIndex);
+	w.writeBools(curMsgDstMask);
+	w.writeInts(credits);
+	w.writeQueue(Q);
+	w.writeTime(ffBusyUntil);
+	w.writeMsg(popMsg);
+	w.writeMsg(genMsg);
+}
+
+void PktFifoSrc::restoreCheckpoint(CheckpointReader &r) {
+	Enter_Method_Silent();
+	pktIdx = r.readInt();
+	curPktLen = r.readInt();
+	curPktId = r.readInt();
+	curPktVC = r.readInt();
+	curPktSL = r.readInt();
+	numQueuedPkts = r.readInt();
+	curMsgDst = r.readInt();
+	curMsgLen = r.readInt();
+	curPktIdx = r.readInt();
+	msgIdx = r.readInt();
+	curMsgTime = r.readTime();
+	msgPktLen = r.readInt();
+	curMsgFlitsLeft = r.readInt();
+	curMsgVC = r.readInt();
+	dstId = r.readInt();
+	traceIndex = r.readInt();
+	r.readBools(curMsgDstMask);
+	r.readInts(credits);
+	r.checkSize(credits.size(), numVCs, "numVCs");
+	r.readQueue(Q);
+	ffBusyUntil = r.readTime();
+	queueSize.set(numQueuedPkts);
+
+	cancelAndDelete(popMsg);
+	popMsg = check_and_cast_nullable<NoCPopMsg*>(r.readMsg());
+	if (popMsg)
+		take(popMsg);
+	cancelAndDelete(genMsg);
+	genMsg = r.readMsg();
+	if (genMsg)
+		take(genMsg);
+}
+
 PktFifoSrc::~PktFifoSrc() {
 	int dstId = par("dstId");
 
@@ -23,12 +23,34 @@
 using namespace omnetpp;
 
 #include "NoCs_m.h"
+#include "stats/OccupancyStat.h"
+#include "checkpoint/Checkpoint.h"
+#include "fastForward/FastForward.h"
+#include "routers/hier/HierRouter.h"
 
 #define MAXTRACESIZE 500000
 //
-// A simple source of Packets made out of FLITs on a single VC (0)
+// A simple source of Packets made out of FLITs. The VC and QoS SL are
+// drawn per packet from the pktVC and pktSL parameters and credits are
+// tracked per VC. The VC must be one of the SL VCs (see slFirstVC in
+// HierRouter.h), so packets of different SLs never share an injection VC.
 //
-class PktFifoSrc: public cSimpleModule {
+// Messages: a message of msgSize bytes is segmented into packets of pktLen
+// flits, the last one carrying the remaining flits (msgSize 0 - messages of
+// msgLen packets). With msgVCs > 1 the packets of a message are spread round
+// robin on the VCs pktVC .. pktVC+msgVCs-1 (pktVC drawn per message). Every
+// flit carries its message id, size in packets and packet index so the
+// destination can reassemble it (see MsgReassemblySink).
+//
+// Multicast: when mcastDstIds is not empty the message packets are sent once
+// with a destination mask and replicated by the routers. dstId is then the
+// first destination.
+//
+// Fast-forward: with a FastForward module in the network, a packet about to
+// be sent on an idle path is delivered directly to its sink. The out link is
+// then kept busy for the packet flits (ffBusyUntil).
+//
+class PktFifoSrc: public cSimpleModule, public Checkpointable {
 private:
 	// parameters:
 	int srcId;
@@ -50,11 +72,21 @@ private:
 	int curPktLen;
 	int curPktId;
 	int curPktVC;
+	int curPktSL;
 	double numQueuedPkts;
 	int maxQueuedPkts;
 	int curMsgDst;			// the destination of the current msg
 	int curMsgLen;			// length in packets of current msg
 	int curPktIdx;          // the packet index in the msg
+	int msgIdx;             // number of messages generated
+	simtime_t curMsgTime;   // creation time of the current msg
+	int msgPktLen;          // the segment length of the current msg
+	int curMsgFlitsLeft;    // flits of the current msg not segmented yet (0 - no msgSize)
+	int curMsgVC;           // the first VC of the current msg
+	int msgVCs;             // number of VCs a msg is spread on
+	int numVCs;
+	int numSLs;
+	std::vector<bool> curMsgDstMask; // multicast destinations of the current msg (empty for unicast)
 
 	int numSentPackets;// number of sent packets, assume that there is only single destination
 	double numGenPackets; // number of generated packets, for loss probability
@@ -62,22 +94,27 @@ private:
 	cQueue Q;
 	NoCPopMsg *popMsg; // used to pop packets modeling the wire BW
 	cMessage  *genMsg; // used to gen next flit
-	int credits;       // number of credits on VC=0
+	std::vector<int> credits; // number of credits per VC
 	double tClk_s;     // clk extracted from output channel
+	FastForward *fastForward; // the network FastForward module (NULL if none)
+	simtime_t ffBusyUntil;    // the out link carries a fast-forwarded packet
 
 	// Statistics
 	cHistogram dstIdHist;
 	cOutVector dstIdVec;
 	cStdDev FullQueueIndicator; // If >0 then the queue was full during the simulation
-	cStdDev queueSize; // queue fill in % tracked every generation event
+	OccupancyStat queueSize; // time weighted queue fill (fraction of maxQueuedPkts)
 	cStdDev numSentPkt; // number of sent packets, assume that there is only single destination
 	cStdDev numGenPkt; // number of generated packets, for loss probability
 	cStdDev numQPkt; // number of queued packets, for loss probability
+	int numMcastPackets; // number of sent multicast packets
 	cStdDev lossProb; // probability to throw packet i.e. source queue is full and therefore the packet is discarded
 
 	// methods
 	void sendFlitFromQ();
+	bool fastForwardPkt();
 	void handleGenMsg(cMessage *msg);
+	void parseMcastDsts();
 	void handleCreditMsg(NoCCreditMsg *msg);
 	void handlePopMsg(cMessage *msg);
 
@@ -88,6 +125,10 @@ protected:
 
 public:
     virtual ~PktFifoSrc();
+    int getNumQueuedPkts() const { return (int)numQueuedPkts; }
+    int getMaxQueuedPkts() const { return maxQueuedPkts; }
+    virtual void saveCheckpoint(CheckpointWriter &w);
+    virtual void restoreCheckpoint(CheckpointReader &r);
 };
 
 #endif
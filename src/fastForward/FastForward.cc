@@ -0,0 +1,241 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#include "FastForward.h"
+
+Define_Module(FastForward);
+
+// no static route is that long - guards against routing loops
+#define FF_MAX_HOPS 4096
+
+void FastForward::initialize()
+{
+	verify = par("verify");
+	numForwarded = 0;
+	numDetailed = 0;
+	numVerified = 0;
+	WATCH(numForwarded);
+	WATCH(numDetailed);
+	WATCH(numVerified);
+}
+
+void FastForward::handleMessage(cMessage *msg)
+{
+	throw cRuntimeError("Does not know how to handle message of type %d", msg->getKind());
+}
+
+bool FastForward::isInPortEmpty(InPort *inPort) const
+{
+	int numVCs = inPort->par("numVCs");
+	for (int vc = 0; vc < numVCs; vc++)
+		if (inPort->getNumQueuedFlits(vc))
+			return false;
+	return true;
+}
+
+bool FastForward::isRouterEmpty(cModule *router) const
+{
+	int numPorts = router->par("numPorts");
+	for (int p = 0; p < numPorts; p++) {
+		cModule *port = router->getSubmodule("port", p);
+		InPort *inPort = port ? dynamic_cast<InPort*>(port->getSubmodule("inPort")) : NULL;
+		if (inPort && !isInPortEmpty(inPort))
+			return false;
+	}
+	return true;
+}
+
+// the propagation delay from g to the end of its path
+static simtime_t pathDelay(cGate *g)
+{
+	simtime_t delay = SIMTIME_ZERO;
+	for (; g; g = g->getNextGate()) {
+		cChannel *c = g->getChannel();
+		if (cDelayChannel *dc = dynamic_cast<cDelayChannel*>(c))
+			delay += dc->getDelay();
+		else if (cDatarateChannel *rc = dynamic_cast<cDatarateChannel*>(c))
+			delay += rc->getDelay();
+	}
+	return delay;
+}
+
+// the time the transmission channel of g takes to send the flit
+static simtime_t flitDuration(cGate *g, NoCFlitMsg *flit)
+{
+	cDatarateChannel *c = dynamic_cast<cDatarateChannel*>(g->getTransmissionChannel());
+	if (!c || (c->getDatarate() <= 0))
+		return SIMTIME_ZERO;
+	return flit->getBitLength() / c->getDatarate();
+}
+
+// Follow the route of the head and compute the zero load timing of every
+// hop the way the InPortSync/SchedSync pipeline does it:
+//   the head arrives to the InPort, its Req is sent after RC+VA+SA and
+//   crosses the SwCtrlLink, the Sched grants it on its next clock, the Gnt
+//   crosses the SwCtrlLink back, the InPort sends the flit after ST over the
+//   SwLink and the Sched forwards it on its out link.
+// The body flits are granted one per clock. Return false if any hop is
+// contended or is not modelled exactly
+bool FastForward::planPath(cGate *srcOut, NoCFlitMsg *head, Plan &plan,
+		std::vector<Hop> &hops)
+{
+	int numFlits = head->getFlits();
+	cDatarateChannel *chan = dynamic_cast<cDatarateChannel*>(srcOut->getTransmissionChannel());
+	if (!chan || chan->isBusy())
+		return false;
+	simtime_t flitTime = flitDuration(srcOut, head);
+	if (flitTime <= SIMTIME_ZERO)
+		return false;
+	simtime_t arrival = simTime() + flitTime + pathDelay(srcOut);
+	simtime_t upSend = simTime(); // the head sent by the source or granted upstream
+	bool isLookahead = false;
+	plan.srcFlitTime = flitTime;
+	plan.firstNetTime = arrival;
+	plan.hops = 0;
+
+	cGate *g = srcOut->getPathEndGate();
+	InPort *inPort;
+	while ((inPort = dynamic_cast<InPort*>(g->getOwnerModule())) != NULL) {
+		if (plan.hops >= FF_MAX_HOPS) {
+			throw cRuntimeError("-E- %s routing loop of packet 0x%x at %s",
+					getFullPath().c_str(), head->getPktId(), inPort->getFullPath().c_str());
+		}
+		// only the synchronous InPort pipeline is modelled, without SMART
+		if (!isInPortEmpty(inPort) || !inPort->hasPar("rcDelay")
+				|| ((int)inPort->par("smartHpcMax") > 0))
+			return false;
+		cModule *port = inPort->getParentModule();
+		cModule *router = port->getParentModule();
+		PowerCtrl *powerCtrl = dynamic_cast<PowerCtrl*>(router->getSubmodule("powerCtrl"));
+		if (powerCtrl && !powerCtrl->isAwake())
+			return false;
+		cModule *vcCalc = port->getSubmodule("vcCalc");
+		if (vcCalc && vcCalc->hasPar("numExpressVCs") && ((int)vcCalc->par("numExpressVCs") > 0))
+			return false;
+		OPCalc *opCalc = dynamic_cast<OPCalc*>(port->getSubmodule("opCalc"));
+		if (!opCalc)
+			return false;
+		int op = opCalc->calcOutPort(head);
+		cGate *reqGate = inPort->gate("ctrl$o", op);
+		Sched *sched = dynamic_cast<Sched*>(reqGate->getPathEndGate()->getOwnerModule());
+		if (!sched || !sched->isIdle())
+			return false;
+
+		// the body flits are granted one per clock and follow the head
+		// without gaps only if all the links carry a flit in a clock
+		cGate *outGate = sched->gate("out$o", 0);
+		if ((sched->getClockPeriod() != flitTime) || (flitDuration(outGate, head) != flitTime))
+			return false;
+
+		// RC is saved by lookahead routing of the previous router
+		simtime_t reqDelay;
+		if ((bool)inPort->par("bypass") && isRouterEmpty(router)) {
+			reqDelay = SIMTIME_ZERO;
+		} else {
+			reqDelay = inPort->par("vaDelay").doubleValue() + inPort->par("saDelay").doubleValue();
+			if (!isLookahead)
+				reqDelay += inPort->par("rcDelay").doubleValue();
+		}
+		simtime_t grant = sched->getGrantTime(arrival + reqDelay + pathDelay(reqGate));
+		int ip = reqGate->getPathEndGate()->getIndex();
+		simtime_t gntArrival = grant + pathDelay(sched->gate("ctrl$o", ip));
+
+		// the InPort returns the credit of a flit as its Gnt arrives. The
+		// upstream must get it before it sends the flit flitsPerVC later,
+		// otherwise the packet stalls on credits
+		int flitsPerVC = inPort->par("flitsPerVC");
+		if ((numFlits > flitsPerVC)
+				&& (gntArrival + pathDelay(inPort->gate("in$o")) >= upSend + flitsPerVC * flitTime))
+			return false;
+
+		Hop hop;
+		hop.sched = sched;
+		hop.from = grant;
+		hop.to = grant + numFlits * flitTime;
+		hops.push_back(hop);
+		plan.hops++;
+
+		cGate *swGate = inPort->gate("out", op);
+		simtime_t send = gntArrival + inPort->par("stDelay").doubleValue()
+				+ flitDuration(swGate, head) + pathDelay(swGate);
+		arrival = send + flitTime + pathDelay(outGate);
+		upSend = grant;
+		isLookahead = inPort->par("lookahead");
+		g = outGate->getPathEndGate();
+	}
+
+	if (!plan.hops || !g->getOwnerModule()->hasGate("directIn"))
+		return false;
+	plan.sink = g->getOwnerModule();
+	plan.headArrival = arrival;
+	plan.flitTime = flitTime;
+	return true;
+}
+
+bool FastForward::planPacket(cGate *srcOut, NoCFlitMsg *head, Plan &plan)
+{
+	Enter_Method_Silent();
+	std::vector<Hop> hops;
+	bool ok = !head->getDstMaskArraySize() && planPath(srcOut, head, plan, hops);
+	for (unsigned int h = 0; ok && (h < hops.size()); h++)
+		ok = hops[h].sched->canReserveLink(hops[h].from, hops[h].to);
+	if (ok && verify) {
+		// simulated in detail - its flits must arrive as planned
+		Expected &e = expected[head->getPktId()];
+		e.headArrival = plan.headArrival;
+		e.flitTime = plan.flitTime;
+		e.flits = head->getFlits();
+		e.received = 0;
+	}
+	if (!ok || verify) {
+		numDetailed++;
+		return false;
+	}
+
+	for (unsigned int h = 0; h < hops.size(); h++)
+		hops[h].sched->reserveLink(hops[h].from, hops[h].to);
+	numForwarded++;
+	EV << "-I- " << getFullPath() << " packet 0x" << std::hex << head->getPktId()
+	   << std::dec << " fast-forwarded over " << plan.hops << " routers to "
+	   << plan.sink->getFullPath() << " arriving at " << plan.headArrival << endl;
+	return true;
+}
+
+void FastForward::checkFlit(NoCFlitMsg *flit)
+{
+	Enter_Method_Silent();
+	std::map<int, Expected>::iterator it = expected.find(flit->getPktId());
+	if (it == expected.end())
+		return;
+	Expected &e = it->second;
+	simtime_t planned = e.headArrival + e.received * e.flitTime;
+	if (simTime() != planned) {
+		throw cRuntimeError("-E- %s flit %d of packet 0x%x arrived at %s but was planned "
+				"to arrive at %s", getFullPath().c_str(), e.received, flit->getPktId(),
+				simTime().str().c_str(), planned.str().c_str());
+	}
+	if (++e.received == e.flits) {
+		expected.erase(it);
+		numVerified++;
+	}
+}
+
+void FastForward::finish()
+{
+	recordScalar("fast-forwarded-packets", numForwarded);
+	recordScalar("detailed-packets", numDetailed);
+	if (verify)
+		recordScalar("verified-packets", numVerified);
+}
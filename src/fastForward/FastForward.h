@@ -0,0 +1,118 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#ifndef __HNOCS_FAST_FORWARD_H_
+#define __HNOCS_FAST_FORWARD_H_
+
+#include <omnetpp.h>
+#include <map>
+#include <vector>
+using namespace omnetpp;
+
+#include "NoCs_m.h"
+#include "routers/hier/HierRouter.h"
+
+//
+// Hybrid analytic/detailed simulation
+//
+// A source about to inject a packet asks the module to plan it (planPacket).
+// The path is followed through the OPCalc of every router. If every hop is
+// uncontended - the InPort the packet enters is empty on all its VCs, the
+// Sched of the out port has no pending Req and a free link, and the router is
+// awake - the packet is not simulated hop by hop. The zero load timing of
+// each hop is computed as the detailed routers would produce it: the InPort
+// pipeline (RC+VA+SA, RC saved by lookahead after the first hop, none with
+// bypass into an empty router), the Req and Gnt delays of the SwCtrlLink, the
+// Sched grant clock, ST, the SwLink and the out link. The delays are read from
+// the channels of the router. Each Sched is then reserved for the grant
+// clocks of the packet flits and the source sends them directly to the sink
+// (directIn gate) at their computed arrival. Packets of contended paths are
+// simulated in detail.
+//
+// The flits are modelled following the head one per clock, so a path is
+// fast-forwarded only if all its links carry a flit in a Sched clock and no
+// InPort buffer shorter than the packet would stall it on credits.
+//
+// The reserved clocks keep the detailed packets from overlapping the
+// fast-forwarded ones: a Sched grants no flit in a reserved window, and no
+// packet head whose flits would reach one (see SchedSync). A detailed packet
+// reaching a router on the path after the plan was made is therefore the
+// one that waits, as if it lost the arbitration.
+//
+// With verify the packets are planned but simulated in detail and the sinks
+// check every flit arrives at its planned time (checkFlit). It checks the
+// model against the detailed routers and must run on traffic that does not
+// contend after the plan, e.g. a single source.
+//
+// Only unicast packets through synchronous routers are fast-forwarded. SMART
+// and express VCs are not modelled. Fast-forwarded flits are not counted by
+// the router statistics and energy model. Statistics: fast-forwarded-packets,
+// detailed-packets and verified-packets scalars
+//
+class FastForward : public cSimpleModule
+{
+public:
+	// the delivery of a fast-forwarded packet
+	struct Plan {
+		cModule *sink;          // the sink module (directIn gate)
+		int hops;               // routers traversed
+		simtime_t srcFlitTime;  // flit time on the source link
+		simtime_t firstNetTime; // the head arrival to the first router
+		simtime_t headArrival;  // the head arrival to the sink
+		simtime_t flitTime;     // flit spacing at the sink (slowest link)
+	};
+
+private:
+	// a Sched granting the packet flits during [from, to)
+	struct Hop {
+		Sched *sched;
+		simtime_t from;
+		simtime_t to;
+	};
+
+	// verify: the planned arrival of a packet simulated in detail
+	struct Expected {
+		simtime_t headArrival;
+		simtime_t flitTime;
+		int flits;
+		int received;
+	};
+
+	bool verify;
+	std::map<int, Expected> expected; // by packet id
+	long numForwarded;
+	long numDetailed;
+	long numVerified;
+
+	bool isInPortEmpty(InPort *inPort) const;
+	bool isRouterEmpty(cModule *router) const;
+	bool planPath(cGate *srcOut, NoCFlitMsg *head, Plan &plan, std::vector<Hop> &hops);
+
+protected:
+	virtual void initialize();
+	virtual void handleMessage(cMessage *msg);
+	virtual void finish();
+
+public:
+	// called by a source on the head of a packet it may send now. Returns
+	// true and reserves the path if the packet should be fast-forwarded
+	bool planPacket(cGate *srcOut, NoCFlitMsg *head, Plan &plan);
+
+	// called by a sink on every flit received from the network. Throws if
+	// a verified packet does not arrive as planned
+	void checkFlit(NoCFlitMsg *flit);
+};
+
+#endif
@@ -0,0 +1,269 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#include "DeadlockMonitor.h"
+#include <sstream>
+
+Define_Module(DeadlockMonitor);
+
+void DeadlockMonitor::initialize()
+{
+	checkPeriod = par("checkPeriod");
+	stallChecks = par("stallChecks");
+	maxReqWait = par("maxReqWait");
+	errorOnDeadlock = par("errorOnDeadlock");
+	if (checkPeriod <= 0) {
+		throw cRuntimeError("-E- %s checkPeriod must be positive", getFullPath().c_str());
+	}
+
+	prevNumGrants = -1;
+	numStalledChecks = 0;
+	deadlocked = false;
+	livelocked = false;
+	cycleLen = 0;
+	WATCH(numStalledChecks);
+
+	checkMsg = new cMessage("deadlock-check");
+	scheduleAt(simTime() + checkPeriod, checkMsg);
+}
+
+void DeadlockMonitor::handleMessage(cMessage *msg)
+{
+	if (msg != checkMsg) {
+		throw cRuntimeError("Does not know how to handle message of type %d", msg->getKind());
+	}
+	check();
+	scheduleAt(simTime() + checkPeriod, checkMsg);
+}
+
+// find all the Scheds of the network
+void DeadlockMonitor::collectScheds(cModule *mod)
+{
+	for (cModule::SubmoduleIterator it(mod); !it.end(); it++) {
+		cModule *sub = *it;
+		Sched *sched = dynamic_cast<Sched *>(sub);
+		if (sched)
+			scheds.push_back(sched);
+		else if (!sub->isSimple())
+			collectScheds(sub);
+	}
+}
+
+int DeadlockMonitor::getNode(InPort *inPort, int vc)
+{
+	std::pair<int,int> key(inPort->getId(), vc);
+	std::map<std::pair<int,int>, int>::iterator it = nodeIdx.find(key);
+	if (it != nodeIdx.end())
+		return it->second;
+	int n = nodes.size();
+	nodeIdx[key] = n;
+	nodes.push_back(std::pair<InPort*,int>(inPort, vc));
+	edges.resize(n + 1);
+	return n;
+}
+
+// build the wait-for graph between the InPort VC buffers holding flits.
+// Return the creation time of the oldest blocked Req and its Sched
+void DeadlockMonitor::buildGraph(simtime_t &oldestReq, Sched *&oldestSched)
+{
+	nodeIdx.clear();
+	nodes.clear();
+	edges.clear();
+	oldestSched = NULL;
+
+	std::vector<Sched::BlockedReq> reqs;
+	for (unsigned int s = 0; s < scheds.size(); s++) {
+		Sched *sched = scheds[s];
+		reqs.clear();
+		sched->getBlockedReqs(reqs);
+		if (!reqs.size())
+			continue;
+
+		// the InPort on the other side of the out link (NULL for a core)
+		InPort *down = dynamic_cast<InPort *>(
+				sched->gate("out$o", 0)->getPathEndGate()->getOwnerModule());
+
+		for (unsigned int r = 0; r < reqs.size(); r++) {
+			Sched::BlockedReq &b = reqs[r];
+			if (!oldestSched || (b.since < oldestReq)) {
+				oldestReq = b.since;
+				oldestSched = sched;
+			}
+			// only packets holding a buffer take part in a deadlock
+			if (!b.inPort || !b.inPort->getNumQueuedFlits(b.inVC))
+				continue;
+			int from = getNode(b.inPort, b.inVC);
+			WaitEdge e;
+			e.sched = sched;
+			e.outVC = b.outVC;
+			if (b.noCredits && down && down->getNumQueuedFlits(b.outVC)) {
+				e.to = getNode(down, b.outVC);
+				e.noCredits = true;
+				edges[from].push_back(e);
+			}
+			if (b.holder && ((b.holder != b.inPort) || (b.holderInVC != b.inVC))
+					&& b.holder->getNumQueuedFlits(b.holderInVC)) {
+				e.to = getNode(b.holder, b.holderInVC);
+				e.noCredits = false;
+				edges[from].push_back(e);
+			}
+		}
+	}
+}
+
+// iterative DFS looking for a back edge. Return the nodes of the cycle and
+// the edge leaving each of them
+bool DeadlockMonitor::findCycle(std::vector<int> &cycleNodes, std::vector<WaitEdge> &cycleEdges)
+{
+	int numNodes = nodes.size();
+	std::vector<int> color(numNodes, 0); // 0 - new, 1 - on stack, 2 - done
+	std::vector< std::pair<int,unsigned int> > stack; // node, next edge
+
+	for (int s = 0; s < numNodes; s++) {
+		if (color[s])
+			continue;
+		color[s] = 1;
+		stack.push_back(std::pair<int,unsigned int>(s, 0));
+		while (stack.size()) {
+			int u = stack.back().first;
+			unsigned int i = stack.back().second;
+			if (i == edges[u].size()) {
+				color[u] = 2;
+				stack.pop_back();
+				continue;
+			}
+			stack.back().second++;
+			int v = edges[u][i].to;
+			if (!color[v]) {
+				color[v] = 1;
+				stack.push_back(std::pair<int,unsigned int>(v, 0));
+			} else if (color[v] == 1) {
+				unsigned int first = 0;
+				while (stack[first].first != v)
+					first++;
+				for (unsigned int j = first; j < stack.size(); j++) {
+					int n = stack[j].first;
+					cycleNodes.push_back(n);
+					cycleEdges.push_back(edges[n][stack[j].second - 1]);
+				}
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+std::string DeadlockMonitor::nodeName(int n) const
+{
+	std::ostringstream s;
+	s << nodes[n].first->getFullPath() << " VC " << nodes[n].second;
+	return s.str();
+}
+
+void DeadlockMonitor::reportAndStop(bool isDeadlock, const std::string &report)
+{
+	if (isDeadlock)
+		deadlocked = true;
+	else
+		livelocked = true;
+	detectTime = simTime();
+	EV << "-E- " << getFullPath() << " " << report << endl;
+	if (errorOnDeadlock) {
+		throw cRuntimeError("-E- %s %s", getFullPath().c_str(), report.c_str());
+	}
+	endSimulation();
+}
+
+void DeadlockMonitor::check()
+{
+	scheds.clear();
+	collectScheds(getSimulation()->getSystemModule());
+
+	simtime_t oldestReq;
+	Sched *oldestSched;
+	buildGraph(oldestReq, oldestSched);
+
+	long numGrants = 0;
+	for (unsigned int s = 0; s < scheds.size(); s++)
+		numGrants += scheds[s]->getNumGrants();
+
+	// deadlock - the same cycle with no grant on its Scheds since the last check
+	std::vector<int> cycleNodes;
+	std::vector<WaitEdge> cycleEdges;
+	if (findCycle(cycleNodes, cycleEdges)) {
+		std::vector<long> sig;
+		for (unsigned int i = 0; i < cycleNodes.size(); i++) {
+			sig.push_back(nodes[cycleNodes[i]].first->getId());
+			sig.push_back(nodes[cycleNodes[i]].second);
+			sig.push_back(cycleEdges[i].sched->getNumGrants());
+		}
+		if (sig == prevCycleSig) {
+			cycleLen = cycleNodes.size();
+			std::ostringstream s;
+			s << "deadlock: cycle of " << cycleLen << " VC buffers at " << simTime() << endl;
+			for (unsigned int i = 0; i < cycleNodes.size(); i++) {
+				const WaitEdge &e = cycleEdges[i];
+				s << "  " << nodeName(cycleNodes[i]) << " waits at "
+				  << e.sched->getFullPath() << " VC " << e.outVC
+				  << (e.noCredits ? " (no credits) for " : " (VC owned) by ")
+				  << nodeName(e.to) << endl;
+			}
+			reportAndStop(true, s.str());
+			return;
+		}
+		EV << "-I- " << getFullPath() << " wait-for cycle of " << cycleNodes.size()
+		   << " VC buffers found - checking it again in " << checkPeriod << endl;
+		prevCycleSig = sig;
+	} else {
+		prevCycleSig.clear();
+	}
+
+	// livelock - no progress at all while Reqs are blocked
+	if (oldestSched && (numGrants == prevNumGrants))
+		numStalledChecks++;
+	else
+		numStalledChecks = 0;
+	prevNumGrants = numGrants;
+	if (stallChecks && (numStalledChecks >= stallChecks)) {
+		std::ostringstream s;
+		s << "livelock: no flit was granted since " << simTime() - numStalledChecks * checkPeriod
+		  << " while Reqs are blocked - oldest at " << oldestSched->getFullPath();
+		reportAndStop(false, s.str());
+		return;
+	}
+
+	// starvation - a Req blocked for too long
+	if ((maxReqWait > 0) && oldestSched && (simTime() - oldestReq > maxReqWait)) {
+		std::ostringstream s;
+		s << "livelock: a Req is blocked at " << oldestSched->getFullPath()
+		  << " since " << oldestReq;
+		reportAndStop(false, s.str());
+	}
+}
+
+void DeadlockMonitor::finish()
+{
+	recordScalar("deadlock-detected", deadlocked);
+	recordScalar("livelock-detected", livelocked);
+	if (deadlocked || livelocked)
+		recordScalar("deadlock-time", detectTime);
+	if (deadlocked)
+		recordScalar("deadlock-cycle-length", cycleLen);
+}
+
+DeadlockMonitor::~DeadlockMonitor()
+{
+	cancelAndDelete(checkMsg);
+}
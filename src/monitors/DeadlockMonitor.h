@@ -0,0 +1,104 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#ifndef __HNOCS_DEADLOCK_MONITOR_H_
+#define __HNOCS_DEADLOCK_MONITOR_H_
+
+#include <omnetpp.h>
+#include <map>
+#include <vector>
+using namespace omnetpp;
+
+#include "routers/hier/HierRouter.h"
+
+//
+// Runtime deadlock and livelock monitor
+//
+// Every checkPeriod the monitor collects the blocked Reqs of all the Scheds
+// of the network (see Sched::getBlockedReqs) and builds the channel wait-for
+// graph. Its nodes are the InPort VC buffers holding packets. A packet
+// waits for:
+//  * the downstream InPort VC buffer of its out VC if the Sched has no
+//    credits for that VC
+//  * the buffer of the packet owning its out VC (wormhole allocates the VC
+//    to a single packet up to its EoP)
+//  * the buffer of the packet ahead of it in the Sched queue of its InPort and VC
+//
+// A cycle found on two consecutive checks with no grant made in between by
+// any of the Scheds on it is a deadlock. The cycle is dumped with the module
+// paths and the run is stopped.
+//
+// Livelock/starvation: the run is also stopped if no Sched of the network
+// made a grant for stallChecks consecutive checks while Reqs are blocked,
+// or if a Req is blocked longer than maxReqWait.
+//
+// The network is scanned on every check so routers created at run time
+// (Generic topology) are monitored too.
+//
+// Statistics: deadlock-detected (0/1), deadlock-time, deadlock-cycle-length
+// and livelock-detected (0/1) scalars
+//
+class DeadlockMonitor : public cSimpleModule
+{
+private:
+	// parameters
+	simtime_t checkPeriod;
+	int stallChecks;        // checks with no grant before declaring a stall (0 = off)
+	simtime_t maxReqWait;   // max time a Req may be blocked (0 = off)
+	bool errorOnDeadlock;   // throw an error instead of ending the run
+
+	// a wait-for graph edge between InPort VC buffers
+	struct WaitEdge {
+		int to;           // node index
+		Sched *sched;     // the Sched the Req is blocked on
+		int outVC;
+		bool noCredits;
+	};
+
+	// state
+	cMessage *checkMsg;
+	std::vector<Sched*> scheds;
+	std::map<std::pair<int,int>, int> nodeIdx; // (InPort module id, VC) -> node
+	std::vector<std::pair<InPort*,int> > nodes;
+	std::vector< std::vector<WaitEdge> > edges;
+	std::vector<long> prevCycleSig; // nodes and grants of the last check cycle
+	long prevNumGrants;
+	int numStalledChecks;
+
+	// statistics
+	bool deadlocked;
+	bool livelocked;
+	simtime_t detectTime;
+	int cycleLen;
+
+	// methods
+	void collectScheds(cModule *mod);
+	int getNode(InPort *inPort, int vc);
+	void buildGraph(simtime_t &oldestReq, Sched *&oldestSched);
+	bool findCycle(std::vector<int> &cycleNodes, std::vector<WaitEdge> &cycleEdges);
+	std::string nodeName(int n) const;
+	void reportAndStop(bool isDeadlock, const std::string &report);
+	void check();
+
+protected:
+	virtual void initialize();
+	virtual void handleMessage(cMessage *msg);
+	virtual void finish();
+public:
+	DeadlockMonitor() { checkMsg = NULL; };
+	virtual ~DeadlockMonitor();
+};
+
+#endif
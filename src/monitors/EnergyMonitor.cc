@@ -0,0 +1,113 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#include "EnergyMonitor.h"
+
+Define_Module(EnergyMonitor);
+
+void EnergyMonitor::initialize()
+{
+	bufWriteEnergy = par("bufWriteEnergy");
+	bufReadEnergy = par("bufReadEnergy");
+	xbarEnergy = par("xbarEnergy");
+	arbEnergy = par("arbEnergy");
+	linkEnergy = par("linkEnergy");
+	bufLeakage = par("bufLeakage");
+	routerLeakage = par("routerLeakage");
+	statStartTime = par("statStartTime");
+}
+
+void EnergyMonitor::handleMessage(cMessage *msg)
+{
+	throw cRuntimeError("Does not know how to handle message of type %d", msg->getKind());
+}
+
+// sum the counters of all the InPorts and Scheds under mod. Return true if
+// any was found
+bool EnergyMonitor::addCounters(cModule *mod, EnergyCounters &c)
+{
+	bool found = false;
+	for (cModule::SubmoduleIterator it(mod); !it.end(); it++) {
+		cModule *sub = *it;
+		Sched *sched = dynamic_cast<Sched *>(sub);
+		InPort *inPort = dynamic_cast<InPort *>(sub);
+		if (sched) {
+			sched->addEnergyCounters(c);
+			found = true;
+		} else if (inPort) {
+			inPort->addEnergyCounters(c);
+			found = true;
+		} else if (!sub->isSimple()) {
+			found |= addCounters(sub, c);
+		}
+	}
+	return found;
+}
+
+void EnergyMonitor::finish()
+{
+	if (simTime() <= statStartTime)
+		return;
+	double time_ms = (simTime() - statStartTime).dbl() * 1e3;
+
+	double bufE = 0, xbarE = 0, arbE = 0, linkE = 0, leakE = 0;
+	long deliveredFlits = 0;
+	for (cModule::SubmoduleIterator it(getParentModule()); !it.end(); it++) {
+		cModule *router = *it;
+		if (router->isSimple())
+			continue;
+		EnergyCounters c;
+		if (!addCounters(router, c))
+			continue;
+
+		// voltage scaling of a router with a power controller (DVFS)
+		double dynScale = 1.0, leakScale = 1.0;
+		PowerCtrl *powerCtrl = dynamic_cast<PowerCtrl *>(router->getSubmodule("powerCtrl"));
+		if (powerCtrl) {
+			dynScale = powerCtrl->getDynamicEnergyScale();
+			leakScale = powerCtrl->getLeakageEnergyScale();
+		}
+
+		double rBufE = dynScale * (bufWriteEnergy * c.bufWrites + bufReadEnergy * c.bufReads);
+		double rXbarE = dynScale * xbarEnergy * c.xbarTraversals;
+		double rArbE = dynScale * arbEnergy * c.arbitrations;
+		double rLinkE = dynScale * linkEnergy * c.linkTraversals;
+		// mW * ms = uJ
+		double rLeakE = leakScale * 1e6 * time_ms * (routerLeakage + bufLeakage * c.bufferFlits);
+		std::string name = router->getFullName();
+		recordScalar((name + "-dynamic-energy-pJ").c_str(), rBufE + rXbarE + rArbE + rLinkE);
+		recordScalar((name + "-leakage-energy-pJ").c_str(), rLeakE);
+
+		bufE += rBufE;
+		xbarE += rXbarE;
+		arbE += rArbE;
+		linkE += rLinkE;
+		leakE += rLeakE;
+		deliveredFlits += c.deliveredFlits;
+	}
+
+	double totalE = bufE + xbarE + arbE + linkE + leakE;
+	recordScalar("buffer-energy-pJ", bufE);
+	recordScalar("crossbar-energy-pJ", xbarE);
+	recordScalar("arbiter-energy-pJ", arbE);
+	recordScalar("link-energy-pJ", linkE);
+	recordScalar("leakage-energy-pJ", leakE);
+	recordScalar("total-energy-pJ", totalE);
+	// pJ / ms = nW
+	recordScalar("average-power-mW", 1e-6 * totalE / time_ms);
+	recordScalar("delivered-flits", deliveredFlits);
+	if (deliveredFlits)
+		recordScalar("energy-per-flit-pJ", totalE / deliveredFlits);
+}
@@ -0,0 +1,63 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#ifndef __HNOCS_ENERGY_MONITOR_H_
+#define __HNOCS_ENERGY_MONITOR_H_
+
+#include <omnetpp.h>
+using namespace omnetpp;
+
+#include "routers/hier/HierRouter.h"
+
+//
+// Activity based energy model
+//
+// The InPorts and Scheds always count their energy events (see
+// EnergyCounters in HierRouter.h): buffer writes and reads, crossbar
+// traversals, arbitrations (grants) and link traversals. At the end of the
+// run the monitor sums the counters of every router of the network and
+// multiplies them by the per event energies of the technology table given
+// by the parameters. Leakage is the router static power plus a per buffer
+// flit power, over the time since statStartTime. Both are scaled by the
+// router power controller if there is one (see PowerCtrl in HierRouter.h).
+//
+// Statistics (scalars):
+//   <router>-dynamic-energy-pJ, <router>-leakage-energy-pJ - per router
+//   buffer/crossbar/arbiter/link-energy-pJ - network dynamic energy by component
+//   leakage-energy-pJ, total-energy-pJ, average-power-mW
+//   delivered-flits, energy-per-flit-pJ - total energy per flit sent to a core
+//
+class EnergyMonitor : public cSimpleModule
+{
+private:
+	// technology table
+	double bufWriteEnergy;  // [pJ per flit]
+	double bufReadEnergy;   // [pJ per flit]
+	double xbarEnergy;      // [pJ per flit]
+	double arbEnergy;       // [pJ per grant]
+	double linkEnergy;      // [pJ per flit]
+	double bufLeakage;      // [mW per buffer flit]
+	double routerLeakage;   // [mW per router] crossbar, arbiters and control
+	simtime_t statStartTime;
+
+	bool addCounters(cModule *mod, EnergyCounters &c);
+
+protected:
+	virtual void initialize();
+	virtual void handleMessage(cMessage *msg);
+	virtual void finish();
+};
+
+#endif
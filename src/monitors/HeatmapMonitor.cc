@@ -0,0 +1,198 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#include "HeatmapMonitor.h"
+
+Define_Module(HeatmapMonitor);
+
+void HeatmapMonitor::initialize()
+{
+	window = par("window");
+	ringSize = par("ringSize");
+	const char *format = par("format");
+	if (!strcmp(format, "csv")) {
+		isBinary = false;
+	} else if (!strcmp(format, "bin")) {
+		isBinary = true;
+	} else {
+		throw cRuntimeError("-E- %s unknown format: %s", getFullPath().c_str(), format);
+	}
+	if ((window <= 0) || (ringSize < 1)) {
+		throw cRuntimeError("-E- %s window must be positive and ringSize >= 1",
+				getFullPath().c_str());
+	}
+
+	collected = false;
+	windowStart = simTime();
+	windowIdx = 0;
+	ringCount = 0;
+	windowMsg = new cMessage("heatmap-window");
+	scheduleAt(simTime() + window, windowMsg);
+}
+
+void HeatmapMonitor::handleMessage(cMessage *msg)
+{
+	if (msg != windowMsg) {
+		throw cRuntimeError("Does not know how to handle message of type %d", msg->getKind());
+	}
+	sampleWindow();
+	scheduleAt(simTime() + window, windowMsg);
+}
+
+// find the routers and open the file. Done on the first window so routers
+// built at run time are found too
+void HeatmapMonitor::collect()
+{
+	cModule *network = getParentModule();
+	std::vector<cModule*> routers;
+	numPorts = 0;
+	numVCs = 0;
+	for (cModule::SubmoduleIterator it(network); !it.end(); it++) {
+		cModule *router = *it;
+		if (!router->hasPar("id") || !router->hasPar("numPorts")
+				|| !router->getSubmodule("port", 0))
+			continue;
+		int id = router->par("id");
+		if ((int)routers.size() <= id)
+			routers.resize(id + 1, NULL);
+		routers[id] = router;
+		int n = router->par("numPorts");
+		if (n > numPorts)
+			numPorts = n;
+	}
+	numRouters = routers.size();
+	scheds.resize(numRouters * numPorts, NULL);
+	inPorts.resize(numRouters * numPorts, NULL);
+	for (int r = 0; r < numRouters; r++) {
+		if (!routers[r])
+			continue;
+		for (int p = 0; p < numPorts; p++) {
+			cModule *port = routers[r]->getSubmodule("port", p);
+			if (!port)
+				continue;
+			Sched *sched = dynamic_cast<Sched *>(port->getSubmodule("sched"));
+			if (sched && (sched->getClockPeriod() != SIMTIME_ZERO))
+				scheds[r * numPorts + p] = sched;
+			cModule *inPort = port->getSubmodule("inPort");
+			inPorts[r * numPorts + p] = dynamic_cast<InPort *>(inPort);
+			if (inPorts[r * numPorts + p] && (inPort->par("numVCs").intValue() > numVCs))
+				numVCs = inPort->par("numVCs");
+		}
+	}
+	rows = network->hasPar("rows") ? (int)network->par("rows") : 1;
+	columns = network->hasPar("columns") ? (int)network->par("columns") : numRouters;
+	numValues = numRouters * numPorts * (1 + numVCs);
+	prevBusy.resize(numRouters * numPorts, 0);
+	prevArea.resize(numRouters * numPorts * numVCs, 0);
+	ring.resize(ringSize * numValues);
+	ringTime.resize(ringSize);
+
+	const char *fileName = par("fileName");
+	file = fopen(fileName, isBinary ? "wb" : "w");
+	if (!file) {
+		throw cRuntimeError("-E- %s can not open heatmap file %s",
+				getFullPath().c_str(), fileName);
+	}
+	if (isBinary) {
+		int32_t hdr[5] = { rows, columns, numRouters, numPorts, numVCs };
+		double w = window.dbl();
+		fwrite("HNOCSHM1", 1, 8, file);
+		fwrite(hdr, sizeof(int32_t), 5, file);
+		fwrite(&w, sizeof(double), 1, file);
+	} else {
+		fprintf(file, "# hnocs heatmap rows=%d columns=%d routers=%d ports=%d vcs=%d window=%g\n",
+				rows, columns, numRouters, numPorts, numVCs, window.dbl());
+		fprintf(file, "window,time,router,port,link");
+		for (int vc = 0; vc < numVCs; vc++)
+			fprintf(file, ",vc%d", vc);
+		fprintf(file, "\n");
+	}
+	collected = true;
+}
+
+// the values of the window ending now
+void HeatmapMonitor::sampleWindow()
+{
+	if (!collected)
+		collect();
+	double len = (simTime() - windowStart).dbl();
+	if (len <= 0)
+		return;
+
+	float *v = &ring[ringCount * numValues];
+	ringTime[ringCount] = windowStart.dbl();
+	for (int s = 0; s < numRouters * numPorts; s++) {
+		float *sv = v + s * (1 + numVCs);
+		if (scheds[s]) {
+			double busy = scheds[s]->getBusyTime();
+			double util = (busy - prevBusy[s]) / len;
+			sv[0] = (util > 1.0) ? 1.0 : util;
+			prevBusy[s] = busy;
+		} else {
+			sv[0] = -1;
+		}
+		for (int vc = 0; vc < numVCs; vc++) {
+			if (inPorts[s]) {
+				double area = inPorts[s]->getOccupancyArea(vc);
+				sv[1 + vc] = (area - prevArea[s * numVCs + vc]) / len;
+				prevArea[s * numVCs + vc] = area;
+			} else {
+				sv[1 + vc] = -1;
+			}
+		}
+	}
+	windowStart = simTime();
+	if (++ringCount == ringSize)
+		flush();
+}
+
+void HeatmapMonitor::flush()
+{
+	for (int w = 0; w < ringCount; w++) {
+		float *v = &ring[w * numValues];
+		if (isBinary) {
+			fwrite(&ringTime[w], sizeof(double), 1, file);
+			fwrite(v, sizeof(float), numValues, file);
+			continue;
+		}
+		for (int s = 0; s < numRouters * numPorts; s++) {
+			float *sv = v + s * (1 + numVCs);
+			fprintf(file, "%d,%g,%d,%d,%.4g", windowIdx + w, ringTime[w],
+					s / numPorts, s % numPorts, sv[0]);
+			for (int vc = 0; vc < numVCs; vc++)
+				fprintf(file, ",%.4g", sv[1 + vc]);
+			fprintf(file, "\n");
+		}
+	}
+	windowIdx += ringCount;
+	ringCount = 0;
+	fflush(file);
+}
+
+void HeatmapMonitor::finish()
+{
+	// the last partial window
+	sampleWindow();
+	flush();
+	fclose(file);
+	file = NULL;
+}
+
+HeatmapMonitor::~HeatmapMonitor()
+{
+	cancelAndDelete(windowMsg);
+	if (file)
+		fclose(file);
+}
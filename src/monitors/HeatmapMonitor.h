@@ -0,0 +1,88 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#ifndef __HNOCS_HEATMAP_MONITOR_H_
+#define __HNOCS_HEATMAP_MONITOR_H_
+
+#include <omnetpp.h>
+#include <cstdio>
+#include <vector>
+using namespace omnetpp;
+
+#include "routers/hier/HierRouter.h"
+
+//
+// Time windowed link utilization and buffer occupancy heatmap
+//
+// Every window the monitor computes for each router port:
+//  * the out link busy fraction - from Sched::getBusyTime
+//  * the time weighted occupancy of each in VC [flits] - from
+//    InPort::getOccupancyArea
+// The values of a window are kept in a ring of ringSize windows which is
+// flushed to fileName when full and at the end of the run.
+//
+// File formats (see tools/heatmap_view.py):
+//  csv - a "#" header line with the geometry then one line per window,
+//        router and port: window,time,router,port,link,vc0,vc1,...
+//  bin - the header "HNOCSHM1" followed by int32 rows, columns, routers,
+//        ports, VCs and float64 window, then per window a float64 start
+//        time and float32 [router][port][link,vc0,vc1,...] values
+// Missing ports (fewer ports or no Sched/InPort) are given -1.
+//
+// Routers are indexed by their id. rows/columns are taken from the network
+// if it has such parameters (otherwise a single row).
+//
+class HeatmapMonitor : public cSimpleModule
+{
+private:
+	// parameters
+	simtime_t window;
+	int ringSize;
+	bool isBinary;
+
+	// geometry
+	int rows, columns;
+	int numRouters, numPorts, numVCs;
+	int numValues;          // values per window
+	std::vector<Sched*> scheds;   // [router * numPorts + port] (NULL if none)
+	std::vector<InPort*> inPorts; // [router * numPorts + port] (NULL if none)
+
+	// state
+	bool collected;
+	std::vector<double> prevBusy;  // per slot
+	std::vector<double> prevArea;  // per slot and VC
+	simtime_t windowStart;
+	int windowIdx;
+	std::vector<float> ring;       // ringSize windows of numValues
+	std::vector<double> ringTime;  // start time of each window in the ring
+	int ringCount;
+	FILE *file;
+	cMessage *windowMsg;
+
+	// methods
+	void collect();
+	void sampleWindow();
+	void flush();
+
+protected:
+	virtual void initialize();
+	virtual void handleMessage(cMessage *msg);
+	virtual void finish();
+public:
+	HeatmapMonitor() { windowMsg = NULL; file = NULL; };
+	virtual ~HeatmapMonitor();
+};
+
+#endif
@@ -0,0 +1,97 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+
+#include "LatencyMatrixMonitor.h"
+#include <cmath>
+#include <cstdio>
+
+Define_Module(LatencyMatrixMonitor);
+
+void LatencyMatrixMonitor::initialize()
+{
+	numNodes = 0;
+	int n = par("numNodes");
+	cModule *core = getParentModule()->getSubmodule("core", 0);
+	if (!n && core)
+		n = core->getVectorSize();
+	grow(n);
+}
+
+void LatencyMatrixMonitor::handleMessage(cMessage *msg)
+{
+	throw cRuntimeError("Does not know how to handle message of type %d", msg->getKind());
+}
+
+// resize the matrix to n x n keeping the collected flows
+void LatencyMatrixMonitor::grow(int n)
+{
+	if (n <= numNodes)
+		return;
+	FlowStat zero = { 0, 0, 0, 0 };
+	std::vector<FlowStat> newFlows(n * n, zero);
+	for (int s = 0; s < numNodes; s++)
+		for (int d = 0; d < numNodes; d++)
+			newFlows[s * n + d] = flows[s * numNodes + d];
+	flows.swap(newFlows);
+	numNodes = n;
+}
+
+void LatencyMatrixMonitor::finish()
+{
+	const char *fileName = par("fileName");
+	FILE *file = NULL;
+	if (fileName[0]) {
+		file = fopen(fileName, "w");
+		if (!file) {
+			throw cRuntimeError("-E- %s can not open latency matrix file %s",
+					getFullPath().c_str(), fileName);
+		}
+		fprintf(file, "src,dst,packets,mean-ns,stddev-ns,max-ns\n");
+	}
+
+	int numFlows = 0;
+	double minMean = 0, maxMean = 0;
+	int worstSrc = -1, worstDst = -1;
+	for (int s = 0; s < numNodes; s++) {
+		for (int d = 0; d < numNodes; d++) {
+			const FlowStat &f = flows[s * numNodes + d];
+			if (!f.n)
+				continue;
+			double mean = f.sum / f.n;
+			double var = (f.n > 1) ? (f.sqrSum - f.sum * mean) / (f.n - 1) : 0;
+			if (file)
+				fprintf(file, "%d,%d,%ld,%g,%g,%g\n", s, d, f.n, mean,
+						var > 0 ? sqrt(var) : 0.0, f.max);
+			if (!numFlows || (mean < minMean))
+				minMean = mean;
+			if (!numFlows || (mean > maxMean)) {
+				maxMean = mean;
+				worstSrc = s;
+				worstDst = d;
+			}
+			numFlows++;
+		}
+	}
+	if (file)
+		fclose(file);
+
+	recordScalar("latency-matrix-flows", numFlows);
+	if (numFlows) {
+		recordScalar("flow-mean-latency-min-ns", minMean);
+		recordScalar("flow-mean-latency-max-ns", maxMean);
+		recordScalar("worst-flow-src", worstSrc);
+		recordScalar("worst-flow-dst", worstDst);
+	}
+}
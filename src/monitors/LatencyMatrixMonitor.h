@@ -0,0 +1,72 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+
+#ifndef __HNOCS_LATENCY_MATRIX_MONITOR_H_
+#define __HNOCS_LATENCY_MATRIX_MONITOR_H_
+
+#include <omnetpp.h>
+#include <vector>
+using namespace omnetpp;
+
+//
+// Network wide source by destination packet latency matrix
+//
+// The sinks report the packet network latency (SoP first transmit -> EoP
+// received) of every packet to the monitor (see collect). The per flow
+// accumulators are kept in a dense numNodes x numNodes array so per flow
+// statistics cost a single indexed update per packet.
+//
+// numNodes = 0 takes the size of the network core vector. It grows on demand
+// for networks built at run time (Generic topology).
+//
+// At the end of the run the matrix is written to fileName as csv lines
+// src,dst,packets,mean-ns,stddev-ns,max-ns (flows with packets only).
+// Statistics: latency-matrix-flows, flow-mean-latency-min-ns,
+// flow-mean-latency-max-ns, worst-flow-src and worst-flow-dst scalars
+//
+class LatencyMatrixMonitor : public cSimpleModule
+{
+private:
+	struct FlowStat {
+		long n;
+		double sum;
+		double sqrSum;
+		double max;
+	};
+
+	int numNodes;
+	std::vector<FlowStat> flows; // [src * numNodes + dst]
+
+	void grow(int n);
+
+protected:
+	virtual void initialize();
+	virtual void handleMessage(cMessage *msg);
+	virtual void finish();
+public:
+	// called by the sinks on every received packet
+	void collect(int srcId, int dstId, double latency_ns) {
+		if ((srcId >= numNodes) || (dstId >= numNodes))
+			grow(srcId > dstId ? srcId + 1 : dstId + 1);
+		FlowStat &f = flows[srcId * numNodes + dstId];
+		f.n++;
+		f.sum += latency_ns;
+		f.sqrSum += latency_ns * latency_ns;
+		if (latency_ns > f.max)
+			f.max = latency_ns;
+	}
+};
+
+#endif
@@ -0,0 +1,171 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+
+#include "SaturationMonitor.h"
+#include "cores/sources/PktFifoSrc.h"
+#include "cores/sinks/InfiniteBWMultiVCSink.h"
+#include "cores/sinks/InfiniteBWMultiVCSinkperSrc.h"
+#include "cores/sinks/MsgReassemblySink.h"
+
+Define_Module(SaturationMonitor);
+
+void SaturationMonitor::initialize()
+{
+	checkPeriod = par("checkPeriod");
+	warmup = par("warmup");
+	divergeChecks = par("divergeChecks");
+	maxQueueFill = par("maxQueueFill");
+	abort = par("abort");
+	if ((checkPeriod <= 0) || (divergeChecks < 1)) {
+		throw cRuntimeError("-E- %s checkPeriod must be positive and divergeChecks >= 1",
+				getFullPath().c_str());
+	}
+
+	collected = false;
+	prevQueued = 0;
+	prevLatSum = 0;
+	prevLatCount = 0;
+	prevWinLat = -1;
+	numGrowing = 0;
+	queueFill = 0;
+	saturated = false;
+	WATCH(numGrowing);
+	WATCH(queueFill);
+
+	checkMsg = new cMessage("saturation-check");
+	scheduleAt(simTime() + warmup, checkMsg);
+}
+
+void SaturationMonitor::handleMessage(cMessage *msg)
+{
+	if (msg != checkMsg) {
+		throw cRuntimeError("Does not know how to handle message of type %d", msg->getKind());
+	}
+	check();
+	if (!saturated || !abort)
+		scheduleAt(simTime() + checkPeriod, checkMsg);
+}
+
+// find the sources and sinks of the network
+void SaturationMonitor::collect(cModule *mod)
+{
+	for (cModule::SubmoduleIterator it(mod); !it.end(); it++) {
+		cModule *sub = *it;
+		if (PktFifoSrc *src = dynamic_cast<PktFifoSrc*>(sub))
+			sources.push_back(src);
+		else if (InfiniteBWMultiVCSink *sink = dynamic_cast<InfiniteBWMultiVCSink*>(sub))
+			sinks.push_back(sink);
+		else if (InfiniteBWMultiVCSinkperSrc *sink = dynamic_cast<InfiniteBWMultiVCSinkperSrc*>(sub))
+			perSrcSinks.push_back(sink);
+		else if (MsgReassemblySink *sink = dynamic_cast<MsgReassemblySink*>(sub))
+			msgSinks.push_back(sink);
+		else if (!sub->isSimple())
+			collect(sub);
+	}
+}
+
+// the SoP latency sum and count and the received flits of all the sinks
+void SaturationMonitor::sampleSinks(double &latSum, long &latCount, long &flits) const
+{
+	latSum = 0;
+	latCount = 0;
+	flits = 0;
+	for (unsigned int s = 0; s < sinks.size(); s++) {
+		latSum += sinks[s]->getSoPEnd2EndLatency().getSum();
+		latCount += sinks[s]->getSoPEnd2EndLatency().getCount();
+		flits += sinks[s]->getNumReceivedFlits();
+	}
+	for (unsigned int s = 0; s < perSrcSinks.size(); s++) {
+		latSum += perSrcSinks[s]->getSoPEnd2EndLatency().getSum();
+		latCount += perSrcSinks[s]->getSoPEnd2EndLatency().getCount();
+		flits += perSrcSinks[s]->getNumReceivedFlits();
+	}
+	for (unsigned int s = 0; s < msgSinks.size(); s++) {
+		latSum += msgSinks[s]->getSoPEnd2EndLatency().getSum();
+		latCount += msgSinks[s]->getSoPEnd2EndLatency().getCount();
+		flits += msgSinks[s]->getNumReceivedFlits();
+	}
+}
+
+void SaturationMonitor::check()
+{
+	double latSum;
+	long latCount, flits;
+
+	// the first sample - done here so networks built at run time are found
+	if (!collected) {
+		collect(getSimulation()->getSystemModule());
+		if (!sources.size()) {
+			throw cRuntimeError("-E- %s found no PktFifoSrc sources", getFullPath().c_str());
+		}
+		collected = true;
+		sampleSinks(prevLatSum, prevLatCount, baseFlits);
+		baseTime = simTime();
+		for (unsigned int s = 0; s < sources.size(); s++)
+			prevQueued += sources[s]->getNumQueuedPkts();
+		return;
+	}
+
+	long queued = 0, maxQueued = 0;
+	for (unsigned int s = 0; s < sources.size(); s++) {
+		queued += sources[s]->getNumQueuedPkts();
+		maxQueued += sources[s]->getMaxQueuedPkts();
+	}
+	queueFill = maxQueued ? (double)queued / maxQueued : 0;
+
+	sampleSinks(latSum, latCount, flits);
+	double winLat = (latCount > prevLatCount) ?
+			(latSum - prevLatSum) / (latCount - prevLatCount) : prevWinLat;
+
+	if ((queued > prevQueued) && (prevWinLat >= 0) && (winLat >= prevWinLat))
+		numGrowing++;
+	else
+		numGrowing = 0;
+	prevQueued = queued;
+	prevLatSum = latSum;
+	prevLatCount = latCount;
+	prevWinLat = winLat;
+
+	if ((numGrowing >= divergeChecks) || (queueFill > maxQueueFill)) {
+		saturated = true;
+		detectTime = simTime();
+		EV << "-I- " << getFullPath() << " run is diverging: source queues "
+		   << 100 * queueFill << "% full, window latency " << winLat << "ns" << endl;
+		if (abort)
+			endSimulation();
+	}
+}
+
+void SaturationMonitor::finish()
+{
+	recordScalar("saturated", saturated);
+	if (saturated)
+		recordScalar("saturation-detect-time", detectTime);
+	recordScalar("source-queue-fill", queueFill);
+
+	int numSinks = sinks.size() + perSrcSinks.size();
+	if (collected && numSinks && (simTime() > baseTime)) {
+		double latSum;
+		long latCount, flits;
+		sampleSinks(latSum, latCount, flits);
+		recordScalar("accepted-flits-per-ns-per-node",
+				(flits - baseFlits) / ((simTime() - baseTime).dbl() * 1e9) / numSinks);
+	}
+}
+
+SaturationMonitor::~SaturationMonitor()
+{
+	cancelAndDelete(checkMsg);
+}
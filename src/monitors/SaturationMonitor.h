@@ -0,0 +1,90 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+
+#ifndef __HNOCS_SATURATION_MONITOR_H_
+#define __HNOCS_SATURATION_MONITOR_H_
+
+#include <omnetpp.h>
+#include <vector>
+using namespace omnetpp;
+
+class PktFifoSrc;
+class InfiniteBWMultiVCSink;
+class InfiniteBWMultiVCSinkperSrc;
+class MsgReassemblySink;
+
+//
+// Detects a run past the network saturation and aborts it early
+//
+// The first sample is taken at warmup (which should not be before the
+// statStartTime of the sinks), then every checkPeriod the monitor samples:
+//  * the fill of all the source queues (queued / max queued packets)
+//  * the mean SoP end-to-end latency of the packets received by all the
+//    sinks during the last check period
+// The run is diverging when the queued packets and the latency both grew
+// on divergeChecks consecutive checks, or when the source queues are more
+// than maxQueueFill full. Below saturation the source queues stay bounded
+// so neither happens. A diverging run is ended (abort) and marked saturated.
+//
+// Used by tools/saturation_finder.py to bisect the injection rate.
+//
+// Statistics: saturated (0/1), saturation-detect-time, source-queue-fill
+// (at the end of the run) and accepted-flits-per-ns-per-node (from warmup
+// to the end of the run) scalars
+//
+class SaturationMonitor : public cSimpleModule
+{
+private:
+	// parameters
+	simtime_t checkPeriod;
+	simtime_t warmup;
+	int divergeChecks;
+	double maxQueueFill;
+	bool abort;
+
+	// state
+	cMessage *checkMsg;
+	bool collected;
+	std::vector<PktFifoSrc*> sources;
+	std::vector<InfiniteBWMultiVCSink*> sinks;
+	std::vector<InfiniteBWMultiVCSinkperSrc*> perSrcSinks;
+	std::vector<MsgReassemblySink*> msgSinks;
+	simtime_t baseTime;    // the first sample time
+	long baseFlits;        // flits received by the sinks at baseTime
+	long prevQueued;
+	double prevLatSum;
+	long prevLatCount;
+	double prevWinLat;     // mean latency of the last window (-1 if none)
+	int numGrowing;        // consecutive checks with queues and latency growing
+	double queueFill;
+
+	// statistics
+	bool saturated;
+	simtime_t detectTime;
+
+	void collect(cModule *mod);
+	void sampleSinks(double &latSum, long &latCount, long &flits) const;
+	void check();
+
+protected:
+	virtual void initialize();
+	virtual void handleMessage(cMessage *msg);
+	virtual void finish();
+public:
+	SaturationMonitor() { checkMsg = NULL; };
+	virtual ~SaturationMonitor();
+};
+
+#endif
@@ -25,6 +25,8 @@ class inPortFlitInfo : public cObject {
 public:
 	int inVC; // the input VC the FLIT arrived on
 	int outPort; // the out port assigned to the FLIT
+	simtime_t reqDelay; // the RC/VA/SA pipeline latency of a packet head
+	bool bypass; // the packet is latched through the router (express VC)
 };
 
 #endif /* __HNOCS_FLIT_MSG_CTRL_H_ */
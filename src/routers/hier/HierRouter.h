@@ -18,15 +18,143 @@
 #ifndef __HNOCS_HIER_ROUTER_H_
 #define __HNOCS_HIER_ROUTER_H_
 #include <omnetpp.h>
-using namespace omnetpp;
-
+using namespace omnetpp;
+
+class InPort;
+class NoCFlitMsg;
+
+// activity counters of the energy model (see EnergyMonitor). Events are
+// counted from statStartTime. A flit leaving a Sched traverses the crossbar
+// and the out link
+struct EnergyCounters {
+	long bufWrites;
+	long bufReads;
+	long xbarTraversals;
+	long arbitrations;
+	long linkTraversals;
+	long deliveredFlits; // flits sent to a core
+	long bufferFlits;    // buffer size - for the leakage
+	EnergyCounters() : bufWrites(0), bufReads(0), xbarTraversals(0), arbitrations(0),
+		linkTraversals(0), deliveredFlits(0), bufferFlits(0) { };
+};
+
 // we need extra info inside the InPort for tracking FLITs
 class Sched : public cSimpleModule {
 public:
+	// a Req that can not be granted since its out VC has no credits or is
+	// owned by another packet. Used by the DeadlockMonitor wait-for graph
+	struct BlockedReq {
+		InPort *inPort;   // the InPort holding the packet (NULL if not an InPort)
+		int inVC;         // the InPort VC buffer holding the packet
+		int outVC;        // the requested out VC
+		bool noCredits;   // the downstream buffer of outVC is full
+		InPort *holder;   // the InPort of the packet owning outVC (NULL if none)
+		int holderInVC;   // the VC buffer of that packet
+		simtime_t since;  // the Req creation time
+	};
+
 	// pure virtual...
 	virtual const std::vector<int> *getCredits() const = 0;
 	virtual const std::vector<int> *getVCUsage() const = 0;
 	virtual void  incrVCUsage(int vc) = 0;
+
+	// used by a router level switch allocator (see SwAlloc). ip is the index
+	// of the Sched in/ctrl gate of the input port
+	virtual bool canGrantInPort(int ip) { return false; };
+	virtual void grantInPort(int ip) { };
+
+	// true if no Req is pending and the out link is free. Used by SMART bypass
+	virtual bool isIdle() const { return false; };
+
+	// SMART: a packet latched through the router is sent on to the next
+	// router in zero time (smartSend), its link traversal is in the clock
+	// it arrived on. canSmartSend checks the Sched is idle and the out VC has
+	// room for the whole packet. Nothing else is granted until its EoP passes
+	virtual bool canSmartSend(int vc, int numFlits) const { return false; };
+	virtual void smartSend(NoCFlitMsg *flit) { };
+
+	// the blocked Reqs and the total number of grants. Used by DeadlockMonitor
+	virtual void getBlockedReqs(std::vector<BlockedReq> &reqs) const { };
+	virtual long getNumGrants() const { return 0; };
+
+	// add the activity counters of the Sched to c
+	virtual void addEnergyCounters(EnergyCounters &c) const { };
+
+	// DVFS: run the clock and the out link at scale times their nominal
+	// frequency. Nothing is granted during the stall (transition latency)
+	virtual void setClockScale(double scale, simtime_t stall) { };
+	virtual simtime_t getClockPeriod() const { return SIMTIME_ZERO; };
+
+	// total time the out link was transmitting [sec]. Used by HeatmapMonitor
+	virtual double getBusyTime() const { return 0; };
+
+	// hybrid fast-forward: the clocks of [from, to) grant the flits of a
+	// packet delivered by the FastForward module. No flit is granted in a
+	// reserved window and no packet head whose flits would reach one
+	virtual bool canReserveLink(simtime_t from, simtime_t to) const { return false; };
+	virtual void reserveLink(simtime_t from, simtime_t to) { };
+
+	// the clock a Req arriving at t on an idle Sched is granted on
+	virtual simtime_t getGrantTime(simtime_t t) const { return t; };
+};
+
+// the routing function of an out port calculator. Used by a previous hop
+// InPort for lookahead routing
+class OPCalc : public cSimpleModule {
+public:
+	// the sw_out index the given head flit should be sent through
+	virtual int calcOutPort(NoCFlitMsg *msg) = 0;
+	// true if leaving through swOutPort keeps the direction the packet had
+	// when entering the port. Used by SMART bypass
+	virtual bool isStraight(int swOutPort) const { return false; };
+	// number of hops the packet will keep going in the direction of
+	// swOutPort. Used by express VCs
+	virtual int getStraightHops(NoCFlitMsg *msg, int swOutPort) { return 0; };
+};
+
+// the InPort state required by the schedulers
+class InPort : public cSimpleModule {
+public:
+	// number of flits queued on the given in VC
+	virtual int getNumQueuedFlits(int vc) const = 0;
+
+	// add the activity counters and buffer size of the InPort to c
+	virtual void addEnergyCounters(EnergyCounters &c) const { };
+
+	// integral over time of the in VC queue length [flits * sec]
+	virtual double getOccupancyArea(int vc) const { return 0; };
 };
 
+// a router level power controller (powerCtrl submodule of the router).
+// Provides the average scaling of the router energy since statStartTime:
+// the dynamic energy is weighted by the activity and the leakage by time
+class PowerCtrl : public cSimpleModule {
+public:
+	virtual double getDynamicEnergyScale() const { return 1.0; };
+	virtual double getLeakageEnergyScale() const { return 1.0; };
+
+	// power gating: false while the router is off or waking up. wakeUp
+	// starts waking the router and returns the time it will be on
+	virtual bool isAwake() const { return true; };
+	virtual simtime_t wakeUp() { return simTime(); };
+};
+
+// a router level switch allocator matching the input ports to the output
+// ports Sched on every clock. Ports are the router port indexes
+class SwAlloc : public cSimpleModule {
+public:
+	virtual void registerSched(int outPort, Sched *sched) = 0;
+	// called by the Sched on its clock instead of arbitrating by itself
+	virtual void requestAllocation(int outPort) = 0;
+};
+
+// QoS service levels: the VCs of a port are split into contiguous ranges one
+// per SL. SL s owns VCs slFirstVC(s) .. slFirstVC(s+1)-1
+inline int slFirstVC(int sl, int numSLs, int numVCs) {
+	return sl * numVCs / numSLs;
+}
+inline int vcToSL(int vc, int numSLs, int numVCs) {
+	return ((vc + 1) * numSLs - 1) / numVCs;
+}
+
 #endif /* __HNOCS_HIER_ROUTER_H_ */
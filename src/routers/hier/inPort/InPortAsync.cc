@@ -237,6 +237,9 @@ void InPortAsync::handleInFlitMsg(NoCFlitMsg *msg) {
 		}
 		curPktId[inVC] = msg->getPktId();
 
+		// count the routers traversed by the packet
+		msg->setHops(msg->getHops() + 1);
+
 		// for first flit we need to calc outVC and outPort
 		EV<< "-I- " << getFullPath() << " Received Packet:"
 		<< (msg->getPktId() >> 16) << "." << (msg->getPktId() % (1<< 16))
@@ -34,20 +34,112 @@
 // There is no delay modeling for the internal crossbar. It is assumed that if
 // a grant is provided it happens at least FLIT time after previous one
 //
+// Pipeline stages are modeled by delaying the Req of a head by RC+VA+SA and
+// every FLIT sent to the Sched by ST. The Sched clock is not changed, so the
+// stage delays are effectively rounded up to the next Sched pop.
+//
+// Lookahead routing: the head carries the sw_out index of the next router
+// (computed here using the OPCalc of the next router InPort) so the next
+// router skips calcOp and the RC delay.
+//
+// Bypass: a head arriving to a router with all InPort queues empty does not
+// pay the RC/VA/SA delays.
+//
+// SMART: the remaining routers a head may bypass are carried on the head
+// (smartHops). A bypassing head gets its out port and VC as usual, but is
+// then handed to the out port Sched with its flits following on arrival
+// (smartSend) instead of being queued and requested. The Sched forwards them
+// to the directIn gate of the next InPort in zero time.
+//
+// Express VCs: a head arriving with expressHops > 0 has no pipeline delay and
+// its Req is marked so the Sched grants it on arrival (the VCCalc keeps it on
+// its express VC).
+//
+// Multicast: the head skips calcOp. Once it is at the head of its Q the
+// branches are computed (startMulticast) and the packet is sent to calcVc and
+// requested on the first branch port. Grants of all but the last branch send
+// copies of the queued flits (mcSentIdx tracks the next one). On the EoP copy
+// the head is sent to calcVc again for the next branch. The last branch pops
+// the flits as a unicast packet does, so credits are returned once.
+//
+// Shared buffer: the capacity of a VC is flitsPerVC plus the buffers it has
+// borrowed from the shared pool (vcBorrowed).
+//
 Define_Module(InPortSync);
 
 void InPortSync::initialize() {
 	numVCs = par("numVCs");
 	flitsPerVC = par("flitsPerVC");
+	sharedFlits = par("sharedFlits");
+	sharedFree = sharedFlits;
+	maxSharedUsed = 0;
 	collectPerHopWait = par("collectPerHopWait");
 	int rows = par("rows");
 	int columns = par("columns");
 	statStartTime = par("statStartTime");
+	rcDelay = par("rcDelay");
+	vaDelay = par("vaDelay");
+	saDelay = par("saDelay");
+	stDelay = par("stDelay");
+	lookahead = par("lookahead");
+	bypass = par("bypass");
+	smartHpcMax = par("smartHpcMax");
+	numBypassedPkts = 0;
+	numLookaheadPkts = 0;
+	numBufWrites = 0;
+	numBufReads = 0;
+	numSmartBypasses = 0;
+	numReplicatedFlits = 0;
 
 	QByiVC.resize(numVCs);
 	curOutPort.resize(numVCs);
 	curOutVC.resize(numVCs);
 	curPktId.resize(numVCs, 0);
+	nextOPCalc.resize(gateSize("out"), NULL);
+	nextOPCalcKnown.resize(gateSize("out"), false);
+	curPktBypass.resize(numVCs, false);
+	curPktSmart.resize(numVCs, false);
+	mcPorts.resize(numVCs);
+	mcDsts.resize(numVCs);
+	mcSentIdx.resize(numVCs, 0);
+	upCredits.resize(numVCs, 0);
+	vcBorrowed.resize(numVCs, 0);
+	totalQueued = 0;
+	vcOccupancy.resize(numVCs);
+	for (int vc = 0; vc < numVCs; vc++) {
+		char name[64];
+		sprintf(name, "inport-vc%d-occupancy-flits", vc);
+		vcOccupancy[vc].init(name, statStartTime);
+	}
+
+	// SMART requires the Sched of each out port and the routing direction
+	opCalc = dynamic_cast<OPCalc*>(getParentModule()->getSubmodule("opCalc"));
+	for (int op = 0; op < gateSize("out"); op++) {
+		cModule *sched = gate("out", op)->getPathEndGate()->getOwnerModule();
+		outScheds.push_back(dynamic_cast<Sched*>(sched));
+	}
+
+	// power gating
+	powerCtrl = dynamic_cast<PowerCtrl*>(
+			getParentModule()->getParentModule()->getSubmodule("powerCtrl"));
+	wakeQ.setName("wakeQ");
+	wakeMsg = new cMessage("wake");
+
+	// all InPorts of the router - modules are created before initialization
+	if (bypass) {
+		cModule *router = getParentModule()->getParentModule();
+		int numPorts = router->par("numPorts");
+		for (int p = 0; p < numPorts; p++) {
+			cModule *port = router->getSubmodule("port", p);
+			InPort *inPort = port ?
+					dynamic_cast<InPort*>(port->getSubmodule("inPort")) : NULL;
+			if (!inPort) {
+				throw cRuntimeError("-E- %s bypass requires InPort modules on all router ports",
+						getFullPath().c_str());
+			}
+			routerInPorts.push_back(inPort);
+		}
+	}
 
 	// send the credits to the other size
 	for (int vc = 0; vc < numVCs; vc++)
@@ -55,22 +147,29 @@ void InPortSync::initialize() {
 
 	QLenVec.setName("Inport_total_Queue_Length");
 
-	if (collectPerHopWait) {
-		qTimeBySrcDst_head_flit.resize(rows * columns);
-		qTimeBySrcDst_body_flits.resize(rows * columns);
-		for (int src = 0; src < rows * columns; src++) {
-			qTimeBySrcDst_head_flit[src].resize(rows * columns);
-			qTimeBySrcDst_body_flits[src].resize(rows * columns);
-			for (int dst = 0; dst < rows * columns; dst++) {
-				char str[64];
-				char str1[64];
-				sprintf(str, "%d_to_%d VC acquisition time", src, dst);
-				sprintf(str1, "%d_to_%d transmission time", src, dst);
-				qTimeBySrcDst_head_flit[src][dst].setName(str);
-				qTimeBySrcDst_body_flits[src][dst].setName(str1);
-			}
-		}
+	// the cores of a mesh - grown to the ids seen on other topologies
+	if (collectPerHopWait)
+		growPerSrcDst(rows * columns);
+}
 
+// grow the per source and destination wait statistics to numIds cores
+void InPortSync::growPerSrcDst(int numIds) {
+	int oldIds = qTimeBySrcDst_head_flit.size();
+	if (numIds <= oldIds)
+		return;
+	qTimeBySrcDst_head_flit.resize(numIds);
+	qTimeBySrcDst_body_flits.resize(numIds);
+	for (int src = 0; src < numIds; src++) {
+		qTimeBySrcDst_head_flit[src].resize(numIds);
+		qTimeBySrcDst_body_flits[src].resize(numIds);
+		for (int dst = (src < oldIds) ? oldIds : 0; dst < numIds; dst++) {
+			char str[64];
+			char str1[64];
+			sprintf(str, "%d_to_%d VC acquisition time", src, dst);
+			sprintf(str1, "%d_to_%d transmission time", src, dst);
+			qTimeBySrcDst_head_flit[src][dst].setName(str);
+			qTimeBySrcDst_body_flits[src][dst].setName(str1);
+		}
 	}
 }
 
@@ -102,6 +201,18 @@ void InPortSync::sendCredit(int vc, int numFlits) {
 	crd->setFlits(numFlits);
 	crd->setSchedulingPriority(0);
 	send(crd, "in$o");
+	upCredits[vc] += numFlits;
+}
+
+// a flit left the buffer of the VC. Either return the buffer to the shared
+// pool or send a credit upstream
+void InPortSync::releaseBuffer(int vc) {
+	if (vcBorrowed[vc] && upCredits[vc]) {
+		vcBorrowed[vc]--;
+		sharedFree++;
+	} else {
+		sendCredit(vc, 1);
+	}
 }
 
 	// create and send a Req to schedule the given FLIT, assume it is SoP
@@ -130,16 +241,22 @@ void InPortSync::sendReq(NoCFlitMsg *msg) {
 	req->setNumFlits(msg->getFlits());
 	req->setNumGranted(0);
 	req->setNumAcked(0);
+	req->setBypass(info->bypass);
 	req->setSchedulingPriority(0);
-	send(req, "ctrl$o", outPort);
+	sendDelayed(req, info->reqDelay, "ctrl$o", outPort);
 }
 
 	// when we get here it is assumed there is NO messages on the out port
-void InPortSync::sendFlit(NoCFlitMsg *msg) {
+// freeBuffer is false for multicast copies - the flit stays in the buffer
+void InPortSync::sendFlit(NoCFlitMsg *msg, bool freeBuffer) {
 	int inVC = getFlitInfo(msg)->inVC;
 	int outPort = getFlitInfo(msg)->outPort;
+	// an express VC bypass skips the switch traversal stage too
+	bool isBypass = getFlitInfo(msg)->bypass;
+	simtime_t delay = isBypass ? SIMTIME_ZERO : stDelay;
 
-	if (gate("out", outPort)->getTransmissionChannel()->isBusy()) {
+	if (gate("out", outPort)->getTransmissionChannel()->getTransmissionFinishTime()
+			> simTime() + delay) {
 		EV << "-E-" << getFullPath() << " out port of InPort is busy! will be available in " << (gate("out", outPort)->getTransmissionChannel()->getTransmissionFinishTime()-simTime()) << endl;
 		throw cRuntimeError(
 				"-E- Out port of InPort is busy!");
@@ -154,19 +271,48 @@ void InPortSync::sendFlit(NoCFlitMsg *msg) {
 
 	// collect
 	if (simTime()> statStartTime) {
-		if (collectPerHopWait) {
+		// a bypassing flit is latched and not written to the buffer.
+		// A multicast flit is written once and read once per branch
+		if (!isBypass) {
+			numBufReads++;
+			if (freeBuffer)
+				numBufWrites++;
+		}
+		int src = msg->getSrcId();
+		int dst = msg->getDstId();
+		if (collectPerHopWait && (src >= 0) && (dst >= 0)) {
+			growPerSrcDst((src > dst ? src : dst) + 1);
 			if (msg->getType() == NOC_START_FLIT) {
-				qTimeBySrcDst_head_flit[msg->getSrcId()][msg->getDstId()].collect(1e9*(simTime().dbl() - msg->getArrivalTime().dbl()));
+				qTimeBySrcDst_head_flit[src][dst].collect(1e9*(simTime().dbl() - msg->getArrivalTime().dbl()));
 			} else {
-				qTimeBySrcDst_body_flits[msg->getSrcId()][msg->getDstId()].collect(1e9*(simTime().dbl() - msg->getArrivalTime().dbl()));
+				qTimeBySrcDst_body_flits[src][dst].collect(1e9*(simTime().dbl() - msg->getArrivalTime().dbl()));
 			}
 		}
 	}
-	// send to Sched
-	send(msg, "out", outPort);
+	// send to Sched through the switch traversal stage
+	sendDelayed(msg, delay, "out", outPort);
 
 	// send the credit back on the inVC of that FLIT
-	sendCredit(inVC,1);
+	if (freeBuffer)
+		releaseBuffer(inVC);
+}
+
+// SMART: hand a flit latched through the router to its out port Sched which
+// sends it on to the next router. It is not buffered so its buffer is
+// released at once
+void InPortSync::smartSend(NoCFlitMsg *msg) {
+	inPortFlitInfo *info = (inPortFlitInfo*) msg->removeControlInfo();
+	int inVC = info->inVC;
+	int outPort = info->outPort;
+	delete info;
+
+	EV << "-I- " << getFullPath() << " SMART FLIT:" << (msg->getPktId() >> 16)
+	   << "." << (msg->getPktId() % (1<< 16)) << "." << msg->getFlitIdx()
+	   << " latched through to OP:" << outPort << endl;
+
+	msg->setVC(curOutVC[inVC]);
+	outScheds[outPort]->smartSend(msg);
+	releaseBuffer(inVC);
 }
 
 // Handle the Packet when it is back from the VC calc
@@ -179,6 +325,20 @@ void InPortSync::handleCalcVCResp(NoCFlitMsg *msg) {
 
 	curOutVC[inVC] = outVC;
 
+	// SMART - the head goes on to the next router now if the out VC has
+	// room for the whole packet. Otherwise it stops here
+	if (curPktSmart[inVC]) {
+		if (outScheds[info->outPort]->canSmartSend(outVC, msg->getFlits())) {
+			msg->setSmartHops(msg->getSmartHops() - 1);
+			if (simTime() > statStartTime)
+				numSmartBypasses++;
+			smartSend(msg);
+			return;
+		}
+		curPktSmart[inVC] = false;
+		msg->setSmartHops(smartHpcMax - 1);
+	}
+
 	// we queue the flits on their inVC
 	if (QByiVC[inVC].isEmpty()) {
 		QByiVC[inVC].insert(msg);
@@ -187,7 +347,7 @@ void InPortSync::handleCalcVCResp(NoCFlitMsg *msg) {
 	}
 
 	// Total queue size
-	measureQlength();
+	measureQlength(inVC);
 
 	EV << "-I- " << getFullPath() << " Packet:" << (msg->getPktId() >> 16)
 	   << "." << (msg->getPktId() % (1<< 16))
@@ -202,26 +362,50 @@ void InPortSync::handleCalcVCResp(NoCFlitMsg *msg) {
 void InPortSync::handleCalcOPResp(NoCFlitMsg *msg) {
 	int inVC = getFlitInfo(msg)->inVC;
 
+	bool isMulticast = (msg->getDstMaskArraySize() > 0);
+
 	curOutPort[inVC] = getFlitInfo(msg)->outPort;
 	EV << "-I- " << getFullPath() << " Packet:" << (msg->getPktId() >> 16)
 	   << "." << (msg->getPktId() % (1<< 16))
 	   << " will be sent to port:" << curOutPort[inVC] << endl;
 
+	// SMART - a straight going head is latched through the router if
+	// nothing else is waiting for its out port (the out VC credits are
+	// checked once it is allocated). Otherwise it stops here and sets up the
+	// path for the next smartHpcMax-1 routers
+	curPktSmart[inVC] = false;
+	if ((smartHpcMax > 0) && !isMulticast) {
+		int op = curOutPort[inVC];
+		if ((msg->getSmartHops() > 0) && !msg->getExpressHops() && QByiVC[inVC].isEmpty()
+				&& opCalc && opCalc->isStraight(op)
+				&& outScheds[op] && outScheds[op]->isIdle()) {
+			curPktSmart[inVC] = true;
+		} else {
+			msg->setSmartHops(smartHpcMax - 1);
+		}
+	}
+
+	// route one hop ahead for the next router
+	if (lookahead && !isMulticast)
+		msg->setLookaheadPort(getNextHopOutPort(curOutPort[inVC], msg));
+
 	// buffering is by inVC
-	if (QByiVC[inVC].getLength() >= flitsPerVC) {
+	if (QByiVC[inVC].getLength() >= flitsPerVC + vcBorrowed[inVC]) {
 		throw cRuntimeError("-E- VC %d is already full receiving packet:%d",
 				inVC, msg->getPktId());
 	}
 
 	// send it to get the out VC
 	if (QByiVC[inVC].isEmpty()) {
+		if (isMulticast)
+			startMulticast(msg, inVC);
 		send(msg,"calcVc$o");
 	} else {
 		// we queue the flits on their inVC
 		QByiVC[inVC].insert(msg);
 
 		// Total queue size
-		measureQlength();
+		measureQlength(inVC);
 	}
 }
 
@@ -232,6 +416,19 @@ void InPortSync::handleInFlitMsg(NoCFlitMsg *msg) {
 	msg->setControlInfo(info);
 	int inVC = msg->getVC();
 	info->inVC = inVC;
+	info->reqDelay = SIMTIME_ZERO;
+	// body flits follow their head
+	info->bypass = (msg->getType() != NOC_START_FLIT) && curPktBypass[inVC];
+
+	// shared buffer - borrow a buffer for the VC and send its credit
+	upCredits[inVC]--;
+	if (sharedFree > 0) {
+		sharedFree--;
+		vcBorrowed[inVC]++;
+		if (sharedFlits - sharedFree > maxSharedUsed)
+			maxSharedUsed = sharedFlits - sharedFree;
+		sendCredit(inVC, 1);
+	}
 
 	// record the first time the flit is transmitted by sched, in order to mask source-router latency effects
 	if (msg->getFirstNet()) {
@@ -249,13 +446,50 @@ void InPortSync::handleInFlitMsg(NoCFlitMsg *msg) {
 		}
 		curPktId[inVC] = msg->getPktId();
 
+		// count the routers traversed by the packet
+		msg->setHops(msg->getHops() + 1);
+
 		// for first flit we need to calc outVC and outPort
 		EV << "-I- " << getFullPath() << " Received Packet:"
 		   << (msg->getPktId() >> 16) << "." << (msg->getPktId() % (1<< 16))
 		   << endl;
 
-		// send it to get the out port calc
-		send(msg, "calcOp$o");
+		// the RC/VA/SA latency of the head - RC is saved by lookahead
+		bool isMulticast = (msg->getDstMaskArraySize() > 0);
+		bool isLookahead = lookahead && !isMulticast && (msg->getLookaheadPort() >= 0);
+		info->reqDelay = (isLookahead ? SIMTIME_ZERO : rcDelay) + vaDelay + saDelay;
+		if (bypass && isRouterEmpty()) {
+			info->reqDelay = SIMTIME_ZERO;
+			if (simTime() > statStartTime)
+				numBypassedPkts++;
+		}
+
+		// a packet inside an express VC segment is latched through
+		if (msg->getExpressHops() > 0) {
+			info->reqDelay = SIMTIME_ZERO;
+			info->bypass = true;
+		}
+		curPktBypass[inVC] = info->bypass;
+
+		if (isMulticast) {
+			// branches are routed once the packet is at the head of the Q
+			// and the whole packet is kept until its last branch is sent
+			if (msg->getFlits() > flitsPerVC) {
+				throw cRuntimeError("-E- %s multicast packet 0x%x of %d flits does not fit %d flitsPerVC",
+						getFullPath().c_str(), msg->getPktId(), msg->getFlits(), flitsPerVC);
+			}
+			info->outPort = -1;
+			handleCalcOPResp(msg);
+		} else if (isLookahead) {
+			// the out port was already computed by the previous router
+			if (simTime() > statStartTime)
+				numLookaheadPkts++;
+			info->outPort = msg->getLookaheadPort();
+			handleCalcOPResp(msg);
+		} else {
+			// send it to get the out port calc
+			send(msg, "calcOp$o");
+		}
 	} else {
 		// make sure the packet id is correct
 		if (msg->getPktId() != curPktId[inVC]) {
@@ -272,6 +506,14 @@ void InPortSync::handleInFlitMsg(NoCFlitMsg *msg) {
 		int outPort = curOutPort[inVC];
 		info->outPort = outPort;
 
+		// SMART - the flits of a latched through packet follow their head
+		if (curPktSmart[inVC]) {
+			if (msg->getType() == NOC_END_FLIT)
+				curPktSmart[inVC] = false;
+			smartSend(msg);
+			return;
+		}
+
 		// queue
 		EV << "-I- " << getFullPath() << " FLIT:" << (msg->getPktId() >> 16)
 		   << "." << (msg->getPktId() % (1<< 16))
@@ -279,7 +521,7 @@ void InPortSync::handleInFlitMsg(NoCFlitMsg *msg) {
 		   << outPort << endl;
 
 		// buffering is by inVC
-		if (QByiVC[inVC].getLength() >= flitsPerVC) {
+		if (QByiVC[inVC].getLength() >= flitsPerVC + vcBorrowed[inVC]) {
 			throw cRuntimeError("-E- VC %d is already full receiving packet:%d",
 					inVC, msg->getPktId());
 		}
@@ -290,7 +532,7 @@ void InPortSync::handleInFlitMsg(NoCFlitMsg *msg) {
 		QByiVC[inVC].insert(msg);
 
 		// Total queue size
-		measureQlength();
+		measureQlength(inVC);
 	}
 }
 
@@ -304,16 +546,33 @@ void InPortSync::handleGntMsg(NoCGntMsg *msg) {
 	   << " through gate:" << msg->getArrivalGate()->getFullPath() <<" SimTime:" <<simTime()<< endl;
 
 	NoCFlitMsg* foundFlit = NULL;
-	if (!QByiVC[inVC].isEmpty()) {
+	if ((mcPorts[inVC].size() > 1) && (mcSentIdx[inVC] < QByiVC[inVC].getLength())) {
+		// multicast branch other than the last - send a copy
+		sendMulticastCopy(inVC);
+	} else if ((mcPorts[inVC].size() <= 1) && !QByiVC[inVC].isEmpty()) {
 		foundFlit = (NoCFlitMsg*)QByiVC[inVC].pop();
 		foundFlit->setVC(curOutVC[inVC]);
 
+		// the last branch of a multicast packet
+		if (mcPorts[inVC].size()) {
+			getFlitInfo(foundFlit)->outPort = mcPorts[inVC].front();
+			if (foundFlit->getType() == NOC_START_FLIT)
+				setBranchDsts(foundFlit, inVC);
+			if (foundFlit->getType() == NOC_END_FLIT) {
+				mcPorts[inVC].clear();
+				mcDsts[inVC].clear();
+			}
+		}
+
 		// Total queue size
-		measureQlength();
+		measureQlength(inVC);
 
 		// If NOC_END_FLIT, then check if there is another packet, if yes send to calcVC
 		if (foundFlit->getType() == NOC_END_FLIT && !QByiVC[inVC].isEmpty()) {
 			NoCFlitMsg* nextPkt = (NoCFlitMsg*)QByiVC[inVC].pop();
+			measureQlength(inVC);
+			if (nextPkt->getDstMaskArraySize() > 0)
+				startMulticast(nextPkt, inVC);
 			// need to get oVC and the response will send the req
 			send(nextPkt,"calcVc$o");
 		}
@@ -337,6 +596,13 @@ void InPortSync::handleGntMsg(NoCGntMsg *msg) {
 }
 
 void InPortSync::handleMessage(cMessage *msg) {
+	// the router is on - process the flits that arrived while it was off
+	if (msg == wakeMsg) {
+		while (!wakeQ.isEmpty())
+			handleInFlitMsg((NoCFlitMsg*) wakeQ.pop());
+		return;
+	}
+
 	int msgType = msg->getKind();
 	cGate *inGate = msg->getArrivalGate();
 	if (msgType == NOC_FLIT_MSG) {
@@ -344,6 +610,12 @@ void InPortSync::handleMessage(cMessage *msg) {
 			handleCalcVCResp((NoCFlitMsg*) msg);
 		} else if (inGate == gate("calcOp$i")) {
 			handleCalcOPResp((NoCFlitMsg*) msg);
+		} else if (powerCtrl && (!powerCtrl->isAwake() || !wakeQ.isEmpty())) {
+			// power gated router - wake it up and hold the flit until it is on
+			simtime_t onTime = powerCtrl->wakeUp();
+			wakeQ.insert(msg);
+			if (!wakeMsg->isScheduled())
+				scheduleAt(onTime, wakeMsg);
 		} else {
 			handleInFlitMsg((NoCFlitMsg*) msg);
 		}
@@ -356,6 +628,53 @@ void InPortSync::handleMessage(cMessage *msg) {
 	}
 }
 
+// the occupancy integral of the in VC [flits * sec] from time 0 to now
+double InPortSync::getOccupancyArea(int vc) const {
+	return vcOccupancy[vc].getArea();
+}
+
+void InPortSync::saveCheckpoint(CheckpointWriter &w) {
+	w.writeInt(numVCs);
+	for (int vc = 0; vc < numVCs; vc++) {
+		w.writeQueue(QByiVC[vc]);
+		w.writeInt(curOutVC[vc]);
+		w.writeInt(curOutPort[vc]);
+		w.writeInt(curPktId[vc]);
+		w.writeInt(curPktBypass[vc]);
+		w.writeInt(curPktSmart[vc]);
+		w.writeInts(mcPorts[vc]);
+		w.writeInt(mcDsts[vc].size());
+		for (unsigned int b = 0; b < mcDsts[vc].size(); b++)
+			w.writeBools(mcDsts[vc][b]);
+		w.writeInt(mcSentIdx[vc]);
+		w.writeInt(upCredits[vc]);
+		w.writeInt(vcBorrowed[vc]);
+	}
+	w.writeInt(sharedFree);
+}
+
+void InPortSync::restoreCheckpoint(CheckpointReader &r) {
+	Enter_Method_Silent();
+	r.checkSize(r.readInt(), numVCs, "numVCs");
+	for (int vc = 0; vc < numVCs; vc++) {
+		r.readQueue(QByiVC[vc]);
+		curOutVC[vc] = r.readInt();
+		curOutPort[vc] = r.readInt();
+		curPktId[vc] = r.readInt();
+		curPktBypass[vc] = r.readInt();
+		curPktSmart[vc] = r.readInt();
+		r.readInts(mcPorts[vc]);
+		mcDsts[vc].resize(r.readInt());
+		for (unsigned int b = 0; b < mcDsts[vc].size(); b++)
+			r.readBools(mcDsts[vc][b]);
+		mcSentIdx[vc] = r.readInt();
+		upCredits[vc] = r.readInt();
+		vcBorrowed[vc] = r.readInt();
+		measureQlength(vc);
+	}
+	sharedFree = r.readInt();
+}
+
 InPortSync::~InPortSync() {
 	// clean up messages at QByiVC
 	numVCs = par("numVCs");
@@ -366,34 +685,163 @@ InPortSync::~InPortSync() {
 			cancelAndDelete(msg); //cancelAndDelete?!
 		}
 	}
+	while (!wakeQ.isEmpty())
+		delete wakeQ.pop();
+	cancelAndDelete(wakeMsg);
 }
 
-void InPortSync::measureQlength() {
+// called on every change of the inVC queue - O(1)
+void InPortSync::measureQlength(int inVC) {
+	int len = QByiVC[inVC].getLength();
+	totalQueued += len - vcOccupancy[inVC].getLength();
+	vcOccupancy[inVC].set(len);
 	// measure Total queue length
 	if (simTime() > statStartTime) {
-		int numVCs = par("numVCs");
-		int Qsize = 0;
-		for (int vc = 0; vc < numVCs; vc++) {
-			Qsize = Qsize + QByiVC[vc].getLength();
+		QLenVec.record(totalQueued);
+	}
+}
+
+// the sw_out index the next router will route the given head to, by invoking
+// the OPCalc of the InPort at the other end of outPort. -1 if the next hop is
+// not a router.
+int InPortSync::getNextHopOutPort(int outPort, NoCFlitMsg *msg) {
+	if (!nextOPCalcKnown[outPort]) {
+		nextOPCalcKnown[outPort] = true;
+		// our out gate ends on the Sched of the output Port
+		cModule *outPortMod =
+				gate("out", outPort)->getPathEndGate()->getOwnerModule()->getParentModule();
+		cGate *remGate = outPortMod->gate("out$o")->getPathEndGate();
+		cModule *remPort = remGate->getOwnerModule()->getParentModule();
+		if (remPort && dynamic_cast<InPort*>(remGate->getOwnerModule()))
+			nextOPCalc[outPort] = dynamic_cast<OPCalc*>(remPort->getSubmodule("opCalc"));
+	}
+	if (!nextOPCalc[outPort])
+		return -1;
+	return nextOPCalc[outPort]->calcOutPort(msg);
+}
+
+// Route each destination of a multicast head that reached the head of its Q
+// and group them into branches by out port. The first branch is requested
+void InPortSync::startMulticast(NoCFlitMsg *head, int inVC) {
+	if (!opCalc) {
+		throw cRuntimeError("-E- %s multicast requires an OPCalc", getFullPath().c_str());
+	}
+	int numDsts = head->getDstMaskArraySize();
+	int dstId = head->getDstId();
+	mcPorts[inVC].clear();
+	mcDsts[inVC].clear();
+	mcSentIdx[inVC] = 0;
+	for (int id = 0; id < numDsts; id++) {
+		if (!head->getDstMask(id))
+			continue;
+		head->setDstId(id);
+		int op = opCalc->calcOutPort(head);
+		unsigned int b;
+		for (b = 0; (b < mcPorts[inVC].size()) && (mcPorts[inVC][b] != op); b++)
+			;
+		if (b == mcPorts[inVC].size()) {
+			mcPorts[inVC].push_back(op);
+			mcDsts[inVC].push_back(std::vector<bool>(numDsts, false));
+		}
+		mcDsts[inVC][b][id] = true;
+	}
+	head->setDstId(dstId);
+	if (!mcPorts[inVC].size()) {
+		throw cRuntimeError("-E- %s multicast packet 0x%x has no destination",
+				getFullPath().c_str(), head->getPktId());
+	}
+	EV << "-I- " << getFullPath() << " multicast Packet:" << (head->getPktId() >> 16)
+	   << "." << (head->getPktId() % (1<< 16)) << " replicated to "
+	   << mcPorts[inVC].size() << " out ports" << endl;
+	getFlitInfo(head)->outPort = mcPorts[inVC].front();
+}
+
+// set the destinations of the current branch on the head sent on it
+void InPortSync::setBranchDsts(NoCFlitMsg *head, int inVC) {
+	const std::vector<bool> &dsts = mcDsts[inVC].front();
+	bool first = true;
+	for (unsigned int id = 0; id < dsts.size(); id++) {
+		head->setDstMask(id, dsts[id]);
+		if (dsts[id] && first) {
+			head->setDstId(id);
+			first = false;
 		}
-		QLenVec.record(Qsize);
 	}
+	head->setLookaheadPort(-1);
+}
+
+// send a copy of the next flit of the packet on the current (not last)
+// multicast branch. The EoP copy moves the packet to the next branch
+void InPortSync::sendMulticastCopy(int inVC) {
+	NoCFlitMsg *orig = (NoCFlitMsg*)QByiVC[inVC].get(mcSentIdx[inVC]);
+	NoCFlitMsg *copy = orig->dup();
+	inPortFlitInfo *info = new inPortFlitInfo;
+	info->inVC = inVC;
+	info->outPort = mcPorts[inVC].front();
+	info->reqDelay = SIMTIME_ZERO;
+	info->bypass = false;
+	copy->setControlInfo(info);
+	copy->setVC(curOutVC[inVC]);
+	if (copy->getType() == NOC_START_FLIT)
+		setBranchDsts(copy, inVC);
+	mcSentIdx[inVC]++;
+	if (simTime() > statStartTime)
+		numReplicatedFlits++;
+
+	if (copy->getType() == NOC_END_FLIT) {
+		// request the next branch with the head
+		mcPorts[inVC].erase(mcPorts[inVC].begin());
+		mcDsts[inVC].erase(mcDsts[inVC].begin());
+		mcSentIdx[inVC] = 0;
+		NoCFlitMsg *head = (NoCFlitMsg*)QByiVC[inVC].pop();
+		measureQlength(inVC);
+		getFlitInfo(head)->outPort = mcPorts[inVC].front();
+		send(head, "calcVc$o");
+	}
+	sendFlit(copy, false);
+}
+
+// Energy model interface: buffer accesses and the number of buffers
+void InPortSync::addEnergyCounters(EnergyCounters &c) const {
+	c.bufWrites += numBufWrites;
+	c.bufReads += numBufReads;
+	c.bufferFlits += numVCs * flitsPerVC + sharedFlits;
+}
+
+// true if no FLIT is queued on any InPort of the router
+bool InPortSync::isRouterEmpty() {
+	for (unsigned int p = 0; p < routerInPorts.size(); p++)
+		for (int vc = 0; vc < numVCs; vc++)
+			if (routerInPorts[p]->getNumQueuedFlits(vc))
+				return false;
+	return true;
 }
 
 void InPortSync::finish() {
 	if (simTime() > statStartTime) {
 		int Dst;
 		int Src;
-		int rows = par("rows");
-		int columns = par("columns");
+		int numIds = qTimeBySrcDst_head_flit.size();
 		if (collectPerHopWait) {
-			for (Dst = 0; Dst < (rows * columns); Dst++) {
-				for (Src = 0; Src < (rows * columns); Src++) {
+			for (Dst = 0; Dst < numIds; Dst++) {
+				for (Src = 0; Src < numIds; Src++) {
 					qTimeBySrcDst_head_flit[Src][Dst].record();
 					qTimeBySrcDst_body_flits[Src][Dst].record();
 				}
 			}
 		}
+		if (bypass)
+			recordScalar("bypassed-packets", numBypassedPkts);
+		if (lookahead)
+			recordScalar("lookahead-routed-packets", numLookaheadPkts);
+		if (smartHpcMax > 0)
+			recordScalar("smart-bypassed-hops", numSmartBypasses);
+		if (numReplicatedFlits)
+			recordScalar("multicast-replicated-flits", numReplicatedFlits);
+		if (sharedFlits)
+			recordScalar("shared-buffer-max-used-flits", maxSharedUsed);
+		for (int vc = 0; vc < numVCs; vc++)
+			vcOccupancy[vc].record();
 	}
 }
 
@@ -24,12 +24,16 @@ using namespace omnetpp;
 
 #include "NoCs_m.h"
 #include "routers/hier/FlitMsgCtrl.h"
+#include "routers/hier/HierRouter.h"
+#include "stats/OccupancyStat.h"
+#include "checkpoint/Checkpoint.h"
 
 //
 // Input Port of a router
 //
 // Ports:
 //   inout in - where FLITs are received and credits are reported
+//   input directIn - FLITs latched through the previous router (SMART)
 //   inout out_sw - where req/ack and FLITs are provided to schedulers
 //
 // Events:
@@ -44,36 +48,116 @@ using namespace omnetpp;
 // NOTE: on each in VC there is only 1 packet being received at a given time
 // NOTE: on each out port there is only 1 packet being sent at a given time
 //
-class InPortSync: public cSimpleModule {
+// Pipeline:
+//   The RC/VA/SA stage latencies delay the Req of a packet head, and the ST
+//   latency delays each flit on its way to the Sched. With lookahead routing
+//   the out port of the next router is computed here, carried on the head
+//   flit, and the next router skips its RC stage. With bypass a head that
+//   reaches an empty router skips the RC/VA/SA stages.
+//
+// SMART:
+//   A head stopping at a router (buffered and arbitrated normally) sets up a
+//   path of up to smartHpcMax-1 routers ahead. On each of these routers a head
+//   that goes straight, finds its inVC empty and the out port Sched able to
+//   take the whole packet (see Sched::canSmartSend) is latched through: it is
+//   not buffered nor arbitrated and the Sched sends it on to the next router
+//   in zero time. A flit sent by a stop router thus crosses up to smartHpcMax
+//   links in the clock of its out link and only the router it stops at adds
+//   its pipeline. The body flits follow the head on arrival and the credits
+//   are returned at once. A head that can not go on stops, and a new path is
+//   set up from there.
+//
+// Express VCs:
+//   Packets on an express VC segment (see FLUVCCalc) are latched through the
+//   intermediate routers: their Req has no pipeline delay and the Sched
+//   grants it on arrival.
+//
+// Multicast:
+//   A head carrying a dstMask is split into branches, one per out port, by
+//   routing each of its destinations with the OPCalc (so XY routing builds a
+//   dimension order tree). The branches are served one after the other: the
+//   flits are copied to all but the last branch and only the last branch pops
+//   them and returns the credits. The whole packet must fit the inVC buffer.
+//
+// Shared buffer (DAMQ):
+//   With sharedFlits > 0 each VC has flitsPerVC reserved buffers and borrows
+//   from a shared pool of sharedFlits. The upstream keeps seeing plain per VC
+//   credits: on every flit arrival a buffer is borrowed from the pool (if any
+//   is free) and an extra credit is sent on the VC. A leaving flit returns its
+//   buffer to the pool, unless the VC is not holding borrowed buffers or has
+//   no credits left upstream, in which case the credit is sent upstream.
+//
+class InPortSync: public InPort, public Checkpointable {
 private:
 	// parameters
 	bool collectPerHopWait; // Controls per hop wait time collection
 	int numVCs; // number of supported VCs
 	int flitsPerVC; // number of buffers available per VC
+	int sharedFlits; // size of the shared buffer pool (0 is private buffers only)
 	simtime_t statStartTime; // in sec
+	simtime_t rcDelay, vaDelay, saDelay, stDelay; // pipeline stage latencies
+	bool lookahead; // compute the out port of the next router
+	bool bypass;    // skip the RC/VA/SA stages on an empty router
+	int smartHpcMax; // SMART max hops per cycle (0 is disabled)
 
 	// state
 	std::vector<cQueue> QByiVC; // Q[ivc]
 	std::vector<int> curOutVC; // current packet output VC per in VC
 	std::vector<int> curOutPort; // current packet output port per in VC
 	std::vector<int> curPktId; // the current packet id on the VC (0 means not inside packet)
+	std::vector<OPCalc*> nextOPCalc; // per out port the OPCalc of the next router InPort
+	std::vector<bool> nextOPCalcKnown; // nextOPCalc was looked up
+	std::vector<InPort*> routerInPorts; // all InPorts of the router - for bypass
+	std::vector<bool> curPktBypass; // the current packet on the in VC is on an express VC segment
+	std::vector<bool> curPktSmart;  // the current packet on the in VC is latched through (SMART)
+	std::vector<Sched*> outScheds; // the Sched of each out port
+	OPCalc *opCalc; // the OPCalc of this port
+	int numSmartBypasses;
+	// multicast state of the packet at the head of each in VC Q
+	std::vector< std::vector<int> > mcPorts; // [inVC] branch out ports - front is served
+	std::vector< std::vector< std::vector<bool> > > mcDsts; // [inVC][branch] dstMask of the branch
+	std::vector<int> mcSentIdx; // [inVC] the next flit to copy on the current branch
+	int numReplicatedFlits;
+	// shared buffer state
+	std::vector<int> upCredits; // [inVC] credits held by the upstream (including flits on the wire)
+	std::vector<int> vcBorrowed; // [inVC] shared buffers held by the VC
+	int sharedFree; // free buffers in the shared pool
+	int maxSharedUsed; // max number of shared buffers used
+	int numBypassedPkts;
+	int numLookaheadPkts;
+	// power gating - flits arriving while the router is off wait for it
+	PowerCtrl *powerCtrl; // the router power controller (NULL if none)
+	cQueue wakeQ;
+	cMessage *wakeMsg;
+	int totalQueued; // flits queued on all the in VCs
+	long numBufWrites; // flits written into the buffers (after statStartTime)
+	long numBufReads;  // flits read from the buffers, multicast copies included
 
 	// methods
 	void sendCredit(int vc, int numFlits);
+	void releaseBuffer(int vc);
 	void sendReq(NoCFlitMsg *msg);
-	void sendFlit(NoCFlitMsg *msg);
+	void sendFlit(NoCFlitMsg *msg, bool freeBuffer = true);
+	void smartSend(NoCFlitMsg *msg);
 	void handleCalcVCResp(NoCFlitMsg *msg);
 	void handleCalcOPResp(NoCFlitMsg *msg);
 	void handleInFlitMsg(NoCFlitMsg *msg);
 	void handleGntMsg(NoCGntMsg *msg);
 	void handlePopMsg(NoCPopMsg *msg);
-	void measureQlength();
+	void measureQlength(int inVC);
+	void growPerSrcDst(int numIds);
+	int getNextHopOutPort(int outPort, NoCFlitMsg *msg);
+	bool isRouterEmpty();
+	void startMulticast(NoCFlitMsg *head, int inVC);
+	void setBranchDsts(NoCFlitMsg *head, int inVC);
+	void sendMulticastCopy(int inVC);
 
 
 	// statistics
 	std::vector<std::vector<cStdDev> > qTimeBySrcDst_head_flit; // VC acquiring time
 	std::vector<std::vector<cStdDev> > qTimeBySrcDst_body_flits; // transmission time: queue time of body flits untill it sent (doesnt include inter delay of the router and the transmission time over the link)
 	cOutVector QLenVec; // Queue length
+	std::vector<OccupancyStat> vcOccupancy; // [inVC] time weighted queue length
 
 	// we later define the attached extended info for a FLIT in the InPort
 	class inPortFlitInfo* getFlitInfo(NoCFlitMsg *msg);
@@ -83,6 +167,12 @@ protected:
 	virtual void handleMessage(cMessage *msg);
 	virtual void finish();
 public:
+	virtual int getNumQueuedFlits(int vc) const { return QByiVC[vc].getLength(); };
+	virtual void addEnergyCounters(EnergyCounters &c) const;
+	virtual double getOccupancyArea(int vc) const;
+	virtual void saveCheckpoint(CheckpointWriter &w);
+	virtual void restoreCheckpoint(CheckpointReader &r);
+	InPortSync() { wakeMsg = NULL; };
 	virtual ~InPortSync();
 
 };
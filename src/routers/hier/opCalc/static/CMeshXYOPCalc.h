@@ -0,0 +1,46 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+
+#ifndef __HNOCS_CMESH_OPCALC_H_
+#define __HNOCS_CMESH_OPCALC_H_
+
+#include <omnetpp.h>
+using namespace omnetpp;
+
+#include "XYOPCalc.h"
+
+//
+// The Out Port Calc for a concentrated mesh.
+//
+// This implementation provides XY - Routing on a CMesh:
+// ======================================================
+// Routers are placed on a grid of "columns" columns and are numbered by their
+// id. Each router serves "concentration" cores, such that core id's
+// c*concentration .. (c+1)*concentration-1 are connected to router c.
+// Routing is XY between the routers (see XYOPCalc) and at the destination
+// router the packet is ejected on the port connected to the core with
+// id == dstId.
+//
+// NOTE: the core to port mapping is learned from the topology so the actual
+// router port each core connects to does not matter.
+//
+class CMeshXYOPCalc : public XYOPCalc
+{
+protected:
+	// the concentration parameter of the network
+	virtual int getConcentration();
+};
+
+#endif
@@ -0,0 +1,86 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+
+#include "TableOPCalc.h"
+
+Define_Module(TableOPCalc);
+
+// The sw ports of port q skip q itself: port p is reached through
+// sw_out[p] if p < q and through sw_out[p-1] if p > q
+int TableOPCalc::routerPortToSwIdx(int port)
+{
+	if (port == inPort) {
+		throw cRuntimeError("-E- %s BUG - routing back through the input port %d",
+				getFullPath().c_str(), port);
+	}
+	return (port < inPort) ? port : port - 1;
+}
+
+void TableOPCalc::initialize()
+{
+	cModule *router = getParentModule()->getParentModule();
+	routerId = router->par("id");
+	inPort = getParentModule()->getIndex();
+
+	const char *builderName = par("builderName");
+	cModule *mod = router->getParentModule()->getSubmodule(builderName);
+	builder = dynamic_cast<TopologyBuilder *>(mod);
+	if (!builder) {
+		throw cRuntimeError("-E- %s could not find a TopologyBuilder named %s on the network",
+				getFullPath().c_str(), builderName);
+	}
+	EV << "-I- " << getFullPath() << " using routing tables of: "
+	   << builder->getFullPath() << endl;
+}
+
+// the sw_out index the packet should be sent through
+int TableOPCalc::calcOutPort(NoCFlitMsg* msg)
+{
+	int dstId = msg->getDstId();
+	int port = builder->getNextPort(routerId, inPort, dstId);
+	if (port < 0) {
+		throw cRuntimeError("Routing dead end at %s for destination %d",
+				getParentModule()->getFullPath().c_str(), dstId);
+	}
+	int swOutPortIdx = routerPortToSwIdx(port);
+    return swOutPortIdx;
+}
+
+void TableOPCalc::handlePacketMsg(NoCFlitMsg* msg)
+{
+    int swOutPortIdx = calcOutPort(msg);
+
+    // TODO - move into a common header for msgs ?
+	cObject *obj = msg->getControlInfo();
+	if (obj == NULL) {
+		throw cRuntimeError("-E- %s BUG - No Control Info for FLIT: %s",
+				getFullPath().c_str(), msg->getFullName());
+	}
+
+	inPortFlitInfo *info = dynamic_cast<inPortFlitInfo*>(obj);
+	info->outPort = swOutPortIdx;
+    send(msg, "calc$o");
+}
+
+void TableOPCalc::handleMessage(cMessage *msg)
+{
+    int msgType = msg->getKind();
+    if ( msgType == NOC_FLIT_MSG ) {
+    	handlePacketMsg((NoCFlitMsg*)msg);
+    } else {
+    	throw cRuntimeError("Does not know how to handle message of type %d", msg->getKind());
+    	delete msg;
+    }
+}
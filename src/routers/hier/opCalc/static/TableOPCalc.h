@@ -0,0 +1,65 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+
+#ifndef __HNOCS_TABLE_OPCALC_H_
+#define __HNOCS_TABLE_OPCALC_H_
+
+#include <omnetpp.h>
+using namespace omnetpp;
+
+#include "NoCs_m.h"
+#include "routers/hier/FlitMsgCtrl.h"
+#include "routers/hier/HierRouter.h"
+#include "topologies/TopologyBuilder.h"
+
+//
+// The Out Port Calc for arbitrary topologies.
+//
+// Ports:
+//   inout calc - through which the packets are received and returned
+//
+// Events:
+//   NoCPacketMsg - the head FLIT to be processed and the lastOutPort to be set
+//   then the same FLIT is returned on the clac port
+//
+// This implementation provides table based routing:
+// ==================================================
+// The routing tables are computed by the TopologyBuilder of the network
+// (up*/down* routing). The table entry depends on the destination and on the
+// router port the packet entered through which is the index of the Port
+// module containing this OPCalc.
+//
+class TableOPCalc : public OPCalc
+{
+private:
+	// parameters
+	TopologyBuilder *builder; // the module holding the routing tables
+	int routerId;             // the id of the local router
+	int inPort;               // the router port this OPCalc serves
+
+	// methods:
+
+	// convert router port index into the index of the sw_out port of this port
+	int routerPortToSwIdx(int port);
+	// handle the message
+	void handlePacketMsg(NoCFlitMsg* msg);
+protected:
+    virtual void initialize();
+    virtual void handleMessage(cMessage *msg);
+public:
+    virtual int calcOutPort(NoCFlitMsg *msg);
+};
+
+#endif
@@ -96,7 +96,7 @@ XYOPCalc::analyzeMeshTopology()
 	westPort  = -1;
 	southPort = -1;
 	eastPort  = -1;
-	corePort  = -1;
+	corePorts.assign(concentration, -1);
 	cModule *router = getParentModule()->getParentModule();
 	// go over all the router ports and check their remote side if they are of type "Port"
 	for (cModule::SubmoduleIterator iter(router); !iter.end(); iter++) {
@@ -111,20 +111,21 @@ XYOPCalc::analyzeMeshTopology()
 		int portIdx = getIdxOfSwPortConnectedToPort(port);
 
 		if (remCore) {
-			// remote side is the core connected to the router
+			// remote side is one of the cores connected to the router
+			int coreId = remCore->par("id");
 			int x,y;
-			rowColByID(remCore->par("id"), x, y);
-			if ((rx == x) && (ry == y)) {
+			rowColByID(coreId / concentration, x, y);
+			if ((coreId >= 0) && (coreId / concentration == routerId)) {
 				EV << "-I- " << getParentModule()->getFullPath()
 					<< " connected through sw_out[" << portIdx
-					<< "] to Core port: " << port->getFullPath() << endl;
-				corePort = portIdx;
+					<< "] to Core " << coreId << " port: " << port->getFullPath() << endl;
+				corePorts[coreId % concentration] = portIdx;
 			} else {
 				throw cRuntimeError("Port: %s and connected Core %s do not share the same x:%d and y:%d",
 						port->getFullPath().c_str(), remCore->getFullPath().c_str(),
 						x, y);
 			}
-		} else if (remPort) {
+		} else if (remPort && !analyzeRemotePort(port, remPort, portIdx)) {
 			// remote side is another router port
 			// get the remote port x,y
 			int x,y;
@@ -192,9 +193,24 @@ XYOPCalc::analyzeMeshTopology()
 		}
 	}
 
-	if (corePort < 0) {
-		EV << "-W- " << getParentModule()->getFullPath()
-			<< " could not find corePort (of coreType:" << coreType << ")" << endl;
+	for (int k = 0; k < concentration; k++) {
+		if (corePorts[k] < 0) {
+			EV << "-W- " << getParentModule()->getFullPath()
+				<< " could not find corePort for local core " << k
+				<< " (of coreType:" << coreType << ")" << endl;
+		}
+	}
+
+	// packets entering this port from the west continue straight to the east...
+	straightPort = -1;
+	cModule *remPort = getPortRemotePort(getParentModule());
+	if (remPort) {
+		int x,y;
+		rowColByID(remPort->getParentModule()->par("id"), x, y);
+		if (x == rx - 1) straightPort = eastPort;
+		else if (x == rx + 1) straightPort = westPort;
+		else if (y == ry - 1) straightPort = northPort;
+		else if (y == ry + 1) straightPort = southPort;
 	}
 	return(0);
 }
@@ -206,30 +222,64 @@ void XYOPCalc::initialize()
 
     // the id is supposed to be on the router
     cModule *router = getParentModule()->getParentModule();
-    int id = router->par("id");
+    routerId = router->par("id");
     numCols = router->getParentModule()->par("columns");
+    concentration = getConcentration();
+    if (concentration < 1) {
+    	throw cRuntimeError("-E- %s concentration must be >= 1 (got %d)",
+    			getFullPath().c_str(), concentration);
+    }
 
-    rowColByID(id, rx, ry);
+    rowColByID(routerId, rx, ry);
     // Analyze the connections of this port building the port number to be used for routing
     // north, south, west and east. if there is no way to go on some direction the
     analyzeMeshTopology();
     EV << "-I- " << getFullPath() << " Found N/W/S/E/C ports:" << northPort
-    		<< "/" << westPort << "/" << southPort << "/"
-    		<< eastPort << "/" << corePort << endl;
+    		<< "/" << westPort << "/" << southPort << "/" << eastPort;
+    for (int k = 0; k < concentration; k++)
+    	EV << "/" << corePorts[k];
+    EV << endl;
     WATCH(northPort);
     WATCH(westPort);
     WATCH(eastPort);
     WATCH(southPort);
-    WATCH(corePort);
+    WATCH_VECTOR(corePorts);
+    WATCH(straightPort);
 }
 
-void XYOPCalc::handlePacketMsg(NoCFlitMsg* msg)
+bool XYOPCalc::isStraight(int swOutPort) const
+{
+	return((swOutPort >= 0) && (swOutPort == straightPort));
+}
+
+// XY routing keeps the direction until the destination row/column is reached
+int XYOPCalc::getStraightHops(NoCFlitMsg *msg, int swOutPort)
+{
+	int dx, dy;
+	rowColByID(msg->getDstId() / concentration, dx, dy);
+	if (swOutPort < 0) return 0;
+	if (swOutPort == eastPort) return dx - rx;
+	if (swOutPort == westPort) return rx - dx;
+	if (swOutPort == northPort) return dy - ry;
+	if (swOutPort == southPort) return ry - dy;
+	return 0;
+}
+
+// the port of the destination core
+int XYOPCalc::calcLocalOutPort(int dstId)
+{
+	return corePorts[dstId % concentration];
+}
+
+// the sw_out index the packet should be sent through
+int XYOPCalc::calcOutPort(NoCFlitMsg* msg)
 {
+	int dstId = msg->getDstId();
 	int dx, dy;
-    rowColByID(msg->getDstId(), dx, dy);
+    rowColByID(dstId / concentration, dx, dy);
     int swOutPortIdx;
     if ((dx == rx) && (dy == ry)) {
-    	swOutPortIdx = corePort;
+    	swOutPortIdx = calcLocalOutPort(dstId);
     } else if (dx > rx) {
     	swOutPortIdx = eastPort;
     } else if (dx < rx) {
@@ -245,6 +295,12 @@ void XYOPCalc::handlePacketMsg(NoCFlitMsg* msg)
     			getParentModule()->getFullPath().c_str(), rx,ry,
     			msg->getDstId(),dx,dy);
     }
+    return swOutPortIdx;
+}
+
+void XYOPCalc::handlePacketMsg(NoCFlitMsg* msg)
+{
+    int swOutPortIdx = calcOutPort(msg);
 
     // TODO - move into a common header for msgs ?
 	cObject *obj = msg->getControlInfo();
@@ -23,6 +23,7 @@ using namespace omnetpp;
 
 #include "NoCs_m.h"
 #include "routers/hier/FlitMsgCtrl.h"
+#include "routers/hier/HierRouter.h"
 
 //
 // The Out Port Calc class implements the local routing decision.
@@ -47,21 +48,28 @@ using namespace omnetpp;
 // It does not require each router to have a core.
 // It can handle disconnected ports like on the edges of the network.
 //
-class XYOPCalc : public cSimpleModule
+// Concentration: a router may serve several cores (getConcentration). Cores
+// c*concentration .. (c+1)*concentration-1 connect to router c and the port
+// of each is learned from the topology.
+//
+class XYOPCalc : public OPCalc
 {
-private:
+protected:
 	// parameters
 	int numCols; // the total number of columns in the simulations
+	int routerId; // the local router id
 	int rx, ry;  // the local router x and y coordinates
 	int northPort, westPort, southPort, eastPort; // port indexes on the router to be used
-	int corePort; // port index where the core module connects
+	int concentration; // number of cores per router
+	std::vector<int> corePorts; // port index where each of the local cores connects
+	int straightPort; // the port continuing the direction of packets entering this port
 	const char *portType; // the name of the actual module used for Port_Ifc
 	const char *coreType; // the name of the actual module used for Core_Ifc
 
 	// methods:
 
 	// convert core and router id's into row and col (X and Y)
-	int rowColByID(int id, int &x, int &y);
+	virtual int rowColByID(int id, int &x, int &y);
 	// return true if the module is a "Port"
 	bool isPortModule(cModule *mod);
 	// Get the pointer to the remote Port module on the given port module
@@ -76,9 +84,20 @@ private:
 	int analyzeMeshTopology();
 	// handle the message
 	void handlePacketMsg(NoCFlitMsg* msg);
-protected:
+	// the number of cores of each router
+	virtual int getConcentration() { return 1; }
+	// a port connected to a router not on the plane of this one (see
+	// XYZOPCalc). Return true if handled, false for a planar neighbour
+	virtual bool analyzeRemotePort(cModule *port, cModule *remPort, int portIdx) { return false; }
+	// the out port of a packet that reached its destination row and column
+	virtual int calcLocalOutPort(int dstId);
+
     virtual void initialize();
     virtual void handleMessage(cMessage *msg);
+public:
+    virtual int calcOutPort(NoCFlitMsg *msg);
+    virtual bool isStraight(int swOutPort) const;
+    virtual int getStraightHops(NoCFlitMsg *msg, int swOutPort);
 };
 
 #endif
@@ -0,0 +1,147 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#include "XYZOPCalc.h"
+
+Define_Module(XYZOPCalc);
+
+int XYZOPCalc::rowColLayerByID(int id, int &x, int &y, int &z)
+{
+	z = id / (numCols * numRows);
+	y = (id / numCols) % numRows;
+	x = id % numCols;
+	return(0);
+}
+
+int XYZOPCalc::rowColByID(int id, int &x, int &y)
+{
+	int z;
+	return rowColLayerByID(id, x, y, z);
+}
+
+// return the datarate of the link driven by the given router port
+double
+XYZOPCalc::getPortLinkDatarate(cModule *port)
+{
+	cGate *gate = port->gate("out$o")->getNextGate();
+	if (!gate || !gate->getChannel()) return 0;
+	cDatarateChannel *chan = dynamic_cast<cDatarateChannel*>(gate->getChannel());
+	if (!chan) return 0;
+	return chan->getDatarate();
+}
+
+// the neighbours on the same layer are left to XYOPCalc
+bool
+XYZOPCalc::analyzeRemotePort(cModule *port, cModule *remPort, int portIdx)
+{
+	int x,y,z;
+	rowColLayerByID(remPort->getParentModule()->par("id"), x, y, z);
+	if (rz == z) {
+		planarDatarate = getPortLinkDatarate(port);
+		return false;
+	}
+
+	if ((rx == x) && (ry == y) && (rz == z - 1)) {
+		// remPort is up port
+		if (upPort != -1) {
+			throw cRuntimeError("Already found an up port: %d for ports: %s."
+					" %s is miss-configured",
+					upPort, port->getFullPath().c_str(),
+					remPort->getFullPath().c_str());
+		}
+		EV << "-I- " << getParentModule()->getFullPath()
+			<< " connected through sw_out[" << portIdx
+			<< "] to Up port: " << port->getFullPath() << endl;
+		upPort = portIdx;
+	} else if ((rx == x) && (ry == y) && (rz == z + 1)) {
+		// remPort is down port
+		if (downPort != -1) {
+			throw cRuntimeError("Already found a down port: %d for ports: %s."
+					" %s is miss-configured",
+					downPort, port->getFullPath().c_str(),
+					remPort->getFullPath().c_str());
+		}
+		EV << "-I- " << getParentModule()->getFullPath()
+			<< " connected through sw_out[" << portIdx
+			<< "] to Down port: " << port->getFullPath() << endl;
+		downPort = portIdx;
+	} else {
+		throw cRuntimeError("Found a non Mesh3D connection between %s (%d,%d,%d) and %s (%d,%d,%d)",
+				port->getFullPath().c_str(), rx,ry,rz,
+				remPort->getFullPath().c_str(),x,y,z);
+	}
+	verticalDatarate = getPortLinkDatarate(port);
+	return true;
+}
+
+void XYZOPCalc::initialize()
+{
+    // the layer is needed to analyze the vertical ports
+    cModule *router = getParentModule()->getParentModule();
+    cModule *network = router->getParentModule();
+    numRows = network->par("rows");
+    numLayers = network->par("layers");
+    int columns = network->par("columns");
+    rz = (int)router->par("id") / (columns * numRows);
+    upPort = -1;
+    downPort = -1;
+    planarDatarate = 0;
+    verticalDatarate = 0;
+
+    XYOPCalc::initialize();
+    EV << "-I- " << getFullPath() << " Found U/D ports:" << upPort
+    		<< "/" << downPort << endl;
+    WATCH(upPort);
+    WATCH(downPort);
+}
+
+// XYOPCalc routes to the destination row and column, then the layer is routed
+int XYZOPCalc::calcLocalOutPort(int dstId)
+{
+	int dx, dy, dz;
+	rowColLayerByID(dstId, dx, dy, dz);
+	if (dz > rz)
+		return upPort;
+	if (dz < rz)
+		return downPort;
+	return XYOPCalc::calcLocalOutPort(dstId);
+}
+
+// The bisection bandwidth and diameter are properties of the whole network.
+// They are reported once - by the OPCalc of port 0 on router 0
+void XYZOPCalc::finish()
+{
+	cModule *router = getParentModule()->getParentModule();
+	if (((int)router->par("id") != 0) || (getParentModule()->getIndex() != 0))
+		return;
+
+	// a cut across a dimension of size > 1 crosses all the links of the
+	// orthogonal plane. The bisection is the minimal such cut (one direction)
+	double bisectionBW = -1;
+	if (numCols > 1) {
+		double bw = 1.0 * numRows * numLayers * planarDatarate;
+		if ((bisectionBW < 0) || (bw < bisectionBW)) bisectionBW = bw;
+	}
+	if (numRows > 1) {
+		double bw = 1.0 * numCols * numLayers * planarDatarate;
+		if ((bisectionBW < 0) || (bw < bisectionBW)) bisectionBW = bw;
+	}
+	if (numLayers > 1) {
+		double bw = 1.0 * numCols * numRows * verticalDatarate;
+		if ((bisectionBW < 0) || (bw < bisectionBW)) bisectionBW = bw;
+	}
+	recordScalar("bisection-bandwidth-Gbps", bisectionBW * 1e-9);
+	recordScalar("network-diameter-hops", (numCols - 1) + (numRows - 1) + (numLayers - 1));
+}
@@ -0,0 +1,72 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+
+#ifndef __HNOCS_XYZ_OPCALC_H_
+#define __HNOCS_XYZ_OPCALC_H_
+
+#include <omnetpp.h>
+using namespace omnetpp;
+
+#include "XYOPCalc.h"
+
+//
+// The Out Port Calc class implements the local routing decision.
+// Given a packet message it decides what router output port the message
+// should be forwarded to
+//
+// This implementation provides XYZ - Routing:
+// ============================================
+// This calculator is performing row first, then column and then layer (XYZ)
+// dimension order routing on a 3D stacked mesh. Given the destination id and
+// it's current id it first needs to know how to extract row, column and layer:
+// id = layer*rows*columns + row*columns + column
+//
+// The XY routing within a layer is the one of XYOPCalc. This class adds the
+// layer coordinate and the up and down ports of the vertical links.
+//
+// NOTE: This module assumes the mesh is built out of routers and cores.
+// it also requires that routers share the same id as the core they connect to
+// It does not require each router to have a core.
+// It can handle disconnected ports like on the edges of the network.
+//
+class XYZOPCalc : public XYOPCalc
+{
+private:
+	// parameters
+	int numRows; // the total number of rows in the simulations
+	int numLayers; // the total number of stacked layers in the simulations
+	int rz;  // the local router z coordinate
+	int upPort, downPort; // port indexes of the vertical links
+	double planarDatarate, verticalDatarate; // rates of the links found - for bisection BW
+
+	// methods:
+
+	// convert core and router id's into row, col and layer (X, Y and Z)
+	int rowColLayerByID(int id, int &x, int &y, int &z);
+	// obtain the datarate of the link connected to the given port
+	double getPortLinkDatarate(cModule *port);
+protected:
+	// the row and col (X and Y) within the layer
+	virtual int rowColByID(int id, int &x, int &y);
+	// classify the up and down ports
+	virtual bool analyzeRemotePort(cModule *port, cModule *remPort, int portIdx);
+	// route to the destination layer
+	virtual int calcLocalOutPort(int dstId);
+
+    virtual void initialize();
+    virtual void finish();
+};
+
+#endif
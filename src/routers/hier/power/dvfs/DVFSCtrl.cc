@@ -0,0 +1,224 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+
+#include "DVFSCtrl.h"
+#include "NoCs_m.h"
+
+Define_Module(DVFSCtrl);
+
+void DVFSCtrl::initialize()
+{
+	numPorts = par("numPorts");
+	samplePeriod = par("samplePeriod");
+	transitionLatency = par("transitionLatency");
+	upThreshold = par("upThreshold");
+	downThreshold = par("downThreshold");
+	statStartTime = par("statStartTime");
+
+	std::vector<std::string> lvls = cStringTokenizer(par("levels")).asVector();
+	for (unsigned int l = 0; l < lvls.size(); l++) {
+		double f, v;
+		if ((sscanf(lvls[l].c_str(), "%lf/%lf", &f, &v) != 2) || (f <= 0) || (v <= 0)) {
+			throw cRuntimeError("-E- %s bad V/f level: %s - expecting freqScale/voltage",
+					getFullPath().c_str(), lvls[l].c_str());
+		}
+		if (l && (f >= freqScale[l-1])) {
+			throw cRuntimeError("-E- %s levels must be given fastest first",
+					getFullPath().c_str());
+		}
+		freqScale.push_back(f);
+		voltage.push_back(v);
+	}
+	if (!freqScale.size()) {
+		throw cRuntimeError("-E- %s no V/f levels given", getFullPath().c_str());
+	}
+	if (samplePeriod <= 0) {
+		throw cRuntimeError("-E- %s samplePeriod must be positive", getFullPath().c_str());
+	}
+
+	curLevel = 0;
+	collected = false;
+	lastAccount = SIMTIME_ZERO;
+	lastTotalGrants = 0;
+	dynWeighted = 0;
+	dynEvents = 0;
+	leakWeighted = 0;
+	leakTime = 0;
+	levelTime.resize(freqScale.size(), 0);
+	numTransitions = 0;
+	WATCH(curLevel);
+
+	sampleMsg = new cMessage("dvfs-sample");
+	sampleMsg->setKind(NOC_CLK_MSG);
+	scheduleAt(simTime() + samplePeriod, sampleMsg);
+}
+
+void DVFSCtrl::handleMessage(cMessage *msg)
+{
+	if (msg != sampleMsg) {
+		throw cRuntimeError("Does not know how to handle message of type %d", msg->getKind());
+	}
+	sample();
+	scheduleAt(simTime() + samplePeriod, sampleMsg);
+}
+
+// the out port Scheds and the switch links driven by the InPorts. Done on
+// the first sample when the channels are initialized
+void DVFSCtrl::collect()
+{
+	cModule *router = getParentModule();
+	scheds.resize(numPorts, NULL);
+	prevGrants.resize(numPorts, 0);
+	for (int p = 0; p < numPorts; p++) {
+		cModule *port = router->getSubmodule("port", p);
+		if (!port)
+			continue;
+		scheds[p] = dynamic_cast<Sched *>(port->getSubmodule("sched"));
+		if (scheds[p] && (scheds[p]->getClockPeriod() == SIMTIME_ZERO))
+			scheds[p] = NULL; // disconnected
+		if (scheds[p])
+			prevGrants[p] = scheds[p]->getNumGrants();
+		cModule *inPort = port->getSubmodule("inPort");
+		if (!inPort)
+			continue;
+		for (int o = 0; o < inPort->gateSize("out"); o++) {
+			cDatarateChannel *ch = dynamic_cast<cDatarateChannel *>(
+					inPort->gate("out", o)->findTransmissionChannel());
+			if (ch) {
+				swLinks.push_back(ch);
+				swLinkRates.push_back(ch->getDatarate());
+			}
+		}
+	}
+	lastTotalGrants = getTotalGrants();
+	collected = true;
+}
+
+long DVFSCtrl::getTotalGrants() const
+{
+	long n = 0;
+	for (unsigned int p = 0; p < scheds.size(); p++)
+		if (scheds[p])
+			n += scheds[p]->getNumGrants();
+	return n;
+}
+
+// add the time and grants since the last accounting at the current level
+void DVFSCtrl::account()
+{
+	long totalGrants = getTotalGrants();
+	simtime_t from = (lastAccount > statStartTime) ? lastAccount : statStartTime;
+	if (simTime() > from) {
+		double v = voltage[curLevel] / voltage[0];
+		double dt = (simTime() - from).dbl();
+		leakWeighted += dt * v;
+		leakTime += dt;
+		levelTime[curLevel] += dt;
+		dynWeighted += (totalGrants - lastTotalGrants) * v * v;
+		dynEvents += totalGrants - lastTotalGrants;
+	}
+	lastAccount = simTime();
+	lastTotalGrants = totalGrants;
+}
+
+void DVFSCtrl::setLevel(int level)
+{
+	EV << "-I- " << getFullPath() << " moving from V/f level " << curLevel
+	   << " to " << level << endl;
+	curLevel = level;
+	for (unsigned int p = 0; p < scheds.size(); p++)
+		if (scheds[p])
+			scheds[p]->setClockScale(freqScale[level], transitionLatency);
+	for (unsigned int l = 0; l < swLinks.size(); l++)
+		swLinks[l]->setDatarate(swLinkRates[l] * freqScale[level]);
+	if (simTime() > statStartTime)
+		numTransitions++;
+}
+
+void DVFSCtrl::sample()
+{
+	if (!collected)
+		collect();
+
+	// the utilization of the busiest out port in the window
+	double maxUtil = 0;
+	for (unsigned int p = 0; p < scheds.size(); p++) {
+		if (!scheds[p])
+			continue;
+		long grants = scheds[p]->getNumGrants();
+		double util = (grants - prevGrants[p]) * scheds[p]->getClockPeriod().dbl()
+			/ samplePeriod.dbl();
+		prevGrants[p] = grants;
+		if (util > maxUtil)
+			maxUtil = util;
+	}
+	account();
+
+	int numLevels = freqScale.size();
+	if ((maxUtil > upThreshold) && (curLevel > 0)) {
+		setLevel(curLevel - 1);
+	} else if ((maxUtil < downThreshold) && (curLevel < numLevels - 1)
+			&& (maxUtil * freqScale[curLevel] / freqScale[curLevel + 1] < upThreshold)) {
+		setLevel(curLevel + 1);
+	}
+}
+
+// the accounting up to now without changing the state
+double DVFSCtrl::getDynamicEnergyScale() const
+{
+	double v = voltage[curLevel] / voltage[0];
+	double events = dynEvents;
+	double weighted = dynWeighted;
+	if (simTime() > statStartTime) {
+		long newGrants = getTotalGrants() - lastTotalGrants;
+		events += newGrants;
+		weighted += newGrants * v * v;
+	}
+	return events ? weighted / events : 1.0;
+}
+
+double DVFSCtrl::getLeakageEnergyScale() const
+{
+	double v = voltage[curLevel] / voltage[0];
+	double t = leakTime;
+	double weighted = leakWeighted;
+	simtime_t from = (lastAccount > statStartTime) ? lastAccount : statStartTime;
+	if (simTime() > from) {
+		t += (simTime() - from).dbl();
+		weighted += (simTime() - from).dbl() * v;
+	}
+	return t ? weighted / t : 1.0;
+}
+
+void DVFSCtrl::finish()
+{
+	account();
+	if (leakTime > 0) {
+		double avgFreq = 0;
+		for (unsigned int l = 0; l < levelTime.size(); l++) {
+			char name[64];
+			sprintf(name, "dvfs-level-%d-residency", l);
+			recordScalar(name, levelTime[l] / leakTime);
+			avgFreq += freqScale[l] * levelTime[l] / leakTime;
+		}
+		recordScalar("dvfs-average-freq-scale", avgFreq);
+		recordScalar("dvfs-transitions", numTransitions);
+	}
+}
+
+DVFSCtrl::~DVFSCtrl()
+{
+	cancelAndDelete(sampleMsg);
+}
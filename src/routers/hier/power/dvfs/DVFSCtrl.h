@@ -0,0 +1,98 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+
+#ifndef __HNOCS_DVFS_CTRL_H_
+#define __HNOCS_DVFS_CTRL_H_
+
+#include <omnetpp.h>
+using namespace omnetpp;
+
+#include "routers/hier/HierRouter.h"
+
+//
+// Router level dynamic voltage and frequency scaling controller
+//
+// The router runs at one of the V/f levels given by the "levels" parameter
+// as "freqScale/voltage" pairs, fastest (nominal) first. Every samplePeriod
+// the controller computes the utilization of each out port: the number of
+// grants its Sched made in the window over the number of clocks in it. The
+// busiest port decides:
+//  * above upThreshold the router moves one level faster
+//  * below downThreshold it moves one level slower, unless the utilization
+//    scaled to the slower clock would already pass upThreshold
+//
+// A level change scales the Sched clocks and out links (Sched::setClockScale)
+// and the router internal SwLinks. The Scheds make no grant for
+// transitionLatency. The pipeline delays of the InPorts are not scaled.
+//
+// Energy: the dynamic energy of an event scales with V^2 and the leakage
+// power with V, relative to the voltage of the first level. The scales
+// reported to the EnergyMonitor are weighted by the grants and by time.
+//
+// Statistics: dvfs-transitions, dvfs-average-freq-scale and the time
+// fraction spent in each level dvfs-level-<i>-residency
+//
+class DVFSCtrl : public PowerCtrl
+{
+private:
+	// parameters
+	int numPorts;
+	std::vector<double> freqScale; // per level
+	std::vector<double> voltage;   // per level
+	simtime_t samplePeriod;
+	simtime_t transitionLatency;
+	double upThreshold;
+	double downThreshold;
+	simtime_t statStartTime;
+
+	// state
+	int curLevel;
+	bool collected;                         // the Scheds and links were collected
+	std::vector<Sched*> scheds;             // per port (NULL if none)
+	std::vector<long> prevGrants;           // per port grants at the last sample
+	std::vector<cDatarateChannel*> swLinks; // the router internal switch links
+	std::vector<double> swLinkRates;        // their nominal datarate
+	cMessage *sampleMsg;
+
+	// energy and residency accounting since statStartTime
+	simtime_t lastAccount;
+	long lastTotalGrants;
+	double dynWeighted;  // sum of grants * (V/V0)^2
+	double dynEvents;    // sum of grants
+	double leakWeighted; // sum of time * V/V0
+	double leakTime;
+	std::vector<double> levelTime; // per level [sec]
+	int numTransitions;
+
+	// methods
+	void collect();
+	long getTotalGrants() const;
+	void account();
+	void setLevel(int level);
+	void sample();
+
+protected:
+	virtual void initialize();
+	virtual void handleMessage(cMessage *msg);
+	virtual void finish();
+
+public:
+	virtual double getDynamicEnergyScale() const;
+	virtual double getLeakageEnergyScale() const;
+	DVFSCtrl() { sampleMsg = NULL; };
+	virtual ~DVFSCtrl();
+};
+
+#endif
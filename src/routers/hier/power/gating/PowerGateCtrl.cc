@@ -0,0 +1,163 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+
+#include "PowerGateCtrl.h"
+#include "NoCs_m.h"
+
+Define_Module(PowerGateCtrl);
+
+void PowerGateCtrl::initialize()
+{
+	numPorts = par("numPorts");
+	tClk = par("tClk");
+	idleCycles = par("idleCycles");
+	wakeupLatency = par("wakeupLatency");
+	gatedLeakage = par("gatedLeakage");
+	statStartTime = par("statStartTime");
+	if (tClk <= 0) {
+		throw cRuntimeError("-E- %s tClk must be positive", getFullPath().c_str());
+	}
+
+	collected = false;
+	numVCs = 0;
+	isOff = false;
+	awakeAt = SIMTIME_ZERO;
+	offSince = SIMTIME_ZERO;
+	numIdleCycles = 0;
+	gatedTime = 0;
+	numWakeups = 0;
+	wakeupPenalty = 0;
+	WATCH(isOff);
+	WATCH(numIdleCycles);
+
+	clkMsg = new cMessage("gate-clk");
+	clkMsg->setKind(NOC_CLK_MSG);
+	scheduleAt(simTime() + tClk, clkMsg);
+}
+
+void PowerGateCtrl::collect()
+{
+	cModule *router = getParentModule();
+	for (int p = 0; p < numPorts; p++) {
+		cModule *port = router->getSubmodule("port", p);
+		if (!port)
+			continue;
+		Sched *sched = dynamic_cast<Sched *>(port->getSubmodule("sched"));
+		if (sched && (sched->getClockPeriod() != SIMTIME_ZERO))
+			scheds.push_back(sched);
+		cModule *inPortMod = port->getSubmodule("inPort");
+		InPort *inPort = dynamic_cast<InPort *>(inPortMod);
+		if (inPort) {
+			inPorts.push_back(inPort);
+			numVCs = inPortMod->par("numVCs");
+		}
+	}
+	collected = true;
+}
+
+bool PowerGateCtrl::isRouterIdle() const
+{
+	for (unsigned int i = 0; i < inPorts.size(); i++)
+		for (int vc = 0; vc < numVCs; vc++)
+			if (inPorts[i]->getNumQueuedFlits(vc))
+				return false;
+	for (unsigned int s = 0; s < scheds.size(); s++)
+		if (!scheds[s]->isIdle())
+			return false;
+	return true;
+}
+
+// the clock only runs while the router is on
+void PowerGateCtrl::handleMessage(cMessage *msg)
+{
+	if (msg != clkMsg) {
+		throw cRuntimeError("Does not know how to handle message of type %d", msg->getKind());
+	}
+	if (!collected)
+		collect();
+
+	if (!isRouterIdle()) {
+		numIdleCycles = 0;
+	} else if (++numIdleCycles >= idleCycles) {
+		EV << "-I- " << getFullPath() << " turning the router off" << endl;
+		isOff = true;
+		offSince = simTime();
+		numIdleCycles = 0;
+		return;
+	}
+	scheduleAt(simTime() + tClk, clkMsg);
+}
+
+bool PowerGateCtrl::isAwake() const
+{
+	return !isOff && (simTime() >= awakeAt);
+}
+
+simtime_t PowerGateCtrl::wakeUp()
+{
+	Enter_Method_Silent();
+	if (!isOff)
+		return (awakeAt > simTime()) ? awakeAt : simTime();
+
+	EV << "-I- " << getFullPath() << " waking the router up" << endl;
+	isOff = false;
+	awakeAt = simTime() + wakeupLatency;
+	// the router is off until it is on again
+	simtime_t from = (offSince > statStartTime) ? offSince : statStartTime;
+	if (awakeAt > from)
+		gatedTime += (awakeAt - from).dbl();
+	if (simTime() > statStartTime) {
+		numWakeups++;
+		wakeupPenalty += wakeupLatency.dbl();
+	}
+	scheduleAt(awakeAt + tClk, clkMsg);
+	return awakeAt;
+}
+
+// including the current off period
+double PowerGateCtrl::getGatedTime() const
+{
+	double t = gatedTime;
+	simtime_t from = (offSince > statStartTime) ? offSince : statStartTime;
+	if (isOff && (simTime() > from))
+		t += (simTime() - from).dbl();
+	else if (!isOff && (awakeAt > simTime()))
+		t -= (awakeAt - simTime()).dbl(); // waking up - not off yet
+	return t;
+}
+
+double PowerGateCtrl::getLeakageEnergyScale() const
+{
+	if (simTime() <= statStartTime)
+		return 1.0;
+	double frac = getGatedTime() / (simTime() - statStartTime).dbl();
+	return 1.0 - frac * (1.0 - gatedLeakage);
+}
+
+void PowerGateCtrl::finish()
+{
+	if (simTime() <= statStartTime)
+		return;
+	double t = getGatedTime();
+	recordScalar("gated-cycles", floor(t / tClk.dbl()));
+	recordScalar("gated-time-fraction", t / (simTime() - statStartTime).dbl());
+	recordScalar("wakeups", numWakeups);
+	recordScalar("wakeup-penalty-ns", 1e9 * wakeupPenalty);
+}
+
+PowerGateCtrl::~PowerGateCtrl()
+{
+	cancelAndDelete(clkMsg);
+}
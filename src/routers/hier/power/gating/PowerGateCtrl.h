@@ -0,0 +1,91 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+
+#ifndef __HNOCS_POWER_GATE_CTRL_H_
+#define __HNOCS_POWER_GATE_CTRL_H_
+
+#include <omnetpp.h>
+using namespace omnetpp;
+
+#include "routers/hier/HierRouter.h"
+
+//
+// Router level power gating controller
+//
+// While the router is on, the controller checks it on every tClk. The router
+// is idle if no flit is queued in its InPorts and every connected Sched is
+// idle (no Req and the out link is free). After idleCycles consecutive idle
+// clocks the router is turned off and the checks stop.
+//
+// A router which is off is woken up (PowerCtrl::wakeUp) by:
+//  * an upstream Sched which has a Req to send into it. The upstream sees
+//    the router as unavailable and does not grant until it is on
+//  * a flit arriving at its InPorts (from a core). The InPort holds the
+//    flits until the router is on
+//  * a credit arriving at its Scheds
+// The router is back on wakeupLatency after the first wake up.
+//
+// While off the router leaks gatedLeakage of its leakage power, which is
+// provided to the EnergyMonitor as the leakage energy scale.
+//
+// Statistics: gated-cycles, gated-time-fraction, wakeups and
+// wakeup-penalty-ns - the total time requesters waited for the router
+//
+class PowerGateCtrl : public PowerCtrl
+{
+private:
+	// parameters
+	int numPorts;
+	simtime_t tClk;
+	int idleCycles;
+	simtime_t wakeupLatency;
+	double gatedLeakage;
+	simtime_t statStartTime;
+
+	// state
+	bool collected;
+	std::vector<Sched*> scheds;   // the connected out port Scheds
+	std::vector<InPort*> inPorts;
+	int numVCs;
+	bool isOff;
+	simtime_t awakeAt;  // the router is on from this time (if not off)
+	simtime_t offSince;
+	int numIdleCycles;
+	cMessage *clkMsg;
+
+	// statistics
+	double gatedTime;   // [sec] since statStartTime
+	int numWakeups;
+	double wakeupPenalty; // [sec]
+
+	// methods
+	void collect();
+	bool isRouterIdle() const;
+	double getGatedTime() const;
+
+protected:
+	virtual void initialize();
+	virtual void handleMessage(cMessage *msg);
+	virtual void finish();
+
+public:
+	virtual double getLeakageEnergyScale() const;
+	virtual bool isAwake() const;
+	virtual simtime_t wakeUp();
+	PowerGateCtrl() { clkMsg = NULL; };
+	virtual ~PowerGateCtrl();
+};
+
+#endif
@@ -29,6 +29,11 @@
 // Prefer to keep sending entire packet if possible
 // If not cycle first through the VCs
 // If no other VC has request it may switch port only if not in the middle of packet
+// The VCs are scanned per SL: strict priority SLs first then the WRR SLs
+// With VCT/SAF flow control a packet head is granted only when the whole
+// packet fits the downstream VC (and for SAF is fully stored in the InPort)
+// No flit is granted on a clock reserved for a fast-forwarded packet and a
+// packet head is not granted if its flits would reach a reserved clock
 //
 // Clk'ed according to the outgoing link rate, gets clk only when it has something to arbitrate ...
 
@@ -53,6 +58,53 @@ void SchedSync::initialize() {
 	linkUtilization.setName("link-utilization");
     statStartTime = par("statStartTime");
     numSends = 0;
+    numGrants = 0;
+    numArbitrations = 0;
+    busyTime = 0;
+    stallUntil = SIMTIME_ZERO;
+    statClks = 0;
+    lastClkChange = SIMTIME_ZERO;
+
+	// flow control
+	const char *fc = par("flowControl");
+	if (!strcmp(fc, "wormhole")) {
+		flowControl = FC_WORMHOLE;
+	} else if (!strcmp(fc, "vct")) {
+		flowControl = FC_VCT;
+	} else if (!strcmp(fc, "saf")) {
+		flowControl = FC_SAF;
+	} else {
+		throw cRuntimeError("-E- %s unknown flowControl: %s",
+				getFullPath().c_str(), fc);
+	}
+	vcMaxCredits.resize(numVCs, 0);
+
+	// QoS service levels
+	numSLs = par("numSLs");
+	numStrictSLs = par("numStrictSLs");
+	if ((numSLs < 1) || (numSLs > numVCs)) {
+		throw cRuntimeError("-E- %s numSLs:%d must be 1..numVCs:%d",
+				getFullPath().c_str(), numSLs, numVCs);
+	}
+	if ((numStrictSLs < 0) || (numStrictSLs > numSLs)) {
+		throw cRuntimeError("-E- %s numStrictSLs:%d must be 0..numSLs:%d",
+				getFullPath().c_str(), numStrictSLs, numSLs);
+	}
+	slWeights = cStringTokenizer(par("slWeights")).asIntVector();
+	if (slWeights.size() == 0) {
+		slWeights.resize(numSLs, 1);
+	} else if ((int)slWeights.size() != numSLs) {
+		throw cRuntimeError("-E- %s slWeights has %d entries but numSLs is %d",
+				getFullPath().c_str(), (int)slWeights.size(), numSLs);
+	}
+	for (int sl = 0; sl < numSLs; sl++) {
+		if (slWeights[sl] < 1) {
+			throw cRuntimeError("-E- %s slWeights[%d] must be >= 1",
+					getFullPath().c_str(), sl);
+		}
+	}
+	curWrrSL = numStrictSLs;
+	wrrGrantsLeft = (curWrrSL < numSLs) ? slWeights[curWrrSL] : 0;
 
 	// arbitration state
 	vcCurInPort.resize(numVCs, 0);
@@ -61,6 +113,8 @@ void SchedSync::initialize() {
 	curVC = numVCs - 1;
 	isDisconnected = (gate("out$o", 0)->getPathEndGate()->getType()
 			!= cGate::INPUT);
+	toCore = !isDisconnected && !dynamic_cast<InPort *>(
+			gate("out$o", 0)->getPathEndGate()->getOwnerModule());
 
 	ReqsByIPoVC.resize(numInPorts);
 	for (int i = 0; i < numInPorts; i++)
@@ -70,6 +124,33 @@ void SchedSync::initialize() {
 	vcCurReq.resize(numVCs, NULL);
 	WATCH_VECTOR(vcCurReq);
 
+	// the InPorts on the other side of the ctrl gates (NULL if not an InPort)
+	inPorts.resize(numInPorts, NULL);
+	for (int ip = 0; ip < numInPorts; ip++) {
+		cGate *g = gate("ctrl$o", ip)->getPathEndGate();
+		inPorts[ip] = dynamic_cast<InPort *>(g->getOwnerModule());
+	}
+
+	// optional router level switch allocator
+	cModule *router = getParentModule()->getParentModule();
+
+	// power gating - ours and of the next router
+	powerCtrl = dynamic_cast<PowerCtrl *>(router->getSubmodule("powerCtrl"));
+	downPowerCtrl = NULL;
+	smartOut = NULL;
+	smartVC = -1;
+	cModule *down = gate("out$o", 0)->getPathEndGate()->getOwnerModule();
+	if (dynamic_cast<InPort *>(down)) {
+		cModule *downRouter = down->getParentModule()->getParentModule();
+		downPowerCtrl = dynamic_cast<PowerCtrl *>(downRouter->getSubmodule("powerCtrl"));
+		if (down->hasGate("directIn"))
+			smartOut = down->gate("directIn");
+	}
+	swAlloc = dynamic_cast<SwAlloc *>(router->getSubmodule("swAlloc"));
+	if (swAlloc && !isDisconnected) {
+		swAlloc->registerSched(getParentModule()->getIndex(), this);
+	}
+
 	// start the clock
 	if (!isDisconnected) {
 
@@ -92,6 +173,8 @@ void SchedSync::initialize() {
 			EV<< "-I- " << getFullPath() << " Channel rate is:" << data_rate << " Clock is:" << tClk_s<< " (freeClk)"<< endl;
 
 		}
+		nomTClk_s = tClk_s;
+		nomDataRate = data_rate;
 
 
 
@@ -116,45 +199,81 @@ void SchedSync::initialize() {
 	}
 }
 
-// The actual arbitration function - send the GNT to the selected ip/vc
-//
-// The arbiter has to avoid mixing two packets on same oVC.
-// * Changing inPort on same oVC is not allowed in the middle of a packet.
-//   This is implemented by tracking the curReq[vc] which is set to NULL
-//   once the EoP flit is passing.
-// * If the curReq[vc]is not NULL no port change allowed
-// * At the end of packet we can not switch to other inPort or even inVC of same inPort
-//   before the flits of the packet are all sent (since they may be actually NaKed).
-//   So the Req stay at the head of the ReqsByIPoVC[ip][oVC] until all its flits pass.
-//
-void SchedSync::arbitrate() {
+// Flow control check for granting the head flit of a packet. Once the head
+// is granted the out VC is held by the packet until its EoP passes, so the
+// credits checked here are kept for the rest of the packet.
+// * wormhole - any credit is enough (checked by the caller)
+// * VCT - the downstream VC must have room for the entire packet
+// * SAF - as VCT and the entire packet must be stored in the InPort
+bool SchedSync::canStartPkt(int ip, int vc, NoCReqMsg *req) {
+	if (req->getNumGranted() > 0)
+		return true;
+	int numFlits = req->getNumFlits();
+	if (linkReservations.size()
+			&& isLinkReserved(simTime(), simTime() + numFlits * tClk_s))
+		return false;
+	if (flowControl == FC_WORMHOLE)
+		return true;
+	if (numFlits > vcMaxCredits[vc]) {
+		throw cRuntimeError("-E- %s packet of %d flits can never fit the %d downstream "
+				"buffers of VC %d required by VCT/SAF flow control",
+				getFullPath().c_str(), numFlits, vcMaxCredits[vc], vc);
+	}
+	if (credits[vc] < numFlits)
+		return false;
+	if ((flowControl == FC_SAF) && inPorts[ip]
+			&& (inPorts[ip]->getNumQueuedFlits(req->getInVC()) < numFlits))
+		return false;
+	return true;
+}
 
-	// loop to find something to do
-	int nextInPort;
-	int nextVC;
-	bool found = false;
+// Check if the head Req of the ip/vc can be granted a flit right now.
+// Used with a switch allocator which requires any grant to be used so
+// flits that did not reach the InPort yet are not granted.
+bool SchedSync::isGrantable(int ip, int vc) {
+	if (!credits[vc] || !ReqsByIPoVC[ip][vc].size())
+		return false;
+	NoCReqMsg *req = ReqsByIPoVC[ip][vc].front();
+	if (vcCurReq[vc] && (vcCurReq[vc] != req))
+		return false;
+	if (req->getNumGranted() == req->getNumFlits())
+		return false;
+	if (!canStartPkt(ip, vc, req))
+		return false;
+	// granted flits that were not received yet are still in the InPort Q
+	int numPendingGnts = req->getNumGranted() - req->getNumAcked();
+	if (inPorts[ip] && (inPorts[ip]->getNumQueuedFlits(req->getInVC()) <= numPendingGnts))
+		return false;
+	return true;
+}
 
-	if (!cSimulation::getActiveEnvir()->isLoggingEnabled()) {
-		EV << "-I- " << getFullPath() << " credits: ";
-		for (int vc = 0; vc < numVCs; vc++)
-			EV << vc << ":" << credits[vc] << " ";
-		EV << endl;
-		EV << "-I- " << getFullPath() << " requests: ";
-		for (int ip = 0; ip < numInPorts; ip++)
-			for (int vc = 0; vc < numVCs; vc++)
-				EV << ip << "," << vc << ":" << ReqsByIPoVC[ip][vc].size() << " ";
-		EV << endl;
-	}
+// Find the next Req to grant on the VCs of the given SL. Return true if found
+// If onlyInPort >= 0 only a grantable Req of that InPort is looked for
+bool SchedSync::findReqOnSL(int sl, int onlyInPort, int &nextInPort, int &nextVC) {
+	bool found = false;
 
 	// start with curVC - winner takes all (0)
 	// start with next VC - round robin (1)
 	for (int i = arbiter_start_indx; !found && (i <= numVCs); i++) {
 		int vc = (curVC + i) % numVCs;
 
+		// only the VCs of the SL
+		if ((numSLs > 1) && (vcToSL(vc, numSLs, numVCs) != sl))
+			continue;
+
 		// are there credits on this VC?
 		if (!credits[vc])
 			continue;
 
+		if (onlyInPort >= 0) {
+			if (isGrantable(onlyInPort, vc)) {
+				nextVC = vc;
+				nextInPort = onlyInPort;
+				found = true;
+			}
+			continue;
+		}
+
 		// can not change port during a Req (if it is still the head of ReqsByIPoVC and has
 		// some pending grants to make)
 		int ip = vcCurInPort[vc];
@@ -171,8 +290,9 @@ void SchedSync::arbitrate() {
 			// to curPort of the vc
 			for (int j = 1; !found && (j <= numInPorts); j++) {
 				int ip = (vcCurInPort[vc] + j) % numInPorts;
-				// is there a pending req?
-				if (ReqsByIPoVC[ip][vc].size()) {
+				// is there a pending req that may start?
+				if (ReqsByIPoVC[ip][vc].size()
+						&& canStartPkt(ip, vc, ReqsByIPoVC[ip][vc].front())) {
 					nextVC = vc;
 					nextInPort = ip;
 					found = true;
@@ -180,6 +300,109 @@ void SchedSync::arbitrate() {
 			}
 		}
 	}
+	return found;
+}
+
+// Find a Req of a packet latched through the router (express VC)
+// that may be granted. These win the switch over the buffered packets
+bool SchedSync::findBypassReq(int onlyInPort, int &nextInPort, int &nextVC) {
+	for (int vc = 0; vc < numVCs; vc++) {
+		if (!credits[vc])
+			continue;
+		for (int ip = 0; ip < numInPorts; ip++) {
+			if ((onlyInPort >= 0) && (ip != onlyInPort))
+				continue;
+			if (!ReqsByIPoVC[ip][vc].size())
+				continue;
+			NoCReqMsg *req = ReqsByIPoVC[ip][vc].front();
+			if (!req->getBypass() || (req->getNumGranted() == req->getNumFlits()))
+				continue;
+			if (vcCurReq[vc] && (vcCurReq[vc] != req))
+				continue;
+			if (!canStartPkt(ip, vc, req))
+				continue;
+			if ((onlyInPort >= 0) && !isGrantable(ip, vc))
+				continue;
+			nextInPort = ip;
+			nextVC = vc;
+			return true;
+		}
+	}
+	return false;
+}
+
+// Select the Req to be granted by SL priority. Return the SL or -1 if none
+int SchedSync::selectReq(int onlyInPort, int &nextInPort, int &nextVC) {
+	// packets latched through the router first
+	if (findBypassReq(onlyInPort, nextInPort, nextVC))
+		return vcToSL(nextVC, numSLs, numVCs);
+
+	// strict priority SLs first - lower SL is served first
+	for (int sl = 0; sl < numStrictSLs; sl++) {
+		if (findReqOnSL(sl, onlyInPort, nextInPort, nextVC))
+			return sl;
+	}
+	// then the WRR SLs starting with the currently served one
+	int numWrrSLs = numSLs - numStrictSLs;
+	for (int k = 0; k < numWrrSLs; k++) {
+		int sl = numStrictSLs + (curWrrSL - numStrictSLs + k) % numWrrSLs;
+		if (findReqOnSL(sl, onlyInPort, nextInPort, nextVC))
+			return sl;
+	}
+	return -1;
+}
+
+// The actual arbitration function - send the GNT to the selected ip/vc
+//
+// The arbiter has to avoid mixing two packets on same oVC.
+// * Changing inPort on same oVC is not allowed in the middle of a packet.
+//   This is implemented by tracking the curReq[vc] which is set to NULL
+//   once the EoP flit is passing.
+// * If the curReq[vc]is not NULL no port change allowed
+// * At the end of packet we can not switch to other inPort or even inVC of same inPort
+//   before the flits of the packet are all sent (since they may be actually NaKed).
+//   So the Req stay at the head of the ReqsByIPoVC[ip][oVC] until all its flits pass.
+//
+// If onlyInPort >= 0 (switch allocator mode) only that InPort may be granted.
+//
+void SchedSync::arbitrate(int onlyInPort) {
+
+	// loop to find something to do
+	int nextInPort;
+	int nextVC;
+	bool found = false;
+
+	// the next router is power gated - wake it up. It is unavailable until on
+	if (downPowerCtrl && numReqs && !downPowerCtrl->isAwake()) {
+		downPowerCtrl->wakeUp();
+		return;
+	}
+
+	// a SMART packet is passing through - it holds the out link until its EoP
+	if (smartVC >= 0) {
+		EV << "-I- " << getFullPath() << " out link held by a SMART packet" << endl;
+		return;
+	}
+
+	if (!cSimulation::getActiveEnvir()->isLoggingEnabled()) {
+		EV << "-I- " << getFullPath() << " credits: ";
+		for (int vc = 0; vc < numVCs; vc++)
+			EV << vc << ":" << credits[vc] << " ";
+		EV << endl;
+		EV << "-I- " << getFullPath() << " requests: ";
+		for (int ip = 0; ip < numInPorts; ip++)
+			for (int vc = 0; vc < numVCs; vc++)
+				EV << ip << "," << vc << ":" << ReqsByIPoVC[ip][vc].size() << " ";
+		EV << endl;
+	}
+
+	int selSL = selectReq(onlyInPort, nextInPort, nextVC);
+	int numWrrSLs = numSLs - numStrictSLs;
+	if ((selSL >= numStrictSLs) && (selSL != curWrrSL)) {
+		curWrrSL = selSL;
+		wrrGrantsLeft = slWeights[selSL];
+	}
+	found = (selSL >= 0);
 	if (!found) {
 		EV<< "-I- " << getFullPath() << " nothing to arbitrate" << endl;
 		return;
@@ -207,6 +430,12 @@ void SchedSync::arbitrate() {
 		return;
 	}
 
+	// the clock is reserved for a fast-forwarded packet - no flit is granted
+	if (linkReservations.size() && isLinkReserved(simTime(), simTime() + tClk_s)) {
+		EV << "-I- " << getFullPath() << " clock reserved for a fast-forwarded packet" << endl;
+		return;
+	}
+
 	// update the current req pointer (we may had a more complex condition but this is OK)
 	vcCurReq[curVC] = req;
 
@@ -226,6 +455,9 @@ void SchedSync::arbitrate() {
 	// credit updates must happen here. Another option to put them on the flit receiver
 	// would cause excessive grants that do not see the real state of the
 	credits[curVC]--;
+	numGrants++;
+	if (simTime() > statStartTime)
+		numArbitrations++;
 
 	// send the Gnt
 	char gntName[128];
@@ -239,6 +471,12 @@ void SchedSync::arbitrate() {
 
 	send(gnt, "ctrl$o", vcCurInPort[curVC]);
 
+	// WRR SLs move to the next SL once their weight of grants is consumed
+	if ((selSL >= numStrictSLs) && (--wrrGrantsLeft <= 0)) {
+		curWrrSL = numStrictSLs + (curWrrSL - numStrictSLs + 1) % numWrrSLs;
+		wrrGrantsLeft = slWeights[curWrrSL];
+	}
+
 	// after completing a Req start scanning from next VC
 	// for winner takes all arbitration
 	if (arbitration_type==0) {
@@ -299,6 +537,7 @@ void SchedSync::handleFlitMsg(NoCFlitMsg *msg) {
 	if (simTime()> statStartTime) {
 	    numSends++;
 	}
+	busyTime += (chan->getTransmissionFinishTime() - simTime()).dbl();
 
 }
 
@@ -315,6 +554,15 @@ void SchedSync::handleReqMsg(NoCReqMsg *msg) {
 	numReqs++;
 	ReqsByIPoVC[ip][vc].push_back(msg);
 
+	// express VC - the Req is granted on arrival if it is the only one and
+	// the out link is free. The next clock is then kept a tClk away
+	if (msg->getBypass() && !swAlloc && (numReqs == 1) && (simTime() >= stallUntil)
+			&& !gate("out$o", 0)->getTransmissionChannel()->isBusy()) {
+		arbitrate();
+		cancelEvent(popMsg);
+		scheduleAt(simTime() + tClk_s, popMsg);
+	}
+
 	// Done: in the VC ALLOC
 	// vcUsage[vc]++;
 }
@@ -344,20 +592,36 @@ void SchedSync::handleAckMsg(NoCAckMsg *msg) {
 void SchedSync::handleCreditMsg(NoCCreditMsg *msg) {
 	int vc = msg->getVC();
 	int num = msg->getFlits();
+	// a credit wakes a power gated router up. The counter state is retained
+	if (powerCtrl && !powerCtrl->isAwake())
+		powerCtrl->wakeUp();
 	credits[vc] += num;
+	if (credits[vc] > vcMaxCredits[vc])
+		vcMaxCredits[vc] = credits[vc];
 	delete msg;
 
 }
 
 void SchedSync::handlePopMsg() {
 
+	// V/f transition - the clock is stopped
+	if (simTime() < stallUntil) {
+		if (!popMsg->isScheduled())
+			scheduleAt(stallUntil, popMsg);
+		return;
+	}
+
 	if (freeRunningClk || numReqs) {
 		if (!popMsg->isScheduled()) {
 			scheduleAt(simTime() + tClk_s, popMsg);
 			 EV<< "-I" << getFullPath() << "popMsg is scheduled to:" <<simTime() + tClk_s << endl;
 		}
 		bool busy = (gate("out$o", 0)->getTransmissionChannel()->isBusy());
-		if (heterogeneous){
+		if (swAlloc) {
+			// the grant is provided by the allocator calling grantInPort
+			if (numReqs)
+				swAlloc->requestAllocation(getParentModule()->getIndex());
+		} else if (heterogeneous){
 			if (~busy)
 				arbitrate();
 		}else{
@@ -386,19 +650,219 @@ void SchedSync::handleMessage(cMessage *msg) {
 
 	// on any incoming message restart the clock...
 	if (!freeRunningClk && !popMsg->isScheduled() && (numReqs > 0)) {
-		double j = floor((simTime().dbl() - 1e-18) / tClk_s);
-		double nextClk = (j + 1) * tClk_s;
-		while (nextClk <= simTime().dbl()+1e-18) {
-			nextClk += tClk_s;
-		}
+		simtime_t nextClk = nextClockAfter(simTime());
 		EV<< "-I" << getFullPath() << " restart popMsg is scheduled to:" << nextClk << endl;
 		scheduleAt(nextClk, popMsg);
 	}
 }
 
+// the first clock edge after t
+simtime_t SchedSync::nextClockAfter(simtime_t t) const {
+	double j = floor((t.dbl() - 1e-18) / tClk_s);
+	double nextClk = (j + 1) * tClk_s;
+	while (nextClk <= t.dbl()+1e-18) {
+		nextClk += tClk_s;
+	}
+	return nextClk;
+}
+
+// Switch allocator interface: can the InPort connected to ctrl[ip] be granted
+bool SchedSync::canGrantInPort(int ip) {
+	int nextInPort, nextVC;
+	if (downPowerCtrl && !downPowerCtrl->isAwake()) {
+		downPowerCtrl->wakeUp();
+		return false;
+	}
+	if (smartVC >= 0)
+		return false;
+	if (linkReservations.size() && isLinkReserved(simTime(), simTime() + tClk_s))
+		return false;
+	return (selectReq(ip, nextInPort, nextVC) >= 0);
+}
+
+// Switch allocator interface: grant the InPort connected to ctrl[ip]
+void SchedSync::grantInPort(int ip) {
+	Enter_Method("grantInPort %d", ip);
+	arbitrate(ip);
+}
+
+// SMART interface: nothing is pending and the out link is free
+bool SchedSync::isIdle() const {
+	if (isDisconnected || numReqs || (smartVC >= 0))
+		return false;
+	return !gate("out$o", 0)->getTransmissionChannel()->isBusy();
+}
+
+// SMART interface: the flit arriving now traverses the out link in the clock
+// that just ended, so the link must have been free during that clock. The out
+// VC must have credits for the whole packet so no flit waits here
+bool SchedSync::canSmartSend(int vc, int numFlits) const {
+	if (!smartOut || !isIdle() || (simTime() < stallUntil))
+		return false;
+	if (downPowerCtrl && !downPowerCtrl->isAwake())
+		return false;
+	if (chan->getTransmissionFinishTime() > simTime() - tClk_s)
+		return false;
+	if (linkReservations.size()
+			&& isLinkReserved(simTime(), simTime() + numFlits * tClk_s))
+		return false;
+	return (credits[vc] >= numFlits);
+}
+
+// SMART interface: send a flit latched through the router to the next InPort
+// in zero time. The flits of the packet hold the out link until the EoP
+void SchedSync::smartSend(NoCFlitMsg *flit) {
+	Enter_Method_Silent();
+	take(flit);
+	int vc = flit->getVC();
+	bool isHead = (flit->getType() == NOC_START_FLIT);
+	if (isHead ? (smartVC >= 0) : (vc != smartVC)) {
+		throw cRuntimeError("-E- %s SMART flit %d of packet 0x%x on VC %d while VC %d is passing",
+				getFullPath().c_str(), flit->getFlitIdx(), flit->getPktId(), vc, smartVC);
+	}
+	if (credits[vc] <= 0) {
+		throw cRuntimeError("-E- %s Sending on VC %d has no credits packet:%d",
+				getFullPath().c_str(), vc, flit->getPktId());
+	}
+	credits[vc]--;
+	smartVC = vc;
+	if (flit->getFlitIdx() == flit->getFlits() - 1) {
+		vcUsage[vc]--;
+		smartVC = -1;
+	}
+	if (simTime() > statStartTime)
+		numSends++;
+	busyTime += tClk_s;
+
+	EV << "-I- " << getFullPath() << " SMART flit " << flit->getFlitIdx() << " of packet 0x"
+	   << std::hex << flit->getPktId() << std::dec << " sent to " << smartOut->getFullPath() << endl;
+	sendDirect(flit, smartOut);
+}
+
+// Deadlock monitor interface: the Reqs waiting for credits or for another
+// packet to release their out VC. A Req queued behind the head Req of the
+// same InPort and VC waits for that head packet
+void SchedSync::getBlockedReqs(std::vector<BlockedReq> &reqs) const {
+	for (int ip = 0; ip < numInPorts; ip++) {
+		for (int vc = 0; vc < numVCs; vc++) {
+			const std::list<NoCReqMsg*> &ipReqs = ReqsByIPoVC[ip][vc];
+			if (!ipReqs.size())
+				continue;
+			NoCReqMsg *head = ipReqs.front();
+			for (std::list<NoCReqMsg*>::const_iterator it = ipReqs.begin();
+					it != ipReqs.end(); it++) {
+				NoCReqMsg *req = *it;
+				BlockedReq b;
+				b.inPort = inPorts[ip];
+				b.inVC = req->getInVC();
+				b.outVC = vc;
+				b.noCredits = false;
+				b.holder = NULL;
+				b.holderInVC = -1;
+				b.since = req->getCreationTime();
+				if (req != head) {
+					b.holder = inPorts[ip];
+					b.holderInVC = head->getInVC();
+				} else {
+					if (req->getNumGranted() == req->getNumFlits())
+						continue;
+					int needed = 1;
+					if ((flowControl != FC_WORMHOLE) && !req->getNumGranted())
+						needed = req->getNumFlits();
+					b.noCredits = (credits[vc] < needed);
+					if (vcCurReq[vc] && (vcCurReq[vc] != req)) {
+						b.holder = inPorts[vcCurInPort[vc]];
+						b.holderInVC = vcCurReq[vc]->getInVC();
+					}
+					if (!b.noCredits && !b.holder)
+						continue;
+				}
+				reqs.push_back(b);
+			}
+		}
+	}
+}
+
+// DVFS interface: change the clock and the out link datarate. The clocks
+// counted so far for the link utilization are accumulated at the old rate
+void SchedSync::setClockScale(double scale, simtime_t stall) {
+	Enter_Method("setClockScale %g", scale);
+	if (isDisconnected)
+		return;
+	simtime_t from = (lastClkChange > statStartTime) ? lastClkChange : statStartTime;
+	if (simTime() > from)
+		statClks += (simTime() - from).dbl() / tClk_s;
+	lastClkChange = simTime();
+
+	tClk_s = nomTClk_s / scale;
+	data_rate = nomDataRate * scale;
+	chan->setDatarate(data_rate);
+	stallUntil = simTime() + stall;
+	EV << "-I- " << getFullPath() << " clock scaled by " << scale << " to " << tClk_s
+	   << " stalled until " << stallUntil << endl;
+}
+
+// true if the clocks of [from, to) overlap a window reserved by the FastForward module
+bool SchedSync::isLinkReserved(simtime_t from, simtime_t to) const {
+	std::list< std::pair<simtime_t,simtime_t> >::const_iterator it;
+	for (it = linkReservations.begin(); it != linkReservations.end(); it++)
+		if ((from < it->second) && (it->first < to))
+			return true;
+	return false;
+}
+
+// FastForward interface: a Req arriving at t is granted on the pending clock
+// if it is not earlier (the pop has a lower priority than the Req), on the
+// free running clock or else on the clock restarted after it
+simtime_t SchedSync::getGrantTime(simtime_t t) const {
+	if (!isDisconnected && popMsg->isScheduled()) {
+		simtime_t clk = popMsg->getArrivalTime();
+		if (clk >= t)
+			return clk;
+		if (freeRunningClk) {
+			while (clk < t)
+				clk += tClk_s;
+			return clk;
+		}
+	}
+	return nextClockAfter(t);
+}
+
+// FastForward interface: the clocks may be reserved if not reserved yet
+// and is not stalled by a V/f transition
+bool SchedSync::canReserveLink(simtime_t from, simtime_t to) const {
+	if (isDisconnected || (from < stallUntil))
+		return false;
+	return !isLinkReserved(from, to);
+}
+
+void SchedSync::reserveLink(simtime_t from, simtime_t to) {
+	Enter_Method_Silent();
+	// drop the windows already passed
+	std::list< std::pair<simtime_t,simtime_t> >::iterator it = linkReservations.begin();
+	while (it != linkReservations.end()) {
+		if (it->second <= simTime())
+			it = linkReservations.erase(it);
+		else
+			it++;
+	}
+	linkReservations.push_back(std::make_pair(from, to));
+	EV << "-I- " << getFullPath() << " clocks reserved " << from << " .. " << to << endl;
+}
+
+// Energy model interface: every flit sent crossed the switch and the out link
+void SchedSync::addEnergyCounters(EnergyCounters &c) const {
+	c.xbarTraversals += numSends;
+	c.linkTraversals += numSends;
+	c.arbitrations += numArbitrations;
+	if (toCore)
+		c.deliveredFlits += numSends;
+}
+
 void SchedSync::finish() {
     if (!isDisconnected && (simTime() > statStartTime)) {
-        int numClks=(int) round((simTime().dbl()-statStartTime.dbl())/tClk_s);
+        simtime_t from = (lastClkChange > statStartTime) ? lastClkChange : statStartTime;
+        int numClks=(int) round(statClks + (simTime().dbl()-from.dbl())/tClk_s);
         linkUtilization.collect(100*(double) numSends/numClks);
         linkUtilization.record();
     }else{
@@ -408,6 +872,83 @@ void SchedSync::finish() {
 
 }
 
+void SchedSync::saveCheckpoint(CheckpointWriter &w) {
+	w.writeInt(numInPorts);
+	w.writeInt(numVCs);
+	for (int ip = 0; ip < numInPorts; ip++) {
+		for (int vc = 0; vc < numVCs; vc++) {
+			std::list<NoCReqMsg*> &reqs = ReqsByIPoVC[ip][vc];
+			w.writeInt(reqs.size());
+			for (std::list<NoCReqMsg*>::iterator it = reqs.begin(); it != reqs.end(); it++)
+				w.writeMsg(*it);
+		}
+	}
+	w.writeInt(numReqs);
+	w.writeInts(credits);
+	w.writeInts(vcUsage);
+	w.writeInts(vcMaxCredits);
+	w.writeInt(curVC);
+	w.writeInts(vcCurInPort);
+	for (int vc = 0; vc < numVCs; vc++)
+		w.writeMsg(vcCurReq[vc]);
+	w.writeInt(curWrrSL);
+	w.writeInt(wrrGrantsLeft);
+	w.writeTime(stallUntil);
+	w.writeInt(smartVC);
+	w.writeInt(linkReservations.size());
+	std::list< std::pair<simtime_t,simtime_t> >::iterator it;
+	for (it = linkReservations.begin(); it != linkReservations.end(); it++) {
+		w.writeTime(it->first);
+		w.writeTime(it->second);
+	}
+	w.writeMsg(isDisconnected ? NULL : popMsg);
+}
+
+void SchedSync::restoreCheckpoint(CheckpointReader &r) {
+	Enter_Method_Silent();
+	r.checkSize(r.readInt(), numInPorts, "in ports");
+	r.checkSize(r.readInt(), numVCs, "numVCs");
+	for (int ip = 0; ip < numInPorts; ip++) {
+		for (int vc = 0; vc < numVCs; vc++) {
+			std::list<NoCReqMsg*> &reqs = ReqsByIPoVC[ip][vc];
+			while (reqs.size()) {
+				delete reqs.front();
+				reqs.pop_front();
+			}
+			int n = r.readInt();
+			for (int i = 0; i < n; i++) {
+				NoCReqMsg *req = check_and_cast<NoCReqMsg*>(r.readMsg());
+				take(req);
+				reqs.push_back(req);
+			}
+		}
+	}
+	numReqs = r.readInt();
+	r.readInts(credits);
+	r.readInts(vcUsage);
+	r.readInts(vcMaxCredits);
+	curVC = r.readInt();
+	r.readInts(vcCurInPort);
+	// the current Reqs are on the lists read above
+	for (int vc = 0; vc < numVCs; vc++)
+		vcCurReq[vc] = check_and_cast_nullable<NoCReqMsg*>(r.readMsg());
+	curWrrSL = r.readInt();
+	wrrGrantsLeft = r.readInt();
+	stallUntil = r.readTime();
+	smartVC = r.readInt();
+	linkReservations.clear();
+	int numReservations = r.readInt();
+	for (int i = 0; i < numReservations; i++) {
+		simtime_t from = r.readTime();
+		linkReservations.push_back(std::make_pair(from, r.readTime()));
+	}
+	cMessage *pop = r.readMsg();
+	if (!isDisconnected) {
+		cancelAndDelete(popMsg);
+		popMsg = pop;
+		take(popMsg);
+	}
+}
 
 SchedSync::~SchedSync() {
 	// cleanup owned Req
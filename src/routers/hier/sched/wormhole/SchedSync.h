@@ -24,6 +24,7 @@ using namespace omnetpp;
 
 #include "NoCs_m.h"
 #include "routers/hier/HierRouter.h"
+#include "checkpoint/Checkpoint.h"
 
 //
 // Crossbar Scheduler
@@ -41,7 +42,40 @@ using namespace omnetpp;
 // NOTE: for every output port and VC there is a single packet that is granted by the
 // scheduler.
 //
-class SchedSync : public Sched
+// QoS: the VCs are partitioned between numSLs service levels (see slFirstVC in
+// HierRouter.h). SLs 0..numStrictSLs-1 are served by strict priority (lower SL
+// first) and the rest share the remaining grants by weighted round robin
+// using slWeights grants per turn.
+//
+// Switch allocation: if the router has a swAlloc submodule the scheduler does
+// not grant by itself. On its clock it asks the allocator for an allocation and
+// the allocator calls grantInPort for the InPort matched to this out port.
+// Only Reqs whose flits already wait in the InPort are offered, so no grant
+// is NAKed.
+//
+// Flow control: wormhole (default) grants a flit whenever there is a credit.
+// Virtual cut-through (VCT) and store and forward (SAF) grant the head flit
+// only when the downstream VC has room for the whole packet. SAF also waits
+// for the whole packet to be stored in the InPort. Both require the downstream
+// flitsPerVC to be at least the packet length.
+//
+// SMART: a packet latched through the router by the InPort is not requested.
+// Its flits are sent directly to the directIn gate of the next InPort on
+// arrival (smartSend), the out link traversal being counted in the clock the
+// flit arrived on. The packet must find the Sched idle - the out link did not
+// carry a flit in the last clock - and credits for all its flits. The Sched
+// then grants nothing else until its EoP passes.
+//
+// Express VCs: a Req of a packet latched through the router is granted on
+// arrival if the Sched is idle, and is served before any other Req.
+//
+// Fast-forward: the out link may be reserved for packets delivered directly
+// by the FastForward module. A packet head is not granted if its flits would
+// be sent during a reserved window.
+//
+enum { FC_WORMHOLE, FC_VCT, FC_SAF };
+
+class SchedSync : public Sched, public Checkpointable
 {
 private:
 	// parameters
@@ -51,6 +85,10 @@ private:
     bool freeRunningClk;      // 0 - try shutting down the clk
     bool heterogeneous; 		// arbitrating only when outport isn`t busy, when true use only with idealRouter mesh file and with the maximum frequency (of fastest link)
     simtime_t statStartTime; // in sec
+    int flowControl;          // FC_WORMHOLE, FC_VCT or FC_SAF
+    int numSLs;               // number of QoS service levels
+    int numStrictSLs;         // SLs 0..numStrictSLs-1 are strict priority
+    std::vector<int> slWeights; // WRR weight (grants per turn) of each SL
 
 	// Out link info
 	cDatarateChannel *chan;
@@ -62,11 +100,25 @@ private:
 	std::vector< std::vector< std::list<NoCReqMsg*> > > ReqsByIPoVC; // active requests by [ip][vc]
 	std::vector< int > credits; // credits per VC
 	std::vector< int > vcUsage; // count number of pending reqs per VC
+	std::vector< int > vcMaxCredits; // max credits seen per VC - the downstream buffer size
 
 	cMessage *popMsg; // this is the clock...
 	double tClk_s;    // clock cycle time
+	// DVFS
+	double nomTClk_s;      // the clock cycle time at scale 1
+	double nomDataRate;    // the out link datarate at scale 1
+	simtime_t stallUntil;  // no grants before (V/f transition)
+	double statClks;       // clocks since statStartTime up to lastClkChange
+	simtime_t lastClkChange;
 	bool isDisconnected; // if true means there is no InPort or Core on the other side
 	int numSends; // counts the number of flit sends through the egress link connected to the sched
+	long numGrants; // total grants - progress indication for the deadlock monitor
+	long numArbitrations; // grants made after statStartTime - for the energy model
+	double busyTime;  // total transmission time on the out link [sec]
+	std::list< std::pair<simtime_t,simtime_t> > linkReservations; // fast-forward grant clocks [from, to)
+	bool toCore;    // the out link drives a core (flits sent are delivered)
+	cGate *smartOut; // the directIn gate of the next InPort (NULL if none)
+	int smartVC;     // the out VC of the SMART packet passing through (-1 if none)
 	// arbitration-type
 	int arbiter_start_indx;
 
@@ -74,6 +126,12 @@ private:
 	int curVC; // last VC sent
 	std::vector<int> vcCurInPort;  // last port sending on this VC
 	std::vector<NoCReqMsg*> vcCurReq; // the current Req (last one arbitrated on a vc)
+	int curWrrSL;      // the WRR SL currently served
+	int wrrGrantsLeft; // grants left for curWrrSL before moving to the next SL
+	SwAlloc *swAlloc;  // the router switch allocator (NULL if the Sched arbitrates alone)
+	std::vector<InPort*> inPorts; // InPort per ctrl gate (NULL if not an InPort)
+	PowerCtrl *powerCtrl;     // this router power controller (NULL if none)
+	PowerCtrl *downPowerCtrl; // power controller of the router on the out link
 
 	// Statistics
 	cStdDev linkUtilization; // the egress link utiliztion connected to the sched
@@ -84,7 +142,14 @@ private:
 	void handleAckMsg(NoCAckMsg *msg);
 	void handlePopMsg();
 	void handleCreditMsg(NoCCreditMsg *msg);
-	void arbitrate();
+	bool canStartPkt(int ip, int vc, NoCReqMsg *req);
+	bool isGrantable(int ip, int vc);
+	bool isLinkReserved(simtime_t from, simtime_t to) const;
+	simtime_t nextClockAfter(simtime_t t) const;
+	bool findReqOnSL(int sl, int onlyInPort, int &nextInPort, int &nextVC);
+	bool findBypassReq(int onlyInPort, int &nextInPort, int &nextVC);
+	int selectReq(int onlyInPort, int &nextInPort, int &nextVC);
+	void arbitrate(int onlyInPort = -1);
 
 protected:
     virtual void initialize();
@@ -94,6 +159,22 @@ public:
     const std::vector<int> *getCredits() const {return &credits;};
     const std::vector<int> *getVCUsage() const {return &vcUsage;};
     virtual void incrVCUsage(int vc) { vcUsage[vc]++ ; } ;
+    virtual bool canGrantInPort(int ip);
+    virtual void grantInPort(int ip);
+    virtual bool isIdle() const;
+    virtual bool canSmartSend(int vc, int numFlits) const;
+    virtual void smartSend(NoCFlitMsg *flit);
+    virtual void getBlockedReqs(std::vector<BlockedReq> &reqs) const;
+    virtual long getNumGrants() const { return numGrants; };
+    virtual void addEnergyCounters(EnergyCounters &c) const;
+    virtual void setClockScale(double scale, simtime_t stall);
+    virtual double getBusyTime() const { return busyTime; };
+    virtual bool canReserveLink(simtime_t from, simtime_t to) const;
+    virtual void reserveLink(simtime_t from, simtime_t to);
+    virtual simtime_t getGrantTime(simtime_t t) const;
+    virtual simtime_t getClockPeriod() const { return isDisconnected ? SIMTIME_ZERO : tClk_s; };
+    virtual void saveCheckpoint(CheckpointWriter &w);
+    virtual void restoreCheckpoint(CheckpointReader &r);
     virtual ~SchedSync();
 };
 
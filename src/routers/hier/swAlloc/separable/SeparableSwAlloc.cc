@@ -0,0 +1,191 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+
+#include "SeparableSwAlloc.h"
+
+Define_Module(SeparableSwAlloc);
+
+void SeparableSwAlloc::initialize()
+{
+	numPorts = par("numPorts");
+	iterations = par("iterations");
+	statStartTime = par("statStartTime");
+	const char *algorithm = par("algorithm");
+	if (!strcmp(algorithm, "islip")) {
+		isISLIP = true;
+	} else if (!strcmp(algorithm, "input-first")) {
+		isISLIP = false;
+	} else {
+		throw cRuntimeError("-E- %s unknown algorithm: %s",
+				getFullPath().c_str(), algorithm);
+	}
+	if (iterations < 1) {
+		throw cRuntimeError("-E- %s iterations must be >= 1 (got %d)",
+				getFullPath().c_str(), iterations);
+	}
+
+	// the Scheds may register before we get initialized
+	scheds.resize(numPorts, NULL);
+	requested.resize(numPorts, false);
+	grantPtr.resize(numPorts, 0);
+	acceptPtr.resize(numPorts, 0);
+
+	allocMsg = new cMessage("alloc");
+	allocMsg->setKind(NOC_CLK_MSG);
+	// after all the Sched clocks (priority 5) of the same time
+	allocMsg->setSchedulingPriority(6);
+
+	matchedPerAlloc.setName("sw-alloc-matched-pairs");
+	matchEfficiency.setName("sw-alloc-match-efficiency");
+}
+
+void SeparableSwAlloc::registerSched(int outPort, Sched *sched)
+{
+	if ((int)scheds.size() <= outPort) {
+		scheds.resize(outPort + 1, NULL);
+		requested.resize(outPort + 1, false);
+	}
+	scheds[outPort] = sched;
+}
+
+void SeparableSwAlloc::requestAllocation(int outPort)
+{
+	Enter_Method_Silent();
+	requested[outPort] = true;
+	if (!allocMsg->isScheduled())
+		scheduleAt(simTime(), allocMsg);
+}
+
+void SeparableSwAlloc::allocate()
+{
+	// the request matrix
+	std::vector< std::vector<bool> > req(numPorts, std::vector<bool>(numPorts, false));
+	int numReqOutPorts = 0;
+	for (int o = 0; o < numPorts; o++) {
+		if (!requested[o] || !scheds[o]) continue;
+		requested[o] = false;
+		bool any = false;
+		for (int i = 0; i < numPorts; i++) {
+			if (i == o) continue;
+			req[i][o] = scheds[o]->canGrantInPort(swIdx(i, o));
+			any |= req[i][o];
+		}
+		if (any) numReqOutPorts++;
+	}
+
+	std::vector<int> inMatch(numPorts, -1);  // out port matched to each in port
+	std::vector<int> outMatch(numPorts, -1); // in port matched to each out port
+	int numMatched = 0;
+	for (int it = 0; it < iterations; it++) {
+		int newMatches = 0;
+		if (isISLIP) {
+			// grant: each free output selects a free requesting input
+			std::vector<int> gnt(numPorts, -1);
+			for (int o = 0; o < numPorts; o++) {
+				if (outMatch[o] >= 0) continue;
+				for (int k = 0; k < numPorts; k++) {
+					int i = (grantPtr[o] + k) % numPorts;
+					if ((inMatch[i] < 0) && req[i][o]) {
+						gnt[o] = i;
+						break;
+					}
+				}
+			}
+			// accept: each free input accepts one of its grants
+			for (int i = 0; i < numPorts; i++) {
+				if (inMatch[i] >= 0) continue;
+				for (int k = 0; k < numPorts; k++) {
+					int o = (acceptPtr[i] + k) % numPorts;
+					if (gnt[o] == i) {
+						inMatch[i] = o;
+						outMatch[o] = i;
+						newMatches++;
+						// iSLIP moves the pointers only on first iteration matches
+						if (it == 0) {
+							grantPtr[o] = (i + 1) % numPorts;
+							acceptPtr[i] = (o + 1) % numPorts;
+						}
+						break;
+					}
+				}
+			}
+		} else {
+			// input first: each free input selects a free requested output
+			std::vector<int> sel(numPorts, -1);
+			for (int i = 0; i < numPorts; i++) {
+				if (inMatch[i] >= 0) continue;
+				for (int k = 0; k < numPorts; k++) {
+					int o = (acceptPtr[i] + k) % numPorts;
+					if ((outMatch[o] < 0) && req[i][o]) {
+						sel[i] = o;
+						break;
+					}
+				}
+			}
+			// then each output selects one of the inputs selecting it
+			for (int o = 0; o < numPorts; o++) {
+				if (outMatch[o] >= 0) continue;
+				for (int k = 0; k < numPorts; k++) {
+					int i = (grantPtr[o] + k) % numPorts;
+					if (sel[i] == o) {
+						inMatch[i] = o;
+						outMatch[o] = i;
+						newMatches++;
+						grantPtr[o] = (i + 1) % numPorts;
+						acceptPtr[i] = (o + 1) % numPorts;
+						break;
+					}
+				}
+			}
+		}
+		numMatched += newMatches;
+		if (!newMatches) break;
+	}
+
+	// provide the grants
+	for (int o = 0; o < numPorts; o++) {
+		if (outMatch[o] < 0) continue;
+		EV << "-I- " << getFullPath() << " matched InPort:" << outMatch[o]
+		   << " to OutPort:" << o << endl;
+		scheds[o]->grantInPort(swIdx(outMatch[o], o));
+	}
+
+	if ((simTime() > statStartTime) && numReqOutPorts) {
+		matchedPerAlloc.collect(numMatched);
+		matchEfficiency.collect(1.0 * numMatched / numReqOutPorts);
+	}
+}
+
+void SeparableSwAlloc::handleMessage(cMessage *msg)
+{
+	if (msg == allocMsg) {
+		allocate();
+	} else {
+		throw cRuntimeError("Does not know how to handle message of type %d", msg->getKind());
+		delete msg;
+	}
+}
+
+void SeparableSwAlloc::finish()
+{
+	matchedPerAlloc.record();
+	matchEfficiency.record();
+}
+
+SeparableSwAlloc::~SeparableSwAlloc()
+{
+	if (allocMsg)
+		cancelAndDelete(allocMsg);
+}
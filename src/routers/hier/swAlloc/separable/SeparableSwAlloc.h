@@ -0,0 +1,77 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+
+#ifndef __HNOCS_SEPARABLE_SW_ALLOC_H_
+#define __HNOCS_SEPARABLE_SW_ALLOC_H_
+
+#include <omnetpp.h>
+using namespace omnetpp;
+
+#include "NoCs_m.h"
+#include "routers/hier/HierRouter.h"
+
+//
+// Router level switch allocator
+//
+// Each out port Sched that has Reqs calls requestAllocation on its clock
+// (priority 5). The allocation is then done by a self message at the same
+// time with priority 6, after all the Scheds of the router have asked for it.
+//
+// The request matrix is built by asking each requesting Sched which InPorts
+// can be granted right now (Sched::canGrantInPort). A maximal matching is
+// looked for using the configured number of iterations and each matched Sched
+// is told to grant its InPort (Sched::grantInPort). So each InPort receives at
+// most one grant per clock and no grant is wasted.
+//
+// Ports are the router port indexes. A Sched of port o reaches the InPort
+// of port i through its ctrl[i] gate if i < o or ctrl[i-1] if i > o.
+//
+class SeparableSwAlloc : public SwAlloc
+{
+private:
+	// parameters
+	int numPorts;
+	bool isISLIP;   // else separable input first
+	int iterations; // matching iterations per allocation
+	simtime_t statStartTime;
+
+	// state
+	std::vector<Sched*> scheds;    // Sched of each out port (NULL if none)
+	std::vector<bool> requested;   // out port requested allocation on this clock
+	std::vector<int> grantPtr;     // per out port round robin pointer over inputs
+	std::vector<int> acceptPtr;    // per in port round robin pointer over outputs
+	cMessage *allocMsg;            // the allocation event
+
+	// statistics
+	cStdDev matchedPerAlloc;       // number of matched in/out pairs per allocation
+	cStdDev matchEfficiency;       // matched / requesting outputs per allocation
+
+	// methods
+	int swIdx(int inPort, int outPort) { return (inPort < outPort) ? inPort : inPort - 1; };
+	void allocate();
+
+protected:
+	virtual void initialize();
+	virtual void handleMessage(cMessage *msg);
+	virtual void finish();
+
+public:
+	virtual void registerSched(int outPort, Sched *sched);
+	virtual void requestAllocation(int outPort);
+	SeparableSwAlloc() { allocMsg = NULL; };
+	virtual ~SeparableSwAlloc();
+};
+
+#endif
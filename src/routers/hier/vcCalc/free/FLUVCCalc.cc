@@ -34,6 +34,11 @@ FLUVCCalc::getSchedOnPort(int op) {
 void FLUVCCalc::initialize()
 {
 	schedType = par("schedType");
+	numSLs = par("numSLs");
+	if (numSLs < 1) {
+		throw cRuntimeError("-E- %s numSLs must be >= 1 (got %d)",
+				getFullPath().c_str(), numSLs);
+	}
     // get pointer to the Sched Credits on each out port
 	for (int i=0; i< getParentModule()->gateSize("sw_in"); i++) {
 		const Sched *sched = getSchedOnPort(i);
@@ -47,7 +52,58 @@ void FLUVCCalc::initialize()
 			opVCUsage.push_back(NULL);
 		}
 	}
-	lastSrc = lastDst = -1;
+	lastSrc = lastDst = lastSL = lastOVC = -1;
+
+	numExpressVCs = par("numExpressVCs");
+	expressLen = par("expressLen");
+	if (numExpressVCs && ((numSLs > 1) || (expressLen < 2))) {
+		throw cRuntimeError("-E- %s express VCs require numSLs == 1 and expressLen >= 2",
+				getFullPath().c_str());
+	}
+	opCalc = dynamic_cast<OPCalc*>(getParentModule()->getSubmodule("opCalc"));
+	if (numExpressVCs && !opCalc) {
+		throw cRuntimeError("-E- %s express VCs require an OPCalc", getFullPath().c_str());
+	}
+	numExpressAllocs = numExpressLatched = 0;
+}
+
+// Express VC allocation. Return true if the packet got an EVC in oVC
+bool FLUVCCalc::allocExpressVC(NoCFlitMsg *msg, int op, int &oVC)
+{
+	int numVCs = opCredits[op]->size();
+	int firstEVC = numVCs - numExpressVCs;
+
+	// an intermediate router of the express segment - latch through
+	if (msg->getExpressHops() > 0) {
+		oVC = msg->getVC();
+		if (oVC < firstEVC) {
+			throw cRuntimeError("-E- %s express packet 0x%x arrived on normal VC %d",
+					getFullPath().c_str(), msg->getPktId(), oVC);
+		}
+		msg->setExpressHops(msg->getExpressHops() - 1);
+		numExpressLatched++;
+		return true;
+	}
+
+	// start an express segment only if it is used all the way
+	if (opCalc->getStraightHops(msg, op) < expressLen)
+		return false;
+
+	int maxCreds = 0;
+	oVC = -1;
+	for (int vc = firstEVC; vc < numVCs; vc++) {
+		int credits = (*opCredits[op])[vc];
+		if ((credits >= msg->getFlits()) && (credits > maxCreds)
+				&& !(*opVCUsage[op])[vc]) {
+			oVC = vc;
+			maxCreds = credits;
+		}
+	}
+	if (oVC < 0)
+		return false;
+	msg->setExpressHops(expressLen - 1);
+	numExpressAllocs++;
+	return true;
 }
 
 // based on the available credits on the msg outPort
@@ -67,18 +123,37 @@ void FLUVCCalc::handlePacketMsg(NoCFlitMsg *msg)
 		throw cRuntimeError("No Credits Vec for Port:%d", op);
 	}
 
-	// if the source and destination matches the last decision
-	// we have a back to back packets of same flow - use same VC
-	if ((lastSrc == msg->getSrcId()) && (lastDst == msg->getDstId()) ) {
+	// the VCs available to the packet SL
+	int numVCs = opCredits[op]->size();
+	int sl = msg->getSL();
+	if ((sl < 0) || (sl >= numSLs) || (numSLs > numVCs)) {
+		throw cRuntimeError("-E- %s packet SL %d is out of range (numSLs:%d numVCs:%d)",
+				getFullPath().c_str(), sl, numSLs, numVCs);
+	}
+	int firstVC = slFirstVC(sl, numSLs, numVCs);
+	int lastVC = slFirstVC(sl + 1, numSLs, numVCs) - 1 - numExpressVCs;
+	if (lastVC < firstVC) {
+		throw cRuntimeError("-E- %s no normal VC left with %d express VCs out of %d",
+				getFullPath().c_str(), numExpressVCs, numVCs);
+	}
+
+	// express VCs are allocated first - but not to multicast packets
+	if (numExpressVCs && !msg->getDstMaskArraySize() && allocExpressVC(msg, op, oVC)) {
+		EV << "-I- " << getFullPath() << " packet 0x" << std::hex << msg->getPktId()
+		   << std::dec << " on express VC:" << oVC << " routers to latch through:"
+		   << msg->getExpressHops() << endl;
+	} else if ((lastSrc == msg->getSrcId()) && (lastDst == msg->getDstId()) && (lastSL == sl)) {
+		// if the source and destination matches the last decision
+		// we have a back to back packets of same flow - use same VC
 		oVC = lastOVC;
 	} else {
 
 		int maxCreds = 0;
-		int maxCredsVc = 0;
+		int maxCredsVc = firstVC;
 		int minUsage = 10000;
 
-		// look through all VCs on the out port the one with max credits and usage
-		for (unsigned int vc = 0; vc < opCredits[op]->size(); vc++) {
+		// look through the SL VCs on the out port the one with max credits and usage
+		for (int vc = firstVC; vc <= lastVC; vc++) {
 			int credits = (*opCredits[op])[vc];
 			int usage = (*opVCUsage[op])[vc];
 
@@ -91,6 +166,7 @@ void FLUVCCalc::handlePacketMsg(NoCFlitMsg *msg)
 		oVC = maxCredsVc;
         lastSrc = msg->getSrcId();
         lastDst = msg->getDstId();
+        lastSL = sl;
     	lastOVC = oVC;
 	}
 	Sched *sched = getSchedOnPort(op);
@@ -109,3 +185,28 @@ void FLUVCCalc::handleMessage(cMessage *msg)
     	delete msg;
     }
 }
+
+void FLUVCCalc::finish()
+{
+	if (numExpressVCs) {
+		recordScalar("express-vc-allocations", numExpressAllocs);
+		recordScalar("express-vc-latched-packets", numExpressLatched);
+	}
+}
+
+void FLUVCCalc::saveCheckpoint(CheckpointWriter &w)
+{
+	w.writeInt(lastSrc);
+	w.writeInt(lastDst);
+	w.writeInt(lastSL);
+	w.writeInt(lastOVC);
+}
+
+void FLUVCCalc::restoreCheckpoint(CheckpointReader &r)
+{
+	Enter_Method_Silent();
+	lastSrc = r.readInt();
+	lastDst = r.readInt();
+	lastSL = r.readInt();
+	lastOVC = r.readInt();
+}
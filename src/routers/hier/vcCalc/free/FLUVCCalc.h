@@ -24,6 +24,7 @@ using namespace omnetpp;
 #include "NoCs_m.h"
 #include "routers/hier/HierRouter.h"
 #include "routers/hier/FlitMsgCtrl.h"
+#include "checkpoint/Checkpoint.h"
 
 //
 // The VC Calculation Class provides the means to modify the VC of the FLIT
@@ -38,24 +39,47 @@ using namespace omnetpp;
 // The basic implementation provided here is simply examining the output port
 // database of used VCs (that is what VC are used by packets that are in flight)
 //
-class FLUVCCalc : public cSimpleModule
+// QoS: when numSLs > 1 only the VCs of the packet SL are considered (see
+// slFirstVC in HierRouter.h) so traffic of different SLs never shares a VC.
+//
+// Express VCs: the last numExpressVCs VCs of each port are EVCs. A packet
+// that keeps its direction for at least expressLen hops is given an EVC if
+// the EVC buffer can take the whole packet (standing in for the end to end
+// EVC credit check). On the next expressLen-1 routers the packet keeps the
+// same EVC and is latched through: the InPort skips the pipeline delays and
+// the Sched gives it priority. Normal packets never use the EVCs.
+//
+class FLUVCCalc : public cSimpleModule, public Checkpointable
 {
 private:
 	// params
 	const char* schedType;
+	int numSLs;
+	int numExpressVCs;
+	int expressLen;
 
 	// state
 	std::vector< const std::vector<int> * > opCredits;
 	std::vector< const std::vector<int> * > opVCUsage;
-	int lastSrc, lastDst, lastOVC;
+	int lastSrc, lastDst, lastSL, lastOVC;
+	OPCalc *opCalc; // the routing of this port - how far the packet goes straight
+
+	// statistics
+	int numExpressAllocs;  // packets starting an express segment here
+	int numExpressLatched; // packets latched through on an EVC
 
 	// methods
 	class Sched *getSchedOnPort(int op);
 	void handlePacketMsg(NoCFlitMsg *msg);
+	bool allocExpressVC(NoCFlitMsg *msg, int op, int &oVC);
 
   protected:
     virtual void initialize();
     virtual void handleMessage(cMessage *msg);
+    virtual void finish();
+  public:
+    virtual void saveCheckpoint(CheckpointWriter &w);
+    virtual void restoreCheckpoint(CheckpointReader &r);
 };
 
 #endif
@@ -0,0 +1,90 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#ifndef __HNOCS_OCCUPANCY_STAT_H_
+#define __HNOCS_OCCUPANCY_STAT_H_
+
+#include <omnetpp.h>
+using namespace omnetpp;
+
+//
+// Time weighted occupancy of a queue
+//
+// On every change of the queue length the time spent at the previous length
+// is collected as the weight of that length, so the mean, max and histogram
+// are over time and not over events (Little's law consistent). Each change
+// costs O(1). Only the time from statStartTime is collected, but the
+// occupancy integral (getArea) is kept from time 0 for windowed users.
+//
+// The histogram is of length * scale (e.g. 1/capacity for a fill fraction).
+// The statistic is recorded by record(), called from the owner finish().
+//
+class OccupancyStat
+{
+private:
+	cHistogram hist;
+	int len;
+	double scale;
+	simtime_t lastChange;
+	simtime_t statStartTime;
+	double area; // [length * sec] from time 0 to lastChange
+
+	void accumulate() {
+		simtime_t now = simTime();
+		area += len * (now - lastChange).dbl();
+		simtime_t from = (lastChange > statStartTime) ? lastChange : statStartTime;
+		if (now > from)
+			hist.collectWeighted(len * scale, (now - from).dbl());
+		lastChange = now;
+	}
+
+public:
+	OccupancyStat() : len(0), scale(1.0), area(0) { };
+
+	void init(const char *name, simtime_t startTime, double valueScale = 1.0) {
+		hist.setName(name);
+		if (valueScale == 1.0) {
+			hist.setMode(cHistogram::MODE_INTEGERS);
+			hist.setBinSizeHint(1.0);
+			hist.setRange(0, NAN);
+		}
+		scale = valueScale;
+		statStartTime = startTime;
+		lastChange = simTime();
+		len = 0;
+		area = 0;
+	};
+
+	void set(int newLen) {
+		if (newLen == len)
+			return;
+		accumulate();
+		len = newLen;
+	};
+
+	int getLength() const { return len; };
+
+	// the occupancy integral from time 0 to now
+	double getArea() const {
+		return area + len * (simTime() - lastChange).dbl();
+	};
+
+	void record() {
+		accumulate();
+		hist.record();
+	};
+};
+
+#endif
@@ -0,0 +1,424 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#include "TopologyBuilder.h"
+#include <deque>
+#include <fstream>
+#include <sstream>
+
+Define_Module(TopologyBuilder);
+
+void TopologyBuilder::initialize()
+{
+	defaultDatarate = par("linkDatarate");
+	defaultDelay = par("linkDelay");
+	rootRouter = par("rootRouter");
+
+	parseFile(par("topologyFile"));
+	computeRoutes();
+
+	// build the network in event 1, because it is undefined whether the simkernel
+	// will implicitly initialize modules created *during* initialization
+	cMessage *buildMsg = new cMessage("build");
+	scheduleAt(simTime(), buildMsg);
+}
+
+void TopologyBuilder::handleMessage(cMessage *msg)
+{
+	if (!msg->isSelfMessage()) {
+		throw cRuntimeError("Does not know how to handle message of type %d", msg->getKind());
+	}
+	delete msg;
+	buildNetwork();
+}
+
+// parse a number with an optional unit. Rates are returned in bps and
+// delays in seconds
+double TopologyBuilder::parseQuantity(const char *str, const char *fileName,
+		int lineNum, bool isRate)
+{
+	char *end;
+	double val = strtod(str, &end);
+	if (end == str) {
+		throw cRuntimeError("-E- %s:%d bad number: %s", fileName, lineNum, str);
+	}
+	std::string unit(end);
+	double mult;
+	if (isRate) {
+		if (unit == "" || unit == "bps") mult = 1;
+		else if (unit == "Kbps") mult = 1e3;
+		else if (unit == "Mbps") mult = 1e6;
+		else if (unit == "Gbps") mult = 1e9;
+		else if (unit == "Tbps") mult = 1e12;
+		else throw cRuntimeError("-E- %s:%d unknown datarate unit: %s",
+				fileName, lineNum, unit.c_str());
+	} else {
+		if (unit == "" || unit == "s") mult = 1;
+		else if (unit == "ms") mult = 1e-3;
+		else if (unit == "us") mult = 1e-6;
+		else if (unit == "ns") mult = 1e-9;
+		else if (unit == "ps") mult = 1e-12;
+		else throw cRuntimeError("-E- %s:%d unknown delay unit: %s",
+				fileName, lineNum, unit.c_str());
+	}
+	return val * mult;
+}
+
+void TopologyBuilder::parseFile(const char *fileName)
+{
+	std::ifstream in(fileName);
+	if (!in) {
+		throw cRuntimeError("-E- %s can not open topology file: %s",
+				getFullPath().c_str(), fileName);
+	}
+
+	numRouters = -1;
+	maxCoreId = -1;
+	int lineNum = 0;
+	std::string line;
+	while (std::getline(in, line)) {
+		lineNum++;
+		size_t hash = line.find('#');
+		if (hash != std::string::npos)
+			line.erase(hash);
+		std::istringstream ss(line);
+		std::string cmd;
+		if (!(ss >> cmd))
+			continue;
+
+		if (cmd == "routers") {
+			if (numRouters >= 0) {
+				throw cRuntimeError("-E- %s:%d routers defined twice", fileName, lineNum);
+			}
+			if (!(ss >> numRouters) || (numRouters <= 0)) {
+				throw cRuntimeError("-E- %s:%d bad number of routers", fileName, lineNum);
+			}
+			numPortsOfRouter.resize(numRouters, 0);
+			portPeer.resize(numRouters);
+		} else if (numRouters < 0) {
+			throw cRuntimeError("-E- %s:%d the routers statement must come first",
+					fileName, lineNum);
+		} else if (cmd == "core") {
+			int coreId, r;
+			if (!(ss >> coreId >> r) || (coreId < 0) || (r < 0) || (r >= numRouters)) {
+				throw cRuntimeError("-E- %s:%d bad core statement", fileName, lineNum);
+			}
+			if (coreRouter.count(coreId)) {
+				throw cRuntimeError("-E- %s:%d core %d defined twice", fileName, lineNum, coreId);
+			}
+			coreRouter[coreId] = r;
+			corePort[coreId] = numPortsOfRouter[r]++;
+			portPeer[r].push_back(-1);
+			if (coreId > maxCoreId)
+				maxCoreId = coreId;
+		} else if (cmd == "link") {
+			LinkDesc l;
+			if (!(ss >> l.rA >> l.rB) || (l.rA < 0) || (l.rA >= numRouters) ||
+					(l.rB < 0) || (l.rB >= numRouters) || (l.rA == l.rB)) {
+				throw cRuntimeError("-E- %s:%d bad link statement", fileName, lineNum);
+			}
+			l.datarate = defaultDatarate;
+			l.delay = defaultDelay;
+			bool isDown = false;
+			std::string tok;
+			int numVals = 0;
+			while (ss >> tok) {
+				if (tok == "down") {
+					isDown = true;
+				} else if (numVals == 0) {
+					if (tok != "-")
+						l.datarate = parseQuantity(tok.c_str(), fileName, lineNum, true);
+					numVals++;
+				} else if (numVals == 1) {
+					if (tok != "-")
+						l.delay = parseQuantity(tok.c_str(), fileName, lineNum, false);
+					numVals++;
+				} else {
+					throw cRuntimeError("-E- %s:%d unexpected token: %s",
+							fileName, lineNum, tok.c_str());
+				}
+			}
+			if (isDown) {
+				EV << "-I- " << getFullPath() << " skipping down link "
+				   << l.rA << " - " << l.rB << endl;
+				continue;
+			}
+			links.push_back(l);
+			numPortsOfRouter[l.rA]++;
+			portPeer[l.rA].push_back(l.rB);
+			numPortsOfRouter[l.rB]++;
+			portPeer[l.rB].push_back(l.rA);
+		} else {
+			throw cRuntimeError("-E- %s:%d unknown statement: %s",
+					fileName, lineNum, cmd.c_str());
+		}
+	}
+
+	if (numRouters < 0) {
+		throw cRuntimeError("-E- %s has no routers statement", fileName);
+	}
+	if (rootRouter < 0 || rootRouter >= numRouters) {
+		throw cRuntimeError("-E- rootRouter %d is out of range", rootRouter);
+	}
+	EV << "-I- " << getFullPath() << " parsed " << numRouters << " routers "
+	   << coreRouter.size() << " cores and " << links.size() << " links from "
+	   << fileName << endl;
+}
+
+// a hop is up if it goes towards the root of the BFS tree
+bool TopologyBuilder::isUpHop(int from, int to) const
+{
+	if (level[to] != level[from])
+		return (level[to] < level[from]);
+	return (to < from);
+}
+
+void TopologyBuilder::computeRoutes()
+{
+	const int INF = 1 << 30;
+
+	// BFS levels from the root
+	level.assign(numRouters, INF);
+	std::deque<int> bfs;
+	level[rootRouter] = 0;
+	bfs.push_back(rootRouter);
+	while (!bfs.empty()) {
+		int u = bfs.front();
+		bfs.pop_front();
+		for (unsigned int p = 0; p < portPeer[u].size(); p++) {
+			int v = portPeer[u][p];
+			if ((v >= 0) && (level[v] == INF)) {
+				level[v] = level[u] + 1;
+				bfs.push_back(v);
+			}
+		}
+	}
+	for (int r = 0; r < numRouters; r++) {
+		if (level[r] == INF) {
+			EV << "-W- " << getFullPath() << " router " << r
+			   << " is disconnected from root router " << rootRouter << endl;
+		}
+	}
+
+	// the direction of the hop that enters a router through each port
+	portArrivesDown.resize(numRouters);
+	for (int u = 0; u < numRouters; u++) {
+		portArrivesDown[u].resize(portPeer[u].size(), false);
+		for (unsigned int p = 0; p < portPeer[u].size(); p++) {
+			int v = portPeer[u][p];
+			if ((v >= 0) && (level[v] != INF) && (level[u] != INF))
+				portArrivesDown[u][p] = !isUpHop(v, u);
+		}
+	}
+
+	// per destination core: reverse BFS over the (router, wentDown) states
+	nextPort.resize(numRouters);
+	for (int u = 0; u < numRouters; u++) {
+		nextPort[u].resize(2);
+		nextPort[u][0].resize(maxCoreId + 1, -1);
+		nextPort[u][1].resize(maxCoreId + 1, -1);
+	}
+
+	std::vector< std::vector<int> > dist(numRouters, std::vector<int>(2));
+	for (std::map<int, int>::iterator cI = coreRouter.begin(); cI != coreRouter.end(); cI++) {
+		int coreId = cI->first;
+		int d = cI->second;
+		for (int u = 0; u < numRouters; u++)
+			dist[u][0] = dist[u][1] = INF;
+		dist[d][0] = dist[d][1] = 0;
+		std::deque< std::pair<int, int> > q;
+		q.push_back(std::make_pair(d, 0));
+		q.push_back(std::make_pair(d, 1));
+		while (!q.empty()) {
+			int v = q.front().first;
+			int wentDown = q.front().second;
+			q.pop_front();
+			for (unsigned int p = 0; p < portPeer[v].size(); p++) {
+				int u = portPeer[v][p];
+				if ((u < 0) || (level[u] == INF) || (level[v] == INF)) continue;
+				if (isUpHop(u, v)) {
+					// (u,0) -up-> (v,0)
+					if (!wentDown && (dist[u][0] == INF)) {
+						dist[u][0] = dist[v][0] + 1;
+						q.push_back(std::make_pair(u, 0));
+					}
+				} else if (wentDown) {
+					// (u,0) -down-> (v,1) and (u,1) -down-> (v,1)
+					for (int ph = 0; ph < 2; ph++) {
+						if (dist[u][ph] == INF) {
+							dist[u][ph] = dist[v][1] + 1;
+							q.push_back(std::make_pair(u, ph));
+						}
+					}
+				}
+			}
+		}
+
+		// select the next hop port - spreading equal cost routes by the core id
+		for (int u = 0; u < numRouters; u++) {
+			for (int ph = 0; ph < 2; ph++) {
+				if (u == d) {
+					nextPort[u][ph][coreId] = corePort[coreId];
+					continue;
+				}
+				int best = INF;
+				std::vector<int> bestPorts;
+				for (unsigned int p = 0; p < portPeer[u].size(); p++) {
+					int v = portPeer[u][p];
+					if ((v < 0) || (level[v] == INF) || (level[u] == INF)) continue;
+					int c;
+					if (isUpHop(u, v)) {
+						if (ph) continue;
+						c = dist[v][0];
+					} else {
+						c = dist[v][1];
+					}
+					if (c < best) {
+						best = c;
+						bestPorts.clear();
+					}
+					if ((c == best) && (c != INF))
+						bestPorts.push_back(p);
+				}
+				if (bestPorts.size())
+					nextPort[u][ph][coreId] = bestPorts[coreId % bestPorts.size()];
+			}
+		}
+	}
+}
+
+int TopologyBuilder::getNextPort(int routerId, int inPort, int dstId) const
+{
+	if ((routerId < 0) || (routerId >= numRouters) || (dstId < 0) || (dstId > maxCoreId))
+		return -1;
+	int wentDown = 0;
+	if ((inPort >= 0) && (inPort < (int)portArrivesDown[routerId].size()))
+		wentDown = portArrivesDown[routerId][inPort] ? 1 : 0;
+	return nextPort[routerId][wentDown][dstId];
+}
+
+// the first port after the given one that connects to another router
+int TopologyBuilder::nextRouterPort(int routerId, int port) const
+{
+	port++;
+	while ((port < (int)portPeer[routerId].size()) && (portPeer[routerId][port] < 0))
+		port++;
+	return port;
+}
+
+void TopologyBuilder::buildNetwork()
+{
+	cModule *parent = getParentModule();
+	cModuleType *routerType = cModuleType::get(parent->par("routerType").stringValue());
+	cModuleType *coreType = cModuleType::get(parent->par("coreType").stringValue());
+
+	// create the routers
+	std::vector<cModule *> routers(numRouters);
+#if OMNETPP_VERSION >= 0x0600
+	parent->addSubmoduleVector("router", numRouters);
+#endif
+	for (int r = 0; r < numRouters; r++) {
+#if OMNETPP_VERSION >= 0x0600
+		cModule *mod = routerType->create("router", parent, r);
+#else
+		cModule *mod = routerType->create("router", parent, numRouters, r);
+#endif
+		mod->par("numPorts") = numPortsOfRouter[r];
+		mod->par("id") = r;
+		mod->finalizeParameters();
+		mod->setGateSize("in", numPortsOfRouter[r]);
+		mod->setGateSize("out", numPortsOfRouter[r]);
+		mod->buildInside();
+		routers[r] = mod;
+	}
+
+	// create the cores
+	int numCores = coreRouter.size();
+	std::vector<cModule *> cores;
+#if OMNETPP_VERSION >= 0x0600
+	parent->addSubmoduleVector("core", maxCoreId + 1);
+#endif
+	for (std::map<int, int>::iterator cI = coreRouter.begin(); cI != coreRouter.end(); cI++) {
+#if OMNETPP_VERSION >= 0x0600
+		cModule *mod = coreType->create("core", parent, cI->first);
+#else
+		cModule *mod = coreType->create("core", parent, maxCoreId + 1, cI->first);
+#endif
+		mod->par("id") = cI->first;
+		mod->finalizeParameters();
+		mod->buildInside();
+		cores.push_back(mod);
+
+		// connect the core like the Mesh does: router.in <--> core.out and router.out <--> core.in
+		cModule *router = routers[cI->second];
+		int p = corePort[cI->first];
+		cDatarateChannel *ch;
+		ch = cDatarateChannel::create("channel");
+		ch->setDatarate(defaultDatarate);
+		ch->setDelay(defaultDelay);
+		router->gate("in$o", p)->connectTo(mod->gate("out$i"), ch);
+		ch = cDatarateChannel::create("channel");
+		ch->setDatarate(defaultDatarate);
+		ch->setDelay(defaultDelay);
+		mod->gate("out$o")->connectTo(router->gate("in$i", p), ch);
+		ch = cDatarateChannel::create("channel");
+		ch->setDatarate(defaultDatarate);
+		ch->setDelay(defaultDelay);
+		router->gate("out$o", p)->connectTo(mod->gate("in$i"), ch);
+		ch = cDatarateChannel::create("channel");
+		ch->setDatarate(defaultDatarate);
+		ch->setDelay(defaultDelay);
+		mod->gate("in$o")->connectTo(router->gate("out$i", p), ch);
+	}
+
+	// connect the router links - ports are allocated in file order after the cores
+	std::vector<int> nextFreePort(numRouters);
+	for (int r = 0; r < numRouters; r++)
+		nextFreePort[r] = nextRouterPort(r, -1);
+	for (unsigned int l = 0; l < links.size(); l++) {
+		int a = links[l].rA;
+		int b = links[l].rB;
+		int pa = nextFreePort[a];
+		int pb = nextFreePort[b];
+		if ((portPeer[a][pa] != b) || (portPeer[b][pb] != a)) {
+			throw cRuntimeError("-E- BUG - port allocation mismatch on link %d - %d", a, b);
+		}
+
+		// a.out --> b.in (flits a to b and their credits back)
+		// b.out --> a.in (flits b to a and their credits back)
+		cGate *src[4] = { routers[a]->gate("out$o", pa), routers[b]->gate("in$o", pb),
+				routers[b]->gate("out$o", pb), routers[a]->gate("in$o", pa) };
+		cGate *dst[4] = { routers[b]->gate("in$i", pb), routers[a]->gate("out$i", pa),
+				routers[a]->gate("in$i", pa), routers[b]->gate("out$i", pb) };
+		for (int g = 0; g < 4; g++) {
+			cDatarateChannel *ch = cDatarateChannel::create("channel");
+			ch->setDatarate(links[l].datarate);
+			ch->setDelay(links[l].delay);
+			src[g]->connectTo(dst[g], ch);
+		}
+
+		nextFreePort[a] = nextRouterPort(a, pa);
+		nextFreePort[b] = nextRouterPort(b, pb);
+	}
+
+	// initialize the new modules (and the channels on their gates)
+	for (int r = 0; r < numRouters; r++)
+		routers[r]->callInitialize();
+	for (int c = 0; c < numCores; c++)
+		cores[c]->callInitialize();
+
+	EV << "-I- " << getFullPath() << " built " << numRouters << " routers and "
+	   << numCores << " cores" << endl;
+}
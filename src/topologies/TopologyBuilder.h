@@ -0,0 +1,100 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#ifndef __HNOCS_TOPOLOGY_BUILDER_H_
+#define __HNOCS_TOPOLOGY_BUILDER_H_
+
+#include <omnetpp.h>
+#include <map>
+#include <vector>
+using namespace omnetpp;
+
+//
+// Builds an arbitrary NoC from an adjacency list file and computes the
+// routing tables used by TableOPCalc.
+//
+// File format (text, one statement per line, '#' starts a comment):
+//   routers <N>                            - number of routers (ids 0..N-1)
+//   core <coreId> <routerId>               - attach a core to a router
+//   link <rA> <rB> [datarate] [delay] [down] - bidirectional link between routers
+//                                            datarate e.g. 16Gbps, delay e.g. 1ns
+//                                            "-" keeps the default value
+//                                            "down" marks a missing (faulty) link
+//
+// Router ports are numbered by the order of the core and link statements.
+//
+// Routing:
+// ========
+// Up*/Down* routing over a BFS spanning tree rooted at rootRouter. A hop
+// towards the root (lower BFS level, or same level and lower id) is "up".
+// Legal routes never take an up hop after a down hop which guarantees deadlock
+// freedom on any connected topology. Among the legal routes the shortest is
+// selected. Since the legality depends on the last hop taken, tables are kept
+// for packets that arrived on an up hop (or from a core) and for packets that
+// arrived on a down hop.
+//
+// Events:
+//   A single self message at time 0 builds the network. Building during
+//   initialize() is avoided as it is undefined whether modules created
+//   during initialization are implicitly initialized.
+//
+class TopologyBuilder : public cSimpleModule
+{
+private:
+	// parameters
+	double defaultDatarate; // [bps]
+	double defaultDelay;    // [sec]
+	int rootRouter;         // the root of the up*/down* spanning tree
+
+	// the parsed topology
+	struct LinkDesc {
+		int rA, rB;
+		double datarate;
+		double delay;
+	};
+	int numRouters;
+	std::vector<LinkDesc> links;
+	std::map<int, int> coreRouter;              // coreId -> router
+	std::map<int, int> corePort;                // coreId -> port on its router
+	std::vector<int> numPortsOfRouter;          // ports allocated per router
+	std::vector< std::vector<int> > portPeer;   // [router][port] -> remote router (-1 for cores)
+	std::vector<int> level;                     // BFS level of each router
+
+	// routing tables: [router][arrivedDown][coreId] -> router port (-1 unreachable)
+	std::vector< std::vector< std::vector<int> > > nextPort;
+	std::vector< std::vector<bool> > portArrivesDown; // [router][port]
+	int maxCoreId;
+
+	// methods
+	void parseFile(const char *fileName);
+	double parseQuantity(const char *str, const char *fileName, int lineNum,
+			bool isRate);
+	bool isUpHop(int from, int to) const;
+	void computeRoutes();
+	int nextRouterPort(int routerId, int port) const;
+	void buildNetwork();
+
+protected:
+	virtual void initialize();
+	virtual void handleMessage(cMessage *msg);
+
+public:
+	// router port that should be taken for reaching the given core from a
+	// packet that entered the router on inPort. -1 if unreachable
+	int getNextPort(int routerId, int inPort, int dstId) const;
+	int getNumRouters() const { return numRouters; };
+};
+
+#endif
@@ -0,0 +1,230 @@
+#!/usr/bin/env python3
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Lesser General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public License
+# along with this program.  If not, see http://www.gnu.org/licenses/.
+#
+
+"""
+Buffer sizing exploration for a Mesh of hierarchical routers.
+
+Searches the InPort flitsPerVC of each port class (or of each port) for the
+minimal total number of buffer flits that still meets the given targets:
+  --max-p99-latency-ns   p99 of the merged sinks SoP-E2E-Latency-Hist
+  --min-throughput-MBps  sum of the sinks Sink-Total-BW-MBps
+
+Each evaluation runs the simulation once with a generated ini file that
+includes the user ini and extends the user config with the trial buffer
+depths. Run it from the example directory, e.g.:
+
+  ../../../tools/buffer_sizing.py --ini omnetpp.ini --config General \\
+      --max-p99-latency-ns 120 --output buffers.ini
+
+Port classes (Mesh routers, ports 0-3 are network ports and 4 the core):
+  core   - the core facing port of every router
+  edge   - network ports of routers on the mesh boundary
+  center - network ports of the other routers
+With --per-port every router port is sized on its own.
+
+Searches:
+  greedy   - walk the classes in order, lowering each while the targets hold
+  marginal - on every step lower the class whose reduction hurts the metric
+             least per buffer flit saved, until no reduction meets the targets
+"""
+
+import argparse
+import os
+import sys
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import hnocs_results
+
+CORE_PORT = 4
+NUM_PORTS = 5
+
+
+def port_classes(rows, columns, per_port):
+    """Map class name -> list of (router, ports pattern, number of ports)"""
+    classes = {}
+    for r in range(rows):
+        for c in range(columns):
+            rid = r * columns + c
+            if per_port:
+                for p in range(NUM_PORTS):
+                    classes['r%d.p%d' % (rid, p)] = [(rid, str(p), 1)]
+                continue
+            classes.setdefault('core', []).append((rid, str(CORE_PORT), 1))
+            boundary = r in (0, rows - 1) or c in (0, columns - 1)
+            name = 'edge' if boundary else 'center'
+            classes.setdefault(name, []).append((rid, '0..3', 4))
+    return classes
+
+
+def total_flits(depths, classes, num_vcs):
+    return sum(depths[k] * num_vcs * sum(n for (_, _, n) in classes[k])
+               for k in depths)
+
+
+def write_fragment(path, depths, classes, header_lines=None):
+    with open(path, 'w') as f:
+        for line in header_lines or []:
+            f.write(line + '\n')
+        for k in sorted(depths):
+            for (rid, ports, _) in classes[k]:
+                f.write('**.router[%d].port[%s].inPort.flitsPerVC = %d # %s\n' %
+                        (rid, ports, depths[k], k))
+
+
+class Evaluator(object):
+    def __init__(self, args, classes):
+        self.args = args
+        self.classes = classes
+        self.cache = {}
+        self.num_runs = 0
+
+    def evaluate(self, depths):
+        """Return (meets targets, metric) - smaller metric is better"""
+        key = tuple(sorted(depths.items()))
+        if key in self.cache:
+            return self.cache[key]
+        self.num_runs += 1
+        a = self.args
+        trial = 'BufSizingTrial'
+        ini = os.path.join(a.work_dir, 'buffer_sizing_trial.ini')
+        result_dir = os.path.join(a.work_dir, 'buffer_sizing_results',
+                                  'trial%d' % self.num_runs)
+        write_fragment(ini, depths, self.classes, [
+            'include %s' % os.path.abspath(a.ini),
+            '',
+            '[Config %s]' % trial,
+            'extends = %s' % a.config if a.config != 'General' else '',
+        ])
+        ok = hnocs_results.run_simulation(a.run.split(), ini, trial, result_dir,
+                                          ['-r', str(a.run_number)])
+        if not ok:
+            res = (False, float('inf'))
+        else:
+            res = self.check_targets(hnocs_results.load_results(result_dir))
+        sys.stdout.write('-I- trial %d total flits %d: %s metric %g\n' %
+                         (self.num_runs, total_flits(depths, self.classes, a.num_vcs),
+                          'meets targets' if res[0] else 'misses targets', res[1]))
+        self.cache[key] = res
+        return res
+
+    def check_targets(self, results):
+        a = self.args
+        meets = True
+        metric = 0.0
+        if a.max_p99_latency_ns is not None:
+            stats = []
+            for sca in results:
+                stats += sca.stats('SoP-E2E-Latency-Hist')
+            p99 = hnocs_results.merged_percentile(stats, 99)
+            if p99 is None:
+                return (False, float('inf'))
+            meets = meets and p99 <= a.max_p99_latency_ns
+            metric += p99 / a.max_p99_latency_ns
+        if a.min_throughput_MBps is not None:
+            bw = 0.0
+            for sca in results:
+                bw += sum(sca.scalar_values('Sink-Total-BW-MBps'))
+            meets = meets and bw >= a.min_throughput_MBps
+            metric += a.min_throughput_MBps / bw if bw > 0 else float('inf')
+        return (meets, metric)
+
+
+def greedy(ev, depths, min_depth):
+    for k in sorted(depths):
+        while depths[k] > min_depth:
+            trial = dict(depths)
+            trial[k] -= 1
+            if not ev.evaluate(trial)[0]:
+                break
+            depths = trial
+    return depths
+
+
+def marginal(ev, depths, min_depth, classes, num_vcs):
+    while True:
+        best = None
+        base_metric = ev.evaluate(depths)[1]
+        for k in sorted(depths):
+            if depths[k] <= min_depth:
+                continue
+            trial = dict(depths)
+            trial[k] -= 1
+            meets, metric = ev.evaluate(trial)
+            if not meets:
+                continue
+            saved = total_flits(depths, classes, num_vcs) - \
+                total_flits(trial, classes, num_vcs)
+            cost = (metric - base_metric) / saved
+            if best is None or cost < best[0]:
+                best = (cost, trial)
+        if best is None:
+            return depths
+        depths = best[1]
+
+
+def main():
+    p = argparse.ArgumentParser(description='Search the per port class InPort '
+                                'flitsPerVC for the minimal total buffer meeting '
+                                'a latency/throughput target')
+    p.add_argument('--ini', default='omnetpp.ini', help='the simulation ini file')
+    p.add_argument('--config', default='General', help='the config to extend')
+    p.add_argument('--run', default='./run', help='the command running HNOCS')
+    p.add_argument('--run-number', type=int, default=0)
+    p.add_argument('--rows', type=int, default=4)
+    p.add_argument('--columns', type=int, default=4)
+    p.add_argument('--num-vcs', type=int, default=2)
+    p.add_argument('--per-port', action='store_true',
+                   help='size every router port on its own instead of by class')
+    p.add_argument('--min-depth', type=int, default=1)
+    p.add_argument('--max-depth', type=int, default=8,
+                   help='the starting depth - must meet the targets')
+    p.add_argument('--search', choices=['greedy', 'marginal'], default='marginal')
+    p.add_argument('--max-p99-latency-ns', type=float)
+    p.add_argument('--min-throughput-MBps', type=float)
+    p.add_argument('--output', default='buffer_sizing.ini',
+                   help='ini fragment holding the chosen allocation')
+    p.add_argument('--work-dir', default='.')
+    args = p.parse_args()
+
+    if args.max_p99_latency_ns is None and args.min_throughput_MBps is None:
+        p.error('at least one of --max-p99-latency-ns and --min-throughput-MBps is required')
+
+    classes = port_classes(args.rows, args.columns, args.per_port)
+    depths = dict((k, args.max_depth) for k in classes)
+    ev = Evaluator(args, classes)
+    if not ev.evaluate(depths)[0]:
+        sys.stderr.write('-E- the targets are not met even with flitsPerVC=%d\n'
+                         % args.max_depth)
+        return 1
+
+    if args.search == 'greedy':
+        depths = greedy(ev, depths, args.min_depth)
+    else:
+        depths = marginal(ev, depths, args.min_depth, classes, args.num_vcs)
+
+    flits = total_flits(depths, classes, args.num_vcs)
+    write_fragment(args.output, depths, classes, [
+        '# buffer sizing: %s search, %d simulations' % (args.search, ev.num_runs),
+        '# total buffer flits: %d' % flits,
+    ])
+    sys.stdout.write('-I- total buffer flits %d written to %s\n' % (flits, args.output))
+    for k in sorted(depths):
+        sys.stdout.write('    %s flitsPerVC=%d\n' % (k, depths[k]))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,211 @@
+#!/usr/bin/env python3
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Lesser General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public License
+# along with this program.  If not, see http://www.gnu.org/licenses/.
+#
+
+"""
+View a heatmap file written by the HeatmapMonitor (csv or bin format).
+
+The selected metric is averaged over the selected windows and reduced over
+the router ports (max by default), then shown on the mesh grid of routers
+(one grid per layer). Router id r is at row (r / columns) % rows and column
+r % columns.
+
+Metrics:
+  link  - out link busy fraction
+  occ   - time weighted occupancy summed over the VCs [flits]
+  vcN   - time weighted occupancy of VC N [flits]
+
+Examples:
+  heatmap_view.py General-0.heatmap.csv
+  heatmap_view.py --metric occ --port 3 --from 10e-6 --to 20e-6 run.heatmap.bin
+  heatmap_view.py --png hot.png run.heatmap.csv    (requires matplotlib)
+"""
+
+import argparse
+import struct
+import sys
+
+
+class Heatmap(object):
+    """geometry and per window values[window][router][port] = [link, vc0, ...]"""
+    def __init__(self):
+        self.rows = self.columns = self.routers = self.ports = self.vcs = 0
+        self.window = 0.0
+        self.times = []
+        self.values = []
+
+
+def read_csv(path):
+    hm = Heatmap()
+    with open(path) as f:
+        for line in f:
+            if line.startswith('#'):
+                for kv in line[1:].split():
+                    if '=' in kv:
+                        k, v = kv.split('=')
+                        if k == 'window':
+                            hm.window = float(v)
+                        else:
+                            setattr(hm, k, int(v))
+                continue
+            if line.startswith('window'):
+                continue
+            f_ = line.strip().split(',')
+            w, t, r, p = int(f_[0]), float(f_[1]), int(f_[2]), int(f_[3])
+            while len(hm.values) <= w:
+                hm.values.append([[None] * hm.ports for _ in range(hm.routers)])
+                hm.times.append(t)
+            hm.values[w][r][p] = [float(x) for x in f_[4:]]
+    return hm
+
+
+def read_bin(path):
+    hm = Heatmap()
+    with open(path, 'rb') as f:
+        if f.read(8) != b'HNOCSHM1':
+            raise ValueError('%s is not a heatmap file' % path)
+        hm.rows, hm.columns, hm.routers, hm.ports, hm.vcs = struct.unpack('<5i', f.read(20))
+        hm.window, = struct.unpack('<d', f.read(8))
+        n = hm.routers * hm.ports * (1 + hm.vcs)
+        while True:
+            rec = f.read(8 + 4 * n)
+            if len(rec) < 8 + 4 * n:
+                break
+            hm.times.append(struct.unpack('<d', rec[:8])[0])
+            vals = struct.unpack('<%df' % n, rec[8:])
+            win = []
+            for r in range(hm.routers):
+                base = r * hm.ports * (1 + hm.vcs)
+                win.append([list(vals[base + p * (1 + hm.vcs): base + (p + 1) * (1 + hm.vcs)])
+                            for p in range(hm.ports)])
+            hm.values.append(win)
+    return hm
+
+
+def metric_value(v, metric):
+    if v is None:
+        return None
+    if metric == 'link':
+        x = v[0]
+    elif metric == 'occ':
+        x = sum(v[1:]) if min(v[1:]) >= 0 else -1
+    else:
+        x = v[1 + int(metric[2:])]
+    return None if x < 0 else x
+
+
+def reduce_map(hm, metric, port, t_from, t_to, how):
+    """per router value of the metric"""
+    wins = [w for w, t in enumerate(hm.times)
+            if (t_from is None or t >= t_from) and (t_to is None or t < t_to)]
+    if not wins:
+        raise ValueError('no window in the selected time range')
+    res = []
+    for r in range(hm.routers):
+        per_port = []
+        ports = [port] if port is not None else range(hm.ports)
+        for p in ports:
+            xs = [metric_value(hm.values[w][r][p], metric) for w in wins]
+            xs = [x for x in xs if x is not None]
+            if xs:
+                per_port.append(sum(xs) / len(xs))
+        if not per_port:
+            res.append(None)
+        elif how == 'max':
+            res.append(max(per_port))
+        else:
+            res.append(sum(per_port) / len(per_port))
+    return res
+
+
+def grids(hm, vals):
+    """list of layers, each a rows x columns grid"""
+    per_layer = hm.rows * hm.columns
+    layers = max(1, (hm.routers + per_layer - 1) // per_layer)
+    out = []
+    for z in range(layers):
+        g = [[None] * hm.columns for _ in range(hm.rows)]
+        for r in range(z * per_layer, min(hm.routers, (z + 1) * per_layer)):
+            g[(r // hm.columns) % hm.rows][r % hm.columns] = vals[r]
+        out.append(g)
+    return out
+
+
+def print_ascii(layers, title):
+    shades = ' .:-=+*#%@'
+    vmax = max([x for g in layers for row in g for x in row if x is not None] or [1]) or 1
+    print(title)
+    for z, g in enumerate(layers):
+        if len(layers) > 1:
+            print('layer %d' % z)
+        for row in g:
+            cells = []
+            for x in row:
+                if x is None:
+                    cells.append('   -   ')
+                else:
+                    cells.append('%c%6.3f' % (shades[min(9, int(9.999 * x / vmax))], x))
+            print(' '.join(cells))
+
+
+def save_png(layers, title, path):
+    import matplotlib
+    matplotlib.use('Agg')
+    import matplotlib.pyplot as plt
+    fig, axes = plt.subplots(1, len(layers), squeeze=False,
+                             figsize=(4 * len(layers) + 1, 4))
+    for z, g in enumerate(layers):
+        data = [[float('nan') if x is None else x for x in row] for row in g]
+        im = axes[0][z].imshow(data, cmap='hot', interpolation='nearest')
+        axes[0][z].set_title('layer %d' % z if len(layers) > 1 else title)
+        fig.colorbar(im, ax=axes[0][z])
+    fig.suptitle(title)
+    fig.savefig(path)
+
+
+def main():
+    p = argparse.ArgumentParser(description='Show a HeatmapMonitor file as a mesh grid')
+    p.add_argument('file')
+    p.add_argument('--metric', default='link', help='link | occ | vcN')
+    p.add_argument('--port', type=int, help='only this router port (default all)')
+    p.add_argument('--reduce', choices=['max', 'mean'], default='max',
+                   help='how the ports of a router are combined')
+    p.add_argument('--from', dest='t_from', type=float, help='first window start [sec]')
+    p.add_argument('--to', dest='t_to', type=float, help='end of the time range [sec]')
+    p.add_argument('--png', help='save the heatmap as an image instead of printing it')
+    args = p.parse_args()
+
+    with open(args.file, 'rb') as f:
+        is_bin = f.read(8) == b'HNOCSHM1'
+    hm = read_bin(args.file) if is_bin else read_csv(args.file)
+    if args.metric not in ('link', 'occ') and not (
+            args.metric.startswith('vc') and args.metric[2:].isdigit()
+            and int(args.metric[2:]) < hm.vcs):
+        p.error('unknown metric %s' % args.metric)
+
+    vals = reduce_map(hm, args.metric, args.port, args.t_from, args.t_to, args.reduce)
+    title = '%s (%s over %s) - %d windows of %gs' % (
+        args.metric, args.reduce, 'port %d' % args.port if args.port is not None else 'ports',
+        len(hm.times), hm.window)
+    layers = grids(hm, vals)
+    if args.png:
+        save_png(layers, title, args.png)
+    else:
+        print_ascii(layers, title)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
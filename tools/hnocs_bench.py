@@ -0,0 +1,238 @@
+#!/usr/bin/env python3
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Lesser General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public License
+# along with this program.  If not, see http://www.gnu.org/licenses/.
+#
+
+"""
+Simulator performance benchmark.
+
+Runs the canned configurations of examples/benchmark (sync and async
+routers, uniform low/high load and hotspot traffic on 4x4 to 32x32 meshes)
+and reports for each run:
+  events/sec           simulated events per wall clock second
+  sim-ns/wall-sec      simulated ns per wall clock second
+  wall-sec/sim-us      wall clock seconds per simulated us
+  peak-RSS-MB          peak resident memory of the simulation process
+  msgs/flit            messages created per delivered flit
+
+The event and message counts are taken from the Cmdenv express mode
+performance display, the delivered flits from the sinks flit-per-vc-*
+scalars and the peak RSS from the rusage of the process (Linux).
+
+The results are written as JSON (--output). With --baseline a previous
+JSON file is compared against: runs slower than --tolerance are listed
+and the exit code is 2. Example - from the top directory:
+
+  tools/hnocs_bench.py --sizes 4,8 --output bench.json
+  tools/hnocs_bench.py --sizes 4,8 --baseline bench.json
+"""
+
+import argparse
+import json
+import os
+import platform
+import re
+import subprocess
+import sys
+import time
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import hnocs_results
+
+CONFIGS = ['SyncUniformLow', 'SyncUniformHigh', 'SyncHotspot',
+           'AsyncUniformLow', 'AsyncUniformHigh', 'AsyncHotspot']
+SIZES = [4, 8, 16, 32]  # the run number is the index of the size
+
+BENCH_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                         '..', 'examples', 'benchmark')
+
+# higher is better for all but these
+LOWER_IS_BETTER = ('wall-sec/sim-us', 'peak-RSS-MB', 'msgs/flit')
+
+
+def run_one(args, config, size):
+    """Run a single benchmark. Return its result dict or None on failure"""
+    result_dir = os.path.join(args.work_dir, '%s-%d' % (config, size))
+    if not os.path.isdir(result_dir):
+        os.makedirs(result_dir)
+    cmd = args.run.split() + ['-u', 'Cmdenv', '-f', 'omnetpp.ini', '-c', config,
+                              '-r', str(SIZES.index(size)),
+                              '--result-dir=' + os.path.abspath(result_dir)]
+    if args.sim_time_limit:
+        cmd.append('--sim-time-limit=' + args.sim_time_limit)
+
+    start = time.time()
+    proc = subprocess.Popen(cmd, cwd=BENCH_DIR, stdout=subprocess.PIPE,
+                            stderr=subprocess.STDOUT, universal_newlines=True)
+    out = proc.stdout.read()
+    proc.stdout.close()
+    (_, status, usage) = os.wait4(proc.pid, 0)
+    wall = time.time() - start
+    if status != 0:
+        sys.stderr.write('-E- %s %dx%d failed (%d): %s\n%s\n' %
+                         (config, size, size, status, ' '.join(cmd), out[-2000:]))
+        return None
+
+    events = _last_int(r'[Ee]vent #(\d+)', out)
+    created = _last_int(r'created:\s*(\d+)', out)
+    sim_sec = _last_float(r'\bt=([0-9.eE+-]+)', out)
+    flits = 0
+    for sca in hnocs_results.load_results(result_dir):
+        for (module, name, value) in sca.scalars:
+            if name.startswith('flit-per-vc-') and module.endswith('.sink'):
+                flits += value
+    if events is None or not sim_sec:
+        sys.stderr.write('-E- %s %dx%d: no event count in the Cmdenv output\n' %
+                         (config, size, size))
+        return None
+
+    return {
+        'config': config,
+        'size': size,
+        'wall-sec': wall,
+        'sim-sec': sim_sec,
+        'events': events,
+        'messages-created': created,
+        'delivered-flits': flits,
+        'events/sec': events / wall,
+        'sim-ns/wall-sec': sim_sec * 1e9 / wall,
+        'wall-sec/sim-us': wall / (sim_sec * 1e6),
+        'peak-RSS-MB': usage.ru_maxrss / 1024.0,  # ru_maxrss is in KB on Linux
+        'msgs/flit': (created / flits) if (created is not None and flits) else None,
+    }
+
+
+def _last_int(pattern, text):
+    m = re.findall(pattern, text)
+    return int(m[-1]) if m else None
+
+
+def _last_float(pattern, text):
+    m = re.findall(pattern, text)
+    for s in reversed(m):
+        try:
+            return float(s)
+        except ValueError:
+            pass
+    return None
+
+
+def print_result(r):
+    sys.stdout.write('%-17s %5s %12.0f %14.1f %10.3f %9.1f %9s\n' % (
+        r['config'], '%dx%d' % (r['size'], r['size']), r['events/sec'],
+        r['sim-ns/wall-sec'], r['wall-sec/sim-us'], r['peak-RSS-MB'],
+        '%.2f' % r['msgs/flit'] if r['msgs/flit'] is not None else '-'))
+
+
+def compare(results, baseline, tolerance):
+    """Print the change against the baseline. Return the regressed runs"""
+    base = dict(((b['config'], b['size']), b) for b in baseline['results'])
+    regressions = []
+    sys.stdout.write('\n%-17s %5s %12s %12s %12s\n' %
+                     ('config', 'size', 'events/sec', 'RSS', 'msgs/flit'))
+    for r in results:
+        b = base.get((r['config'], r['size']))
+        if not b:
+            continue
+        change = {}
+        for key in ('events/sec', 'peak-RSS-MB', 'msgs/flit'):
+            if r[key] is None or not b.get(key):
+                change[key] = None
+                continue
+            change[key] = r[key] / b[key] - 1.0
+        sys.stdout.write('%-17s %5s %12s %12s %12s\n' % (
+            r['config'], '%dx%d' % (r['size'], r['size']),
+            _pct(change['events/sec']), _pct(change['peak-RSS-MB']),
+            _pct(change['msgs/flit'])))
+        for key in change:
+            if change[key] is None:
+                continue
+            worse = change[key] if key in LOWER_IS_BETTER else -change[key]
+            if worse > tolerance:
+                regressions.append((r['config'], r['size'], key, change[key]))
+    return regressions
+
+
+def _pct(v):
+    return '-' if v is None else '%+.1f%%' % (100.0 * v)
+
+
+def main():
+    p = argparse.ArgumentParser(description='Measure the HNOCS simulation speed '
+                                'on canned configurations')
+    p.add_argument('--configs', default=','.join(CONFIGS),
+                   help='comma separated configs of examples/benchmark/omnetpp.ini')
+    p.add_argument('--sizes', default=','.join(str(s) for s in SIZES),
+                   help='comma separated mesh sizes out of %s' %
+                   ','.join(str(s) for s in SIZES))
+    p.add_argument('--run', default='./run', help='the command running HNOCS '
+                   '(relative to examples/benchmark)')
+    p.add_argument('--sim-time-limit', help='override the 20us simulated time')
+    p.add_argument('--repeat', type=int, default=1,
+                   help='runs per benchmark - the fastest is reported')
+    p.add_argument('--output', help='JSON file of the results')
+    p.add_argument('--baseline', help='JSON file of a previous run to compare to')
+    p.add_argument('--tolerance', type=float, default=0.1,
+                   help='allowed relative slowdown against the baseline')
+    p.add_argument('--work-dir', default='benchmark_results')
+    args = p.parse_args()
+
+    configs = [c for c in args.configs.split(',') if c]
+    sizes = [int(s) for s in args.sizes.split(',') if s]
+    for s in sizes:
+        if s not in SIZES:
+            p.error('unsupported size %d' % s)
+    for c in configs:
+        if c not in CONFIGS:
+            p.error('unknown config %s' % c)
+    args.work_dir = os.path.abspath(args.work_dir)
+
+    sys.stdout.write('%-17s %5s %12s %14s %10s %9s %9s\n' % (
+        'config', 'size', 'events/sec', 'sim-ns/wall-s', 'wall-s/us',
+        'RSS-MB', 'msgs/flit'))
+    results = []
+    failed = False
+    for c in configs:
+        for s in sizes:
+            best = None
+            for _ in range(args.repeat):
+                r = run_one(args, c, s)
+                if r is None:
+                    failed = True
+                    break
+                if best is None or r['wall-sec'] < best['wall-sec']:
+                    best = r
+            if best:
+                print_result(best)
+                results.append(best)
+
+    if args.output:
+        with open(args.output, 'w') as f:
+            json.dump({'host': platform.node(), 'platform': platform.platform(),
+                       'date': time.strftime('%Y-%m-%d %H:%M:%S'),
+                       'results': results}, f, indent=2, sort_keys=True)
+        sys.stdout.write('-I- results written to %s\n' % args.output)
+
+    if args.baseline:
+        with open(args.baseline) as f:
+            regressions = compare(results, json.load(f), args.tolerance)
+        for (c, s, key, v) in regressions:
+            sys.stdout.write('-W- %s %dx%d %s changed by %s\n' % (c, s, s, key, _pct(v)))
+        if regressions:
+            return 2
+    return 1 if failed else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
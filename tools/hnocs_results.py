@@ -0,0 +1,152 @@
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Lesser General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public License
+# along with this program.  If not, see http://www.gnu.org/licenses/.
+#
+
+"""
+Helpers shared by the HNOCS tools: reading OMNeT++ scalar (.sca) result
+files and running a simulation.
+
+A .sca file is parsed into a ScaFile holding:
+  scalars    - list of (module, name, value)
+  statistics - list of Statistic (module, name, fields dict, bins list)
+The bins of a histogram are (lower edge, count) pairs as written by OMNeT++.
+"""
+
+import glob
+import os
+import subprocess
+import sys
+
+
+class Statistic(object):
+    def __init__(self, module, name):
+        self.module = module
+        self.name = name
+        self.fields = {}
+        self.bins = []
+
+    def field(self, name, default=None):
+        return self.fields.get(name, default)
+
+
+class ScaFile(object):
+    def __init__(self, path):
+        self.path = path
+        self.scalars = []
+        self.statistics = []
+        self.params = {}
+        self._parse()
+
+    def _parse(self):
+        stat = None
+        with open(self.path) as f:
+            for line in f:
+                tok = _split(line)
+                if not tok:
+                    continue
+                kind = tok[0]
+                if kind == 'scalar' and len(tok) >= 4:
+                    self.scalars.append((tok[1], tok[2], _num(tok[3])))
+                    stat = None
+                elif kind == 'statistic' and len(tok) >= 3:
+                    stat = Statistic(tok[1], tok[2])
+                    self.statistics.append(stat)
+                elif kind == 'field' and stat is not None and len(tok) >= 3:
+                    stat.fields[tok[1]] = _num(tok[2])
+                elif kind == 'bin' and stat is not None and len(tok) >= 3:
+                    stat.bins.append((_num(tok[1]), _num(tok[2])))
+                elif kind in ('param', 'config') and len(tok) >= 3:
+                    self.params[tok[1]] = tok[2]
+                elif kind not in ('attr', 'itervar'):
+                    stat = None
+
+    def scalar_values(self, name, module_suffix=None):
+        return [v for (m, n, v) in self.scalars if n == name and
+                (module_suffix is None or m.endswith(module_suffix))]
+
+    def stats(self, name, module_suffix=None):
+        return [s for s in self.statistics if s.name == name and
+                (module_suffix is None or s.module.endswith(module_suffix))]
+
+
+def _split(line):
+    # tokens are separated by white space, quoted strings may contain spaces
+    tok = []
+    cur = ''
+    quoted = False
+    for ch in line.strip():
+        if ch == '"':
+            quoted = not quoted
+        elif ch in ' \t' and not quoted:
+            if cur:
+                tok.append(cur)
+            cur = ''
+        else:
+            cur += ch
+    if cur:
+        tok.append(cur)
+    return tok
+
+
+def _num(s):
+    try:
+        return float(s)
+    except ValueError:
+        if s in ('inf', '+inf'):
+            return float('inf')
+        if s == '-inf':
+            return float('-inf')
+        return float('nan')
+
+
+def load_results(result_dir, pattern='*.sca'):
+    """All the .sca files of the result directory"""
+    return [ScaFile(p) for p in sorted(glob.glob(os.path.join(result_dir, pattern)))]
+
+
+def merged_percentile(stats, pct):
+    """Percentile (0..100) of the merged histograms, at bin lower edge
+    resolution. None if the histograms are empty."""
+    bins = {}
+    for s in stats:
+        for (edge, count) in s.bins:
+            if edge == float('-inf') or count <= 0:
+                continue
+            bins[edge] = bins.get(edge, 0) + count
+    total = sum(bins.values())
+    if not total:
+        return None
+    need = total * pct / 100.0
+    acc = 0
+    for edge in sorted(bins):
+        acc += bins[edge]
+        if acc >= need:
+            return edge
+    return max(bins)
+
+
+def run_simulation(run_cmd, ini_file, config, result_dir, extra_args=None,
+                   work_dir='.', quiet=True):
+    """Run a single simulation of the config with Cmdenv. Return True on success"""
+    cmd = list(run_cmd) + ['-u', 'Cmdenv', '-f', ini_file, '-c', config,
+                           '--result-dir=' + result_dir]
+    if extra_args:
+        cmd += list(extra_args)
+    if not os.path.isdir(result_dir):
+        os.makedirs(result_dir)
+    out = subprocess.DEVNULL if quiet else None
+    rc = subprocess.call(cmd, cwd=work_dir, stdout=out, stderr=out)
+    if rc != 0:
+        sys.stderr.write('-E- simulation failed (%d): %s\n' % (rc, ' '.join(cmd)))
+    return rc == 0
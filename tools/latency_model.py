@@ -0,0 +1,420 @@
+#!/usr/bin/env python3
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Lesser General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public License
+# along with this program.  If not, see http://www.gnu.org/licenses/.
+#
+
+"""
+Analytical latency and saturation estimate of a Mesh with XY routing.
+
+Predicts the average SoP end to end latency (source queueing + network, as
+the sinks SoP-end-to-end-latency-ns) and the saturation injection rate of a
+network in milliseconds, to prune a sweep before simulating it.
+
+Model:
+  * channels - the injection link of every core, the router to router links
+    and the ejection link of every core. The load of each channel is derived
+    from the traffic matrix by routing every source/destination pair with XY
+    routing (X first).
+  * a channel serves a packet in pktLen clocks (a clock per flit on the link,
+    tClk = 8 * flitSize / link rate). Packets arrive as a Poisson process, so
+    each channel is an M/D/1 queue: W = rho * S / (2 * (1 - rho)).
+  * wormhole blocking - a packet holding a channel also waits for the
+    channels ahead of it. The part of the packet that does not fit into the
+    downstream VC buffer carries the waiting of the next channels into the
+    service time of the channel, reduced by the other VCs which keep the
+    channel busy meanwhile - b = (1 - flitsPerVC / pktLen) / numVCs:
+      S(c) = pktLen * tClk + b * sum f(c, c') * W(c')
+    computed from the ejection channels back (XY routes are acyclic).
+  * zero load latency - every router adds the pipeline delay (the InPort
+    rcDelay + vaDelay + saDelay + stDelay plus --router-clocks clocks) and
+    every link a clock.
+The saturation rate is the injection rate at which the busiest channel
+reaches utilization 1 with the wormhole service times.
+
+The network parameters are read from the ini file config (rows, columns,
+numVCs, flitSize, pktLen, flitsPerVC and the InPort stage delays) when they
+are plain values, and may be overridden on the command line. The traffic
+pattern is given with --traffic since dstId is an expression.
+
+Each rate (--rates, flits/ns/node) is classified:
+  idle      - the predicted latency is within --idle-margin of zero load
+  saturated - the rate is above --sat-margin of the predicted saturation
+  simulate  - anything else
+With --compare every rate is also simulated (--prune skips the idle and
+saturated ones) and the model error vs the simulated latency is reported.
+Example - from examples/sync/4x4:
+
+  ../../../tools/latency_model.py --ini omnetpp.ini --rates 0.05,0.1,0.2,0.3
+  ../../../tools/latency_model.py --ini omnetpp.ini --rates 0.05,0.1,0.2 --compare
+"""
+
+import argparse
+import os
+import re
+import sys
+import time
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import hnocs_results
+
+# ini keys read from the config - the last dotted name of the key
+INI_PARAMS = ['rows', 'columns', 'numVCs', 'flitSize', 'pktLen', 'flitsPerVC',
+              'rcDelay', 'vaDelay', 'saDelay', 'stDelay']
+
+UNITS = {'B': 1, 'ns': 1.0, 'ps': 1e-3, 'us': 1e3, 'ms': 1e6, 's': 1e9}
+
+
+def _ini_value(value):
+    """A plain number (times in ns, sizes in bytes) - None for expressions"""
+    value = value.split('#')[0].strip()
+    m = re.match(r'^([0-9.eE+-]+)\s*([a-zA-Z]*)$', value)
+    if not m or (m.group(2) and m.group(2) not in UNITS):
+        return None
+    try:
+        v = float(m.group(1))
+    except ValueError:
+        return None
+    return v * UNITS[m.group(2)] if m.group(2) else v
+
+
+def _read_ini(path, sections, order):
+    cur = 'General'
+    with open(path) as f:
+        for line in f:
+            line = line.strip()
+            if not line or line.startswith('#'):
+                continue
+            if line.startswith('include '):
+                inc = line.split(None, 1)[1].strip()
+                _read_ini(os.path.join(os.path.dirname(path), inc), sections, order)
+                continue
+            m = re.match(r'^\[(?:Config\s+)?([^\]]+)\]$', line)
+            if m:
+                cur = m.group(1).strip()
+                if cur not in sections:
+                    sections[cur] = []
+                    order.append(cur)
+                continue
+            if '=' in line:
+                (key, value) = line.split('=', 1)
+                sections.setdefault(cur, []).append((key.strip(), value.strip()))
+
+
+def read_ini_params(path, config):
+    """The INI_PARAMS values of the config - first match wins as in OMNeT++"""
+    sections = {}
+    _read_ini(path, sections, [])
+    chain = []
+    cur = config
+    while cur and cur not in chain:
+        chain.append(cur)
+        ext = [v for (k, v) in sections.get(cur, []) if k == 'extends']
+        cur = ext[0] if ext else ('General' if cur != 'General' else None)
+    params = {}
+    for section in chain:
+        for (key, value) in sections.get(section, []):
+            name = key.split('.')[-1]
+            if name in INI_PARAMS and name not in params:
+                v = _ini_value(value)
+                if v is None:
+                    sys.stderr.write('-W- %s = %s is not a plain value - ignored\n' % (key, value))
+                params[name] = v
+    return dict((k, v) for (k, v) in params.items() if v is not None)
+
+
+class Mesh(object):
+    """XY routed rows x columns mesh - node id = y * columns + x"""
+
+    def __init__(self, rows, columns):
+        self.rows = rows
+        self.columns = columns
+        self.n = rows * columns
+
+    def route(self, src, dst):
+        """The channels of the XY route from core src to core dst"""
+        (x, y) = (src % self.columns, src // self.columns)
+        (dx, dy) = (dst % self.columns, dst // self.columns)
+        path = [('inj', src)]
+        while x != dx:
+            nx = x + (1 if dx > x else -1)
+            path.append(('link', y * self.columns + x, y * self.columns + nx))
+            x = nx
+        while y != dy:
+            ny = y + (1 if dy > y else -1)
+            path.append(('link', y * self.columns + x, ny * self.columns + x))
+            y = ny
+        path.append(('ej', dst))
+        return path
+
+    def traffic(self, pattern, hotspot_node, hotspot_fraction):
+        """The traffic matrix - {(src, dst): fraction of the src packets}"""
+        n = self.n
+        t = {}
+        uniform = lambda s: dict(((s, d), 1.0 / (n - 1)) for d in range(n) if d != s)
+        for s in range(n):
+            (x, y) = (s % self.columns, s // self.columns)
+            if pattern == 'uniform':
+                t.update(uniform(s))
+            elif pattern == 'hotspot':
+                if s == hotspot_node:
+                    t.update(uniform(s))
+                    continue
+                for (k, f) in uniform(s).items():
+                    t[k] = f * (1 - hotspot_fraction)
+                t[(s, hotspot_node)] = t.get((s, hotspot_node), 0) + hotspot_fraction
+            elif pattern == 'transpose':
+                if self.rows != self.columns:
+                    raise ValueError('transpose requires a square mesh')
+                d = x * self.columns + y
+                if d != s:
+                    t[(s, d)] = 1.0
+            elif pattern == 'bitcomp':
+                if n & (n - 1):
+                    raise ValueError('bitcomp requires a power of 2 nodes')
+                t[(s, ~s & (n - 1))] = 1.0
+            elif pattern == 'neighbor':
+                d = y * self.columns + (x + 1) % self.columns
+                if d != s:
+                    t[(s, d)] = 1.0
+            else:
+                raise ValueError('unknown traffic pattern %s' % pattern)
+        return t
+
+
+class Model(object):
+    def __init__(self, mesh, traffic, pkt_len, flits_per_vc, num_vcs, t_clk, router_delay):
+        self.mesh = mesh
+        self.pkt_len = pkt_len
+        self.t_clk = t_clk
+        self.router_delay = router_delay
+        self.block = max(0.0, 1.0 - float(flits_per_vc) / pkt_len) / num_vcs
+        self.flows = []   # (src, dst, fraction, path)
+        self.load = {}    # channel -> flits per ns per unit injection rate
+        self.next = {}    # channel -> {next channel: fraction of its load}
+        for ((s, d), f) in sorted(traffic.items()):
+            if f <= 0:
+                continue
+            path = mesh.route(s, d)
+            self.flows.append((s, d, f, path))
+            for (i, c) in enumerate(path):
+                self.load[c] = self.load.get(c, 0) + f
+                if i + 1 < len(path):
+                    nxt = self.next.setdefault(c, {})
+                    nxt[path[i + 1]] = nxt.get(path[i + 1], 0) + f
+        # downstream channels first - a post order of the channel dependencies
+        self.order = []
+        done = set()
+        for c in sorted(self.load):
+            stack = [(c, iter(sorted(self.next.get(c, {}))))]
+            done.add(c)
+            while stack:
+                (cur, it) = stack[-1]
+                n = next(it, None)
+                if n is None:
+                    self.order.append(cur)
+                    stack.pop()
+                elif n not in done:
+                    done.add(n)
+                    stack.append((n, iter(sorted(self.next.get(n, {})))))
+
+    def zero_load(self, path):
+        routers = len(path) - 1
+        return routers * self.router_delay + len(path) * self.t_clk
+
+    def waits(self, rate):
+        """Channel -> (utilization, mean wait ns). None if a channel saturates"""
+        res = {}
+        for c in self.order:
+            lam = rate * self.load[c] / self.pkt_len  # packets per ns
+            s = self.pkt_len * self.t_clk
+            nxt = self.next.get(c, {})
+            if nxt:
+                s += self.block * sum(f * res[n][1] for (n, f) in nxt.items()) / self.load[c]
+            rho = lam * s
+            if rho >= 1.0:
+                return None
+            res[c] = (rho, rho * s / (2.0 * (1.0 - rho)))
+        return res
+
+    def latency(self, rate):
+        """(mean latency ns, max channel utilization) - latency None if saturated"""
+        w = self.waits(rate)
+        if w is None:
+            return (None, 1.0)
+        tot = sum(f for (_, _, f, _) in self.flows)
+        lat = sum(f * (self.zero_load(p) + sum(w[c][1] for c in p))
+                  for (_, _, f, p) in self.flows) / tot
+        return (lat, max(r for (r, _) in w.values()))
+
+    def zero_load_latency(self):
+        tot = sum(f for (_, _, f, _) in self.flows)
+        return sum(f * self.zero_load(p) for (_, _, f, p) in self.flows) / tot
+
+    def channel_bound(self):
+        """Injection rate saturating the busiest channel ignoring blocking"""
+        return 1.0 / (self.t_clk * max(self.load.values()))
+
+    def saturation(self, tolerance=1e-4):
+        hi = self.channel_bound()
+        lo = 0.0
+        while hi - lo > tolerance * hi:
+            mid = (lo + hi) / 2.0
+            if self.waits(mid) is None:
+                hi = mid
+            else:
+                lo = mid
+        return lo
+
+
+def simulate(args, rate, num):
+    """Mean simulated SoP end to end latency [ns] at the rate"""
+    name = 'ModelTrial'
+    ini = os.path.join(args.work_dir, 'latency_model_trial.ini')
+    result_dir = os.path.join(args.work_dir, 'latency_model_results', 'trial%d' % num)
+    with open(ini, 'w') as f:
+        f.write('include %s\n\n' % os.path.abspath(args.ini))
+        f.write('[Config %s]\n' % name)
+        if args.config != 'General':
+            f.write('extends = %s\n' % args.config)
+        f.write('**.source.flitArrivalDelay = exponential(%gns)\n' % (1.0 / rate))
+    if not hnocs_results.run_simulation(args.run.split(), ini, name, result_dir,
+                                        ['-r', str(args.run_number)]):
+        return None
+    count = 0
+    lat_sum = 0.0
+    for sca in hnocs_results.load_results(result_dir):
+        for s in sca.stats('SoP-end-to-end-latency-ns'):
+            n = s.field('count', 0)
+            if n:
+                count += n
+                lat_sum += n * s.field('mean', 0)
+    return lat_sum / count if count else None
+
+
+def _fmt(v):
+    return '-' if v is None else '%.4g' % v
+
+
+def _csv(v):
+    return '' if v is None else '%g' % v
+
+
+def main():
+    p = argparse.ArgumentParser(description='M/D/1 wormhole queueing estimate of the '
+                                'latency and saturation rate of an XY routed mesh')
+    p.add_argument('--ini', help='read the network parameters from this ini file')
+    p.add_argument('--config', default='General', help='the ini config')
+    p.add_argument('--rows', type=int)
+    p.add_argument('--columns', type=int)
+    p.add_argument('--flit-size', type=int, help='bytes')
+    p.add_argument('--pkt-len', type=int, help='flits per packet')
+    p.add_argument('--flits-per-vc', type=int, help='InPort buffer depth')
+    p.add_argument('--num-vcs', type=int)
+    p.add_argument('--link-rate', type=float, default=16.0,
+                   help='link data rate [Gbps] (the Mesh Link channel)')
+    p.add_argument('--router-clocks', type=float, default=1.0,
+                   help='router pipeline clocks on top of the InPort stage delays')
+    p.add_argument('--traffic', default='uniform',
+                   choices=['uniform', 'hotspot', 'transpose', 'bitcomp', 'neighbor'])
+    p.add_argument('--hotspot-node', type=int, default=0)
+    p.add_argument('--hotspot-fraction', type=float, default=0.25)
+    p.add_argument('--rates', default='',
+                   help='comma separated injection rates [flits/ns/node]')
+    p.add_argument('--idle-margin', type=float, default=0.05,
+                   help='latency within this fraction of zero load is idle')
+    p.add_argument('--sat-margin', type=float, default=0.9,
+                   help='rates above this fraction of the saturation rate are saturated')
+    p.add_argument('--compare', action='store_true',
+                   help='simulate every rate and report the model error')
+    p.add_argument('--prune', action='store_true',
+                   help='with --compare do not simulate idle and saturated rates')
+    p.add_argument('--run', default='./run', help='the command running HNOCS')
+    p.add_argument('--run-number', type=int, default=0)
+    p.add_argument('--output', help='csv of the rates')
+    p.add_argument('--work-dir', default='.')
+    args = p.parse_args()
+
+    ini = read_ini_params(args.ini, args.config) if args.ini else {}
+    if args.compare and not args.ini:
+        p.error('--compare requires --ini')
+
+    def param(value, key, default):
+        return value if value is not None else ini.get(key, default)
+
+    rows = int(param(args.rows, 'rows', 4))
+    columns = int(param(args.columns, 'columns', 4))
+    flit_size = param(args.flit_size, 'flitSize', 4)
+    pkt_len = int(param(args.pkt_len, 'pktLen', 8))
+    flits_per_vc = int(param(args.flits_per_vc, 'flitsPerVC', 4))
+    num_vcs = int(param(args.num_vcs, 'numVCs', 2))
+    t_clk = 8.0 * flit_size / args.link_rate  # ns
+    stage_delays = sum(ini.get(k, 0.0) for k in ('rcDelay', 'vaDelay', 'saDelay', 'stDelay'))
+    router_delay = stage_delays + args.router_clocks * t_clk
+
+    start = time.time()
+    mesh = Mesh(rows, columns)
+    try:
+        traffic = mesh.traffic(args.traffic, args.hotspot_node, args.hotspot_fraction)
+    except ValueError as e:
+        p.error(str(e))
+    model = Model(mesh, traffic, pkt_len, flits_per_vc, num_vcs, t_clk, router_delay)
+    zero = model.zero_load_latency()
+    sat = model.saturation()
+    sys.stdout.write('-I- %dx%d mesh %s traffic pktLen %d flitsPerVC %d numVCs %d tClk %gns\n' %
+                     (rows, columns, args.traffic, pkt_len, flits_per_vc, num_vcs, t_clk))
+    sys.stdout.write('    zero load latency %.4g ns\n' % zero)
+    sys.stdout.write('    saturation %.4g flits/ns/node (channel bound %.4g)\n' %
+                     (sat, model.channel_bound()))
+
+    rows_out = []
+    for rate in [float(r) for r in args.rates.split(',') if r]:
+        (lat, util) = model.latency(rate)
+        if rate >= args.sat_margin * sat or lat is None:
+            cls = 'saturated'
+        elif lat <= (1 + args.idle_margin) * zero:
+            cls = 'idle'
+        else:
+            cls = 'simulate'
+        rows_out.append([rate, util, lat, cls, None, None])
+    sys.stdout.write('    model time %.1f ms\n' % (1e3 * (time.time() - start)))
+
+    if args.compare:
+        for (i, r) in enumerate(rows_out):
+            if args.prune and r[3] != 'simulate':
+                continue
+            r[4] = simulate(args, r[0], i)
+            if r[4] and r[2] is not None:
+                r[5] = 100.0 * (r[2] - r[4]) / r[4]
+
+    sys.stdout.write('%10s %9s %12s %10s %12s %8s\n' % (
+        'rate', 'max-util', 'model-ns', 'class', 'sim-ns', 'error-%'))
+    for (rate, util, lat, cls, sim, err) in rows_out:
+        sys.stdout.write('%10g %9.3f %12s %10s %12s %8s\n' % (
+            rate, util, _fmt(lat), cls, _fmt(sim), _fmt(err)))
+    errs = [abs(r[5]) for r in rows_out if r[5] is not None]
+    if errs:
+        sys.stdout.write('-I- model error: mean %.1f%% max %.1f%% over %d rates\n' %
+                         (sum(errs) / len(errs), max(errs), len(errs)))
+
+    if args.output:
+        with open(args.output, 'w') as f:
+            f.write('rate-flits-per-ns-per-node,max-channel-util,model-latency-ns,'
+                    'class,sim-latency-ns,error-percent\n')
+            for (rate, util, lat, cls, sim, err) in rows_out:
+                f.write('%g,%g,%s,%s,%s,%s\n' % (rate, util, _csv(lat), cls, _csv(sim), _csv(err)))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
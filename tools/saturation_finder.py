@@ -0,0 +1,222 @@
+#!/usr/bin/env python3
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Lesser General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public License
+# along with this program.  If not, see http://www.gnu.org/licenses/.
+#
+
+"""
+Saturation throughput finder.
+
+Bisects the injection rate of every given config for its saturation point
+instead of sweeping a fixed list of offered loads. Every trial runs with a
+SaturationMonitor (hasSaturationMonitor) which ends the run as soon as the
+source queues and the latency keep growing, so trials past saturation cost
+a few microseconds of simulated time instead of the full sim-time-limit.
+
+A trial is saturated if the monitor ended it or if the accepted load is
+below --accept-ratio of the offered load. The rate is given in flits per ns
+per node and set as **.source.flitArrivalDelay (--dist exponential or
+constant inter flit delay).
+
+The output (--output) is a csv of every trial - the offered vs accepted
+load curve - and the saturation point of each config is printed. Extra
+evenly spaced curve points may be added with --curve-points. Example -
+from examples/sync/uniform_eval:
+
+  ../../../tools/saturation_finder.py --ini omnetpp.ini --configs General \\
+      --max-rate 0.5 --curve-points 5 --output saturation.csv
+"""
+
+import argparse
+import os
+import sys
+import time
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import hnocs_results
+
+
+class Trial(object):
+    def __init__(self, config, offered):
+        self.config = config
+        self.offered = offered
+        self.accepted = None
+        self.latency = None
+        self.aborted_at = None  # sim time the monitor ended the run (None if not)
+        self.saturated = True
+        self.wall = 0.0
+
+
+class Finder(object):
+    def __init__(self, args):
+        self.args = args
+        self.trials = []
+        self.num_runs = 0
+
+    def evaluate(self, config, offered):
+        a = self.args
+        self.num_runs += 1
+        t = Trial(config, offered)
+        name = 'SatTrial'
+        ini = os.path.join(a.work_dir, 'saturation_trial.ini')
+        result_dir = os.path.join(a.work_dir, 'saturation_results',
+                                  'trial%d' % self.num_runs)
+        delay_ns = 1.0 / offered
+        if a.dist == 'exponential':
+            delay = 'exponential(%gns)' % delay_ns
+        else:
+            delay = '%gns' % delay_ns
+        with open(ini, 'w') as f:
+            f.write('include %s\n\n' % os.path.abspath(a.ini))
+            f.write('[Config %s]\n' % name)
+            if config != 'General':
+                f.write('extends = %s\n' % config)
+            f.write('*.hasSaturationMonitor = true\n')
+            f.write('*.saturationMonitor.warmup = %s\n' % a.warmup)
+            f.write('*.saturationMonitor.checkPeriod = %s\n' % a.check_period)
+            f.write('**.source.flitArrivalDelay = %s\n' % delay)
+        extra = ['-r', str(a.run_number)]
+        if a.sim_time_limit:
+            extra.append('--sim-time-limit=' + a.sim_time_limit)
+
+        start = time.time()
+        ok = hnocs_results.run_simulation(a.run.split(), ini, name, result_dir, extra)
+        t.wall = time.time() - start
+        if ok:
+            self.read_results(t, hnocs_results.load_results(result_dir))
+        sys.stdout.write('-I- %s offered %.4f accepted %s latency %s%s\n' % (
+            config, offered, _fmt(t.accepted), _fmt(t.latency),
+            ' SATURATED' if t.saturated else ''))
+        self.trials.append(t)
+        return t
+
+    def read_results(self, t, results):
+        a = self.args
+        count = 0
+        lat_sum = 0.0
+        for sca in results:
+            for v in sca.scalar_values('saturated'):
+                t.saturated = v > 0
+            for v in sca.scalar_values('saturation-detect-time'):
+                t.aborted_at = v
+            for v in sca.scalar_values('accepted-flits-per-ns-per-node'):
+                t.accepted = v
+            for s in sca.stats('SoP-end-to-end-latency-ns'):
+                n = s.field('count', 0)
+                if n:
+                    count += n
+                    lat_sum += n * s.field('mean', 0)
+        if count:
+            t.latency = lat_sum / count
+        if t.accepted is None or t.accepted < a.accept_ratio * t.offered:
+            t.saturated = True
+
+    def bisect(self, config):
+        """Return (highest stable trial, lowest saturated trial)"""
+        a = self.args
+        lo = self.evaluate(config, a.min_rate)
+        if lo.saturated:
+            sys.stderr.write('-E- %s is saturated at --min-rate %g\n' % (config, a.min_rate))
+            return (None, lo)
+        hi = self.evaluate(config, a.max_rate)
+        if not hi.saturated:
+            sys.stderr.write('-W- %s is not saturated at --max-rate %g\n' % (config, a.max_rate))
+            return (hi, None)
+        while hi.offered - lo.offered > a.tolerance * hi.offered:
+            mid = self.evaluate(config, (lo.offered + hi.offered) / 2.0)
+            if mid.saturated:
+                hi = mid
+            else:
+                lo = mid
+        return (lo, hi)
+
+    def add_curve_points(self, config, top):
+        a = self.args
+        done = set(t.offered for t in self.trials if t.config == config)
+        for i in range(1, a.curve_points + 1):
+            rate = a.min_rate + (top - a.min_rate) * i / float(a.curve_points + 1)
+            if rate not in done:
+                self.evaluate(config, rate)
+
+    def write_csv(self, path):
+        with open(path, 'w') as f:
+            f.write('config,offered-flits-per-ns-per-node,accepted-flits-per-ns-per-node,'
+                    'SoP-end-to-end-latency-ns,saturated,aborted-at-s,wall-sec\n')
+            for t in sorted(self.trials, key=lambda t: (t.config, t.offered)):
+                f.write('%s,%g,%s,%s,%d,%s,%.2f\n' % (
+                    t.config, t.offered, _csv(t.accepted), _csv(t.latency),
+                    t.saturated, _csv(t.aborted_at), t.wall))
+
+
+def _fmt(v):
+    return '-' if v is None else '%.4g' % v
+
+
+def _csv(v):
+    return '' if v is None else '%g' % v
+
+
+def main():
+    p = argparse.ArgumentParser(description='Bisect the injection rate for the '
+                                'saturation point with early abort of diverging runs')
+    p.add_argument('--ini', default='omnetpp.ini', help='the simulation ini file')
+    p.add_argument('--configs', default='General', help='comma separated configs')
+    p.add_argument('--run', default='./run', help='the command running HNOCS')
+    p.add_argument('--run-number', type=int, default=0)
+    p.add_argument('--min-rate', type=float, default=0.01,
+                   help='a stable injection rate [flits/ns/node]')
+    p.add_argument('--max-rate', type=float, default=0.5,
+                   help='a saturated injection rate [flits/ns/node]')
+    p.add_argument('--tolerance', type=float, default=0.02,
+                   help='relative width of the final rate interval')
+    p.add_argument('--accept-ratio', type=float, default=0.95,
+                   help='accepted/offered load below which a trial is saturated')
+    p.add_argument('--dist', choices=['exponential', 'constant'], default='exponential',
+                   help='inter flit delay distribution')
+    p.add_argument('--curve-points', type=int, default=0,
+                   help='extra evenly spaced points up to the saturated rate')
+    p.add_argument('--warmup', default='2us', help='SaturationMonitor warmup')
+    p.add_argument('--check-period', default='1us', help='SaturationMonitor checkPeriod')
+    p.add_argument('--sim-time-limit', help='override the sim-time-limit of the ini')
+    p.add_argument('--output', default='saturation.csv', help='csv of all the trials')
+    p.add_argument('--work-dir', default='.')
+    args = p.parse_args()
+
+    if not 0 < args.min_rate < args.max_rate:
+        p.error('0 < --min-rate < --max-rate is required')
+
+    finder = Finder(args)
+    points = []
+    for config in [c for c in args.configs.split(',') if c]:
+        (stable, saturated) = finder.bisect(config)
+        if args.curve_points and (stable or saturated):
+            top = saturated.offered if saturated else stable.offered
+            finder.add_curve_points(config, top)
+        points.append((config, stable, saturated))
+
+    finder.write_csv(args.output)
+    sys.stdout.write('-I- %d simulations, all trials written to %s\n' %
+                     (finder.num_runs, args.output))
+    for (config, stable, saturated) in points:
+        if stable is None:
+            sys.stdout.write('    %s saturated below %g flits/ns/node\n' % (config, args.min_rate))
+        elif saturated is None:
+            sys.stdout.write('    %s not saturated up to %g flits/ns/node\n' % (config, args.max_rate))
+        else:
+            sys.stdout.write('    %s saturation at %.4g flits/ns/node offered '
+                             '(%.4g accepted, %s ns latency)\n' % (
+                                 config, stable.offered, stable.accepted, _fmt(stable.latency)))
+    return 0 if all(s is not None and h is not None for (_, s, h) in points) else 1
+
+if __name__ == '__main__':
+    sys.exit(main())